@@ -0,0 +1,370 @@
+// Micro-benchmarks for the listing, sorting and rendering hot paths. Generates synthetic trees
+// under the temp directory (kept between runs), runs each benchmark until it has taken long
+// enough to time, and prints one JSON document with ns/entry, allocations and system calls
+// per operation so runs can be compared.
+//
+//   FileManagerBench [--quick] [--filter <substring>] [--out <file.json>] [--clean]
+
+#include "DirScanner.hpp"
+#include "FileManager.hpp"
+#include "ThreadPool.hpp"
+#include "Ui.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <ftxui/screen/screen.hpp>
+#include <new>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+// --- Allocation counting ---
+namespace {
+std::atomic<uint64_t> gAllocs{0}, gAllocBytes{0};
+}
+
+void *operator new(std::size_t n) {
+    gAllocs.fetch_add(1, std::memory_order_relaxed);
+    gAllocBytes.fetch_add(n, std::memory_order_relaxed);
+    if (void *p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t n) { return operator new(n); }
+void *operator new(std::size_t n, const std::nothrow_t &) noexcept {
+    try {
+        return operator new(n);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void *operator new[](std::size_t n, const std::nothrow_t &t) noexcept {
+    return operator new(n, t);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+// --- System call counting ---
+// Linux only: one raw_syscalls:sys_enter tracepoint counter per thread alive when it is
+// created, so the shared pool's workers are included. Unavailable (reported as null) when
+// tracefs is not readable or perf events are restricted.
+class SyscallCounter {
+  public:
+    SyscallCounter() {
+#ifdef __linux__
+        uint64_t id = 0;
+        for (const char *f : {"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                              "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"}) {
+            std::ifstream in(f);
+            if (in >> id) break;
+        }
+        if (!id) return;
+        std::error_code ec;
+        for (const auto &task : fs::directory_iterator("/proc/self/task", ec)) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_TRACEPOINT;
+            attr.size = sizeof(attr);
+            attr.config = id;
+            pid_t tid = std::atoi(task.path().filename().c_str());
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+            if (fd < 0) {
+                close();
+                return;
+            }
+            _fds.push_back(fd);
+        }
+#endif
+    }
+    ~SyscallCounter() { close(); }
+
+    bool available() const { return !_fds.empty(); }
+
+    uint64_t read() const {
+        uint64_t total = 0;
+#ifdef __linux__
+        for (int fd : _fds) {
+            uint64_t n = 0;
+            if (::read(fd, &n, sizeof(n)) == sizeof(n)) total += n;
+        }
+#endif
+        return total;
+    }
+
+  private:
+    std::vector<int> _fds;
+
+    void close() {
+#ifdef __linux__
+        for (int fd : _fds) ::close(fd);
+#endif
+        _fds.clear();
+    }
+};
+
+// --- Fixtures ---
+struct Fixture {
+    std::string name;
+    size_t files;     // total regular files
+    size_t dirs;      // directories below the root
+    size_t depth;     // nesting of those directories (1 = all directly below the root)
+    bool expandAll;
+};
+
+const char *kExtensions[] = {".txt", ".cpp", ".hpp", ".md", ".png", ".json", ".log", ""};
+
+void touch(const fs::path &p) { std::ofstream(p, std::ios::binary); }
+
+// Spreads `files` evenly over `dirs` directories nested `depth` deep (in chains), or puts
+// them all in the root when there are none. A marker file makes later runs reuse the tree.
+fs::path generate(const fs::path &base, const Fixture &f) {
+    fs::path root = base / f.name;
+    if (fs::exists(root / ".complete")) return root;
+    fs::remove_all(root);
+    fs::create_directories(root);
+
+    std::vector<fs::path> dirs;
+    if (f.dirs == 0) dirs.push_back(root);
+    for (size_t chain = 0; dirs.size() < f.dirs; ++chain) {
+        fs::path dir = root;
+        for (size_t level = 0; level < f.depth && dirs.size() < f.dirs; ++level) {
+            dir /= "dir" + std::to_string(chain) + "_" + std::to_string(level);
+            fs::create_directory(dir);
+            dirs.push_back(dir);
+        }
+    }
+    for (size_t i = 0; i < f.files; ++i) {
+        std::string name = (i % 3 ? "File" : "file") + std::to_string(i) +
+                           kExtensions[i % std::size(kExtensions)];
+        touch(dirs[i % dirs.size()] / name);
+    }
+    touch(root / ".complete");
+    return root;
+}
+
+// --- Measurement ---
+struct Result {
+    std::string fixture, bench;
+    size_t entries = 0;
+    uint64_t iterations = 0;
+    double nsPerOp = 0, allocsPerOp = 0, allocBytesPerOp = 0;
+    std::optional<double> syscallsPerOp;
+};
+
+// Runs `op` once to warm up, then repeatedly until kMinTime has passed.
+template <class Op>
+Result measure(const SyscallCounter &syscalls, std::string fixture, std::string bench,
+               size_t entries, Op &&op) {
+    constexpr auto kMinTime = std::chrono::milliseconds(300);
+    constexpr uint64_t kMaxIterations = 1'000'000;
+    op();
+
+    uint64_t allocs = gAllocs.load(), bytes = gAllocBytes.load(), calls = syscalls.read();
+    auto start = std::chrono::steady_clock::now(), now = start;
+    uint64_t n = 0;
+    do {
+        op();
+        ++n;
+        now = std::chrono::steady_clock::now();
+    } while (now - start < kMinTime && n < kMaxIterations);
+
+    Result r;
+    r.fixture = std::move(fixture);
+    r.bench = std::move(bench);
+    r.entries = entries;
+    r.iterations = n;
+    r.nsPerOp = std::chrono::duration<double, std::nano>(now - start).count() / n;
+    r.allocsPerOp = double(gAllocs.load() - allocs) / n;
+    r.allocBytesPerOp = double(gAllocBytes.load() - bytes) / n;
+    if (syscalls.available()) r.syscallsPerOp = double(syscalls.read() - calls) / n;
+    return r;
+}
+
+json toJson(const Result &r) {
+    return {{"fixture", r.fixture},
+            {"bench", r.bench},
+            {"entries", r.entries},
+            {"iterations", r.iterations},
+            {"ns_per_op", r.nsPerOp},
+            {"ns_per_entry", r.entries ? r.nsPerOp / r.entries : 0.0},
+            {"allocs_per_op", r.allocsPerOp},
+            {"alloc_bytes_per_op", r.allocBytesPerOp},
+            {"syscalls_per_op", r.syscallsPerOp ? json(*r.syscallsPerOp) : json(nullptr)}};
+}
+
+// Keeps a result from being optimized away.
+const void *volatile gSink;
+template <class T> void doNotOptimize(const T &value) { gSink = &value; }
+} // namespace
+
+int main(int argc, char **argv) {
+    bool quick = false, clean = false;
+    std::string filter, out;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--clean") {
+            clean = true;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            out = argv[++i];
+        } else {
+            std::fprintf(stderr, "usage: %s [--quick] [--filter <substring>] [--out <file>] "
+                                 "[--clean]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    fs::path base = fs::temp_directory_path() / "FileManagerBench";
+    if (clean) {
+        fs::remove_all(base);
+        return 0;
+    }
+
+    std::vector<Fixture> fixtures = {
+        {"flat-10k", 10'000, 0, 0, false},
+        {"flat-100k", 100'000, 0, 0, false},
+        {"flat-1m", 1'000'000, 0, 0, false},
+        {"deep-128", 1'280, 128, 128, true},     // one chain of 128 nested directories
+        {"expanded-1k", 100'000, 1'000, 1, true}, // 1000 sibling directories, all open
+    };
+    if (quick) std::erase_if(fixtures, [](const Fixture &f) { return f.files > 100'000; });
+
+    // Start every thread before counting so each one gets a system call counter.
+    ThreadPool::shared();
+    FileManager fm;
+    fm.cancelLoad();
+    SyscallCounter syscalls;
+    if (!syscalls.available())
+        std::fprintf(stderr, "system call counting unavailable, reporting null\n");
+
+    std::vector<Result> results;
+    auto wanted = [&](const std::string &fixture, const char *bench) {
+        return filter.empty() || (fixture + "/" + bench).find(filter) != std::string::npos;
+    };
+    auto report = [&](Result r) {
+        std::fprintf(stderr, "%-14s %-22s %10.1f ns/entry %10.1f allocs/op\n", r.fixture.c_str(),
+                     r.bench.c_str(), r.entries ? r.nsPerOp / r.entries : r.nsPerOp,
+                     r.allocsPerOp);
+        results.push_back(std::move(r));
+    };
+
+    for (const auto &f : fixtures) {
+        std::fprintf(stderr, "preparing %s...\n", f.name.c_str());
+        fs::path root = generate(base, f);
+
+        fm.cwd = root;
+        fm.tree.clearExpanded();
+        fm.tree.setExpanded(fm.tree.intern(root), true);
+        if (f.expandAll)
+            for (auto it = fs::recursive_directory_iterator(root);
+                 it != fs::recursive_directory_iterator(); ++it)
+                if (it->is_directory()) fm.tree.setExpanded(fm.tree.intern(it->path()), true);
+
+        auto listing = [&] {
+            fm.entries.clear();
+            fm.buildTree(root, 0);
+        };
+        listing();
+        size_t rows = fm.entries.size();
+
+        if (wanted(f.name, "buildTree"))
+            report(measure(syscalls, f.name, "buildTree", rows, listing));
+
+        // Reading one directory with full metadata: the standard library against DirScanner.
+        if (f.dirs == 0 && wanted(f.name, "scan/filesystem"))
+            report(measure(syscalls, f.name, "scan/filesystem", rows, [&] {
+                size_t n = 0;
+                for (auto &e : fs::directory_iterator(root)) n += Tree::Meta::read(e).isDir;
+                doNotOptimize(n);
+            }));
+        if (f.dirs == 0 && wanted(f.name, "scan/DirScanner"))
+            report(measure(syscalls, f.name, "scan/DirScanner", rows, [&] {
+                size_t n = 0;
+                DirScanner scanner(root, DirScanner::Size | DirScanner::Mtime);
+                for (DirScanner::Entry e; scanner.next(e);) n += e.meta.isDir;
+                doNotOptimize(n);
+            }));
+
+        // The comparator alone, on a shuffled permutation of the root listing.
+        if (f.dirs == 0) {
+            std::vector<Tree::Item> items = scanDir(root, fm.order());
+            std::vector<uint32_t> shuffled(items.size()), perm(items.size());
+            std::iota(shuffled.begin(), shuffled.end(), 0);
+            std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+            static const char *modes[] = {"name", "natural", "size", "mtime", "extension"};
+            for (int m = 0; m < 5; ++m) {
+                std::string bench = std::string("sort/") + modes[m];
+                if (!wanted(f.name, bench.c_str())) continue;
+                FileManager::EntryOrder order{static_cast<FileManager::SortMode>(m)};
+                report(measure(syscalls, f.name, bench, items.size(), [&] {
+                    std::copy(shuffled.begin(), shuffled.end(), perm.begin());
+                    std::sort(perm.begin(), perm.end(), [&](uint32_t a, uint32_t b) {
+                        return order(items[a], items[b]);
+                    });
+                }));
+            }
+        }
+
+        if (wanted(f.name, "maxExpandedDepth"))
+            report(measure(syscalls, f.name, "maxExpandedDepth", rows,
+                           [&] { doNotOptimize(fm.maxExpandedDepth()); }));
+
+        if (wanted(f.name, "Layout::compute")) {
+            int width = 80;
+            report(measure(syscalls, f.name, "Layout::compute", 0, [&] {
+                width = width == 240 ? 80 : width + 1;
+                doNotOptimize(UI::Layout::compute(width, static_cast<int>(f.depth)));
+            }));
+        }
+
+        // A full frame: building the element tree and rasterizing it off screen.
+        if (wanted(f.name, "render")) {
+            constexpr int kWidth = 200, kHeight = 60;
+            auto screen = ScreenInteractive::FixedSize(kWidth, kHeight);
+            UI ui(fm);
+            Screen canvas(kWidth, kHeight);
+            fm.selIdx = fm.scrollOffset = 0;
+            report(measure(syscalls, f.name, "render", rows, [&] {
+                Element frame = ui.render(screen);
+                Render(canvas, frame);
+            }));
+        }
+    }
+
+    json doc = {{"version", 1},
+                {"threads", ThreadPool::shared().size()},
+                {"syscalls_counted", syscalls.available()},
+                {"results", json::array()}};
+    for (const auto &r : results) doc["results"].push_back(toJson(r));
+
+    if (out.empty()) {
+        std::printf("%s\n", doc.dump(2).c_str());
+    } else {
+        std::ofstream file(out);
+        file << doc.dump(2) << "\n";
+        if (!file) {
+            std::fprintf(stderr, "cannot write %s\n", out.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
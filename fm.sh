@@ -0,0 +1,14 @@
+# Source from ~/.bashrc or ~/.zshrc to cd into the directory FileManager was left in.
+fm() {
+    FileManager "$@"
+    local file="${XDG_CONFIG_HOME:-$HOME/.config}/FileManager/history.txt"
+    [ -f "$file" ] || return
+    local dir
+    dir=$(tail -n 1 "$file")
+
+    if [ -d "$dir" ]; then
+        cd "$dir" && echo "Changed directory to: $dir"
+    else
+        echo "Path not found: $dir"
+    fi
+}
@@ -0,0 +1,80 @@
+#ifndef CONTENTSEARCH_HPP_
+#define CONTENTSEARCH_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Searches file contents below a set of roots for a literal string (grep -F). Directories are
+// walked and files searched in parallel on the shared pool: each regular file is read in
+// windows and scanned with a Boyer-Moore-Horspool searcher, and files that look binary are
+// skipped. Hits arrive
+// through the callback in batches, at most every kReportInterval, tagged with the generation
+// of the search they belong to. Starting a new search cancels the previous one.
+class ContentSearch {
+  public:
+    struct Hit {
+        fs::path file;
+        uint32_t line = 0;  // 1-based
+        std::string text;   // the line around the match, ready for display
+        uint16_t matchAt = 0; // match position and length within text
+        uint16_t matchLen = 0;
+    };
+
+    struct Results {
+        uint64_t gen = 0;
+        std::vector<Hit> hits; // new since the previous batch
+        size_t filesSearched = 0;
+        bool done = false;
+        bool capped = false; // stopped at kMaxHits
+    };
+
+    using Callback = std::function<void(Results)>;
+    static constexpr size_t kMaxHits = 2000;
+    static constexpr size_t kMaxHitsPerFile = 100;
+    static constexpr size_t kMaxColumns = 200;
+    static constexpr auto kReportInterval = std::chrono::milliseconds(50);
+
+    explicit ContentSearch(Callback callback);
+    ~ContentSearch();
+
+    ContentSearch(const ContentSearch &) = delete;
+    ContentSearch &operator=(const ContentSearch &) = delete;
+
+    // Cancels the running search and queues one for `query` in the files below `roots` (roots
+    // may also be files). An empty query only cancels. Neither this nor cancel() waits for
+    // the old search to wind down.
+    void start(std::vector<fs::path> roots, std::string query);
+    void cancel();
+    uint64_t generation() const { return _gen.load(); }
+
+  private:
+    struct Search;
+
+    Callback _callback;
+    std::atomic<uint64_t> _gen{0};
+    std::mutex _mutex;
+    std::condition_variable_any _cv;
+    std::shared_ptr<Search> _request; // the newest start(), not picked up yet
+    std::jthread _thread;
+
+    void loop(std::stop_token);
+    bool stopped(const Search &) const;
+    void run(std::stop_token, Search &);
+    void searchFile(const fs::path &, Search &);
+    void report(Search &, bool done);
+};
+
+#endif
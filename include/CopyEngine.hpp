@@ -0,0 +1,70 @@
+#ifndef COPYENGINE_HPP_
+#define COPYENGINE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <stop_token>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Copies a file or directory tree with the fastest mechanism the platform offers: reflinks
+// (FICLONE), then copy_file_range, then sendfile on Linux, CopyFileExW on Windows, plain
+// read/write elsewhere. Files of a tree are copied concurrently on the shared pool, with at
+// most maxParallel copies in flight.
+class CopyEngine {
+  public:
+    struct Progress {
+        std::uintmax_t bytesDone = 0;
+        std::uintmax_t bytesTotal = 0;
+        size_t filesDone = 0;
+        size_t filesTotal = 0;
+        double bytesPerSec = 0;
+        double etaSec = -1; // unknown until the rate settles
+        bool planning = true; // still walking the source
+    };
+    using ProgressFn = std::function<void(const Progress &)>;
+
+    explicit CopyEngine(ProgressFn onProgress, unsigned maxParallel = 0);
+
+    // Copies each (from, to) pair; no `to` may exist yet. All files of all items share one
+    // pool of workers. Blocks the calling thread; progress is reported from whichever thread
+    // made it, at most every kReportInterval. Returns false if stopped, after removing
+    // whatever was created. Throws fs::filesystem_error on failure.
+    bool run(const std::vector<std::pair<fs::path, fs::path>> &items, std::stop_token stop);
+    bool run(const fs::path &from, const fs::path &to, std::stop_token stop) {
+        return run({{from, to}}, stop);
+    }
+
+  private:
+    static constexpr auto kReportInterval = std::chrono::milliseconds(100);
+
+    struct File {
+        fs::path from, to;
+        std::uintmax_t size;
+    };
+
+    ProgressFn _onProgress;
+    unsigned _maxParallel;
+
+    // Shared by the workers of the current run.
+    std::atomic<std::uintmax_t> _bytesDone{0};
+    std::atomic<size_t> _filesDone{0};
+    std::mutex _reportMutex;
+    Progress _progress;
+    std::chrono::steady_clock::time_point _lastReport;
+    std::uintmax_t _lastBytes = 0;
+
+    void report(bool force = false);
+    void plan(const fs::path &from, const fs::path &to, std::vector<File> &dirs,
+              std::vector<File> &files, std::vector<File> &links, std::stop_token stop);
+    // Copies one regular file; false if stopped part way (the partial copy is removed).
+    bool copyFile(const File &, std::stop_token stop);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef DIRCOMPARE_HPP_
+#define DIRCOMPARE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Compares two directory trees on a background thread, walking matching directory pairs in
+// parallel on the shared pool. Files of equal size and mtime count as the same, as in rsync's
+// quick check; only files of equal size with different mtimes have their contents read, block
+// by block, up to the first difference. A directory present on one side only is reported
+// once, not entry by entry. Symlinks are compared by target, never followed.
+class DirCompare {
+  public:
+    enum class Kind {
+        OnlyLeft,
+        OnlyRight,
+        Changed,
+    };
+
+    struct Diff {
+        fs::path rel; // relative to both roots
+        Kind kind;
+        bool isDir = false;      // on the side it exists on (left, for Changed)
+        std::uintmax_t size = 0; // of a regular file on the left
+    };
+
+    struct Status {
+        uint64_t gen = 0;
+        bool done = false;
+        size_t compared = 0;        // entries looked at so far
+        size_t same = 0;
+        std::uintmax_t bytesRead = 0; // by content checks, both sides
+        std::vector<Diff> diffs;     // set once done, sorted by path
+        std::string error;           // a root could not be read
+    };
+
+    using Callback = std::function<void(Status)>;
+    static constexpr size_t kBlock = 1 << 20; // compared between cancellation checks
+    static constexpr auto kReportInterval = std::chrono::milliseconds(100);
+
+    explicit DirCompare(Callback callback);
+    ~DirCompare();
+
+    DirCompare(const DirCompare &) = delete;
+    DirCompare &operator=(const DirCompare &) = delete;
+
+    // Cancels the running comparison and queues one of `left` with `right`. Neither this nor
+    // cancel() waits for the old comparison to wind down.
+    void start(fs::path left, fs::path right);
+    void cancel();
+    uint64_t generation() const { return _gen.load(); }
+
+  private:
+    struct Search;
+    struct Request {
+        uint64_t gen;
+        fs::path left, right;
+    };
+
+    Callback _callback;
+    std::atomic<uint64_t> _gen{0};
+    std::mutex _mutex;
+    std::condition_variable_any _cv;
+    std::optional<Request> _request; // the newest start(), not picked up yet
+    std::jthread _thread;
+
+    void loop(std::stop_token);
+    void run(Search &);
+    void compareDir(Search &, const fs::path &rel);
+    void compareContents(Search &, const fs::path &rel, std::uintmax_t size);
+    void report(Search &);
+};
+
+#endif
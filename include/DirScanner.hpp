@@ -0,0 +1,48 @@
+#ifndef DIRSCANNER_HPP_
+#define DIRSCANNER_HPP_
+
+#include "Tree.hpp"
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+// Lists one directory with the metadata the caller asks for. On Linux entries are read with
+// getdents64 into a large buffer and typed from d_type, so a type-only scan makes no per-entry
+// system calls; size and mtime cost one statx relative to the directory, with a mask limited
+// to what was requested (symlinks are always resolved, to tell directories and broken links).
+// Elsewhere it wraps fs::directory_iterator. "." and ".." are skipped.
+class DirScanner {
+  public:
+    enum Field : unsigned {
+        Size = 1,  // of regular files
+        Mtime = 2, // of every entry
+    };
+
+    struct Entry {
+        std::string_view name; // valid until the next call to next()
+        Tree::Meta meta;
+    };
+
+    // Throws fs::filesystem_error if `dir` cannot be opened.
+    explicit DirScanner(const fs::path &dir, unsigned fields = 0);
+    // Sets `ec` instead; a failed scanner yields no entries.
+    DirScanner(const fs::path &dir, unsigned fields, std::error_code &ec);
+    ~DirScanner();
+
+    DirScanner(const DirScanner &) = delete;
+    DirScanner &operator=(const DirScanner &) = delete;
+
+    // False at the end. A read error throws, or ends the scan and sets the error_code given to
+    // the constructor.
+    bool next(Entry &);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+    std::error_code *_ec = nullptr;
+};
+
+#endif
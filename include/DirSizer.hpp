@@ -0,0 +1,99 @@
+#ifndef DIRSIZER_HPP_
+#define DIRSIZER_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Computes recursive directory sizes on a background thread, walking each tree in parallel
+// on the shared pool. Every directory's total is cached by path, so subtrees already measured
+// are reused across navigation. A cached total is dropped when the directory's (device,
+// inode, mtime) no longer match, which catches changes to its own entries only: a file
+// growing, or anything deeper, leaves it alone. Such changes must be reported through
+// invalidate(), which drops the directory and every ancestor. A file with several hard links
+// is counted once per walk; a directory's total is only cached once every link of such a file
+// lies below it, so no cached total depends on which part of a walk came across a file first.
+class DirSizer {
+  public:
+    using Callback = std::function<void(const fs::path &dir, std::uintmax_t size)>;
+
+    explicit DirSizer(Callback callback);
+    ~DirSizer();
+
+    DirSizer(const DirSizer &) = delete;
+    DirSizer &operator=(const DirSizer &) = delete;
+
+    // Queues `dirs` behind earlier requests; each result is reported as soon as it is known.
+    void request(const std::vector<fs::path> &dirs);
+    // Drops queued requests and abandons the walk in progress.
+    void cancel();
+    // Forgets the totals of `path` and of every directory above it.
+    void invalidate(const fs::path &path);
+    // Forgets every total.
+    void invalidateAll();
+
+  private:
+    struct Key {
+        uint64_t dev = 0;
+        uint64_t ino = 0;
+        int64_t mtime = 0;
+        bool operator==(const Key &) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &k) const {
+            return std::hash<uint64_t>()(k.ino * 0x9E3779B97F4A7C15ull ^ k.dev ^ k.mtime);
+        }
+    };
+    struct Cached {
+        Key key;
+        std::uintmax_t size;
+    };
+    struct Links {
+        uint64_t seen = 0; // below the directory
+        uint64_t total = 0;
+    };
+    struct Measured {
+        std::uintmax_t size = 0;
+        // Multiply linked files below the directory that have links elsewhere too, keyed like
+        // Walk::seen. The total is only cached when this is empty.
+        std::unordered_map<Key, Links, KeyHash> open;
+    };
+    // State of one walk.
+    struct Walk {
+        uint64_t epoch; // of the cache when it began; results are only cached if unchanged
+        std::mutex mutex;
+        std::unordered_set<Key, KeyHash> seen; // multiply linked files counted; mtime unused
+        bool firstSighting(uint64_t dev, uint64_t ino);
+    };
+
+    Callback _callback;
+    std::mutex _mutex;
+    std::condition_variable_any _cv;
+    std::deque<fs::path> _queue;
+    std::unordered_set<std::string> _queued; // paths in _queue
+    std::atomic<uint64_t> _gen{0};
+    std::mutex _cacheMutex; // guards _cache and _epoch
+    std::unordered_map<std::string, Cached> _cache;
+    uint64_t _epoch = 0; // bumped by every invalidation
+    std::jthread _thread;
+
+    void loop(std::stop_token);
+    std::optional<Measured> sizeOf(const fs::path &, const Key &, uint64_t gen, std::stop_token,
+                                   Walk &);
+    static std::optional<Key> keyOf(const fs::path &);
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef DUPLICATES_HPP_
+#define DUPLICATES_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Finds files with the same contents below a directory, on a background thread. Each stage
+// only looks at files the previous one could not tell apart: sizes from the walk, then a
+// hash of the first and last kEdgeBytes, then a hash of the whole file read sequentially in
+// kReadSize blocks, largest files first, in parallel on the shared pool. Hard links to one
+// file are hashed once and reported together. Empty files, symlinks and VCS/dependency
+// directories are left out.
+class DuplicateFinder {
+  public:
+    enum class Stage {
+        Scanning,
+        Edges,
+        Contents,
+        Done
+    };
+
+    struct File {
+        fs::path path;
+        // Which of the group's copies this is, in [0, copies); files of a group with the same
+        // copy are hard links to one file.
+        uint32_t copy = 0;
+    };
+
+    struct Group {
+        std::uintmax_t size = 0; // of each file
+        uint32_t copies = 0;     // distinct inodes; all but one could be reclaimed
+        std::vector<File> files; // sorted by path
+    };
+
+    struct Status {
+        uint64_t gen = 0;
+        Stage stage = Stage::Scanning;
+        size_t files = 0;          // regular files found so far
+        std::uintmax_t hashed = 0; // bytes read by the current stage
+        std::uintmax_t toHash = 0;
+        std::vector<Group> groups; // set once Done, most reclaimable space first
+        std::string error;         // the root could not be read
+    };
+
+    using Callback = std::function<void(Status)>;
+    static constexpr size_t kEdgeBytes = 4096;
+    static constexpr size_t kReadSize = 1 << 20;
+    static constexpr auto kReportInterval = std::chrono::milliseconds(100);
+
+    explicit DuplicateFinder(Callback callback);
+    ~DuplicateFinder();
+
+    DuplicateFinder(const DuplicateFinder &) = delete;
+    DuplicateFinder &operator=(const DuplicateFinder &) = delete;
+
+    // Cancels the running search and queues one below `root`. Neither this nor cancel() waits
+    // for the old search to wind down.
+    void start(fs::path root);
+    void cancel();
+    uint64_t generation() const { return _gen.load(); }
+
+  private:
+    struct Search;
+
+    struct Request {
+        uint64_t gen;
+        fs::path root;
+    };
+
+    Callback _callback;
+    std::atomic<uint64_t> _gen{0};
+    std::mutex _mutex;
+    std::condition_variable_any _cv;
+    std::optional<Request> _request; // the newest start(), not picked up yet
+    std::jthread _thread;
+
+    void loop(std::stop_token);
+    void run(Search &);
+    void scan(Search &);
+    void report(Search &, bool force);
+};
+
+#endif
@@ -1,18 +1,38 @@
 #ifndef FILEMANAGER_HPP_
 #define FILEMANAGER_HPP_
 
+#include "ContentSearch.hpp"
+#include "DirCompare.hpp"
+#include "DirSizer.hpp"
+#include "Duplicates.hpp"
+#include "Fuzzy.hpp"
+#include "JobQueue.hpp"
+#include "Jump.hpp"
+#include "Listing.hpp"
+#include "PathIndex.hpp"
+#include "Preview.hpp"
+#include "Stats.hpp"
+#include "Tree.hpp"
+#include "UndoJournal.hpp"
+#include "Watcher.hpp"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/dom/elements.hpp>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <set>
-#include <shlobj.h>
-#include <stack>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -22,10 +42,12 @@ using namespace ftxui;
 class FileManager {
   public:
     FileManager() : cwd(fs::current_path()) {
-        expandedDirs.insert(cwd);
+        cwdNode = tree.intern(cwd);
+        tree.setExpanded(cwdNode, true);
         inputBox = ftxui::Input(&promptInput, "");
         promptContainer = ftxui::Container::Vertical({inputBox});
-        refresh();
+        loader = std::jthread([this](std::stop_token stop) { loaderLoop(stop); });
+        loadDir();
     }
 
     enum class TermCmds {
@@ -36,15 +58,7 @@ class FileManager {
         Edit,
         Open,
         CopyToSys,
-        Run,
-        FzfHxFile,
-        FzfClipFile,
-        FzfOpenFile,
-        FzfCdFile,
-        FzfHxCwd,
-        FzfClipCwd,
-        FzfOpenCwd,
-        FzfCdCwd
+        Run
     };
 
     enum class Prompt {
@@ -53,6 +67,7 @@ class FileManager {
         Replace,
         Move,
         Delete,
+        DeleteForever,
         NewFile,
         NewDir,
         Error,
@@ -60,6 +75,22 @@ class FileManager {
         Help,
         History,
         FzfMenu,
+        Fuzzy,
+        Grep,
+        Duplicates,
+        CompareWith,
+        Compare,
+        Sync,
+        Jobs,
+    };
+
+    // What a pick in the fuzzy finder does.
+    enum class FuzzyAction {
+        Edit,
+        Open,
+        Cd,
+        CopyPath,
+        CopyFile
     };
 
     enum class Mode {
@@ -67,49 +98,204 @@ class FileManager {
         Select
     };
 
+    // Delete records the original path as source and its place in the trash as target.
     struct Undo {
         Prompt type;
         fs::path source;
         fs::path target;
-        std::optional<std::string> contents;
+        std::vector<Undo> batch = {}; // steps of a batch operation, undone together
     };
+    static constexpr size_t kMaxUndo = 100;
+
+    using Transfers = std::vector<std::pair<fs::path, fs::path>>; // (from, to)
 
+    using Meta = Tree::Meta;
+
+    // A visible row: a node of `tree` and its indentation level below cwd.
     struct Entry {
-        fs::path path;
+        Tree::NodeId node;
         int depth;
     };
 
+    // Listing produced off the UI thread; interned into `tree` by internTree().
+    struct ScanNode {
+        std::vector<Tree::Item> items;
+        std::vector<std::pair<size_t, std::unique_ptr<ScanNode>>> subs; // item index -> subtree
+    };
+
+    using SortMode = ::SortMode;
+    using EntryOrder = ::EntryOrder;
+
     struct Drive {
         std::string path;
         std::string name;
     };
 
     fs::path cwd, promptPath;
+    Tree tree;
+    Tree::NodeId cwdNode = Tree::npos;
     std::vector<Entry> entries;
     fs::path selEntryPath;
     std::string promptInput, error;
     Component inputBox, promptContainer;
-    std::set<fs::path> expandedDirs, selItems;
-    std::vector<std::string> history;
+    JumpList jump;
     std::vector<Drive> drives;
     std::vector<size_t> parentIdxs;
     size_t selIdx = 0;
     size_t scrollOffset = 0;
     int selDriveIdx = 0;
-    int selHistIdx = 0;
+    size_t selHistIdx = 0;
     TermCmds termCmd = TermCmds::None;
+    std::optional<fs::path> termTarget; // overrides selEntryPath for the next termCmd
+    std::optional<uint32_t> termLine;   // line to open termTarget at
     Prompt prompt = Prompt::None;
     Mode mode = Mode::Normal;
-    std::optional<fs::path> copyPath, cutPath;
-    std::stack<Undo> undoStack;
-    bool clipCut = false;
+    SortMode sortMode = SortMode::Name;
+    bool sortReversed = false;
+    std::vector<fs::path> clipboard;
+    bool clipCut = false; // paste moves the clipboard instead of copying it
+    std::vector<fs::path> promptBatch; // selection a Delete/Move prompt applies to
+    std::vector<fs::path> promptOriginals; // copies a batch of duplicates must still match
+    std::deque<Undo> undoStack; // newest last, persisted through `journal`
+    std::map<uint64_t, Undo> undoing; // popped records by the id of their undo job; journaled
+    UndoJournal journal;
+    bool showStats = false; // timing overlay
+    bool showPreview = false;
+    Previewer::Result preview; // of selEntryPath, null while it is being built
+    fs::path statsFile;     // Stats are written here on exit, if set
+
+    // Closures queued by background threads, run on the UI thread via Event::Custom.
+    std::mutex inboxMutex;
+    std::vector<std::function<void()>> inbox;
+    ScreenInteractive *activeScreen = nullptr;
+    Watcher watcher{[this](std::vector<FsChange> changes) {
+        post([this, changes = std::move(changes)] { applyChanges(changes); });
+    }};
+    FuzzyFinder fuzzy{[this](FuzzyFinder::Results results) {
+        post([this, results = std::move(results)]() mutable {
+            setFuzzyResults(std::move(results));
+        });
+    }};
+    DirSizer dirSizer{[this](const fs::path &dir, std::uintmax_t size) {
+        post([this, dir, size] {
+            if (auto node = tree.find(dir)) tree.setDirSize(*node, size);
+        });
+    }};
+    Previewer previewer{[this](Previewer::Result result) {
+        post([this, result] {
+            if (showPreview && result->path == selEntryPath) preview = result;
+        });
+    }};
+    Indexer indexer{[this](fs::path root) { post([this, root] { indexer.install(root); }); }};
+    FuzzyFinder::Results fuzzyResults;
+    FuzzyAction fuzzyAction = FuzzyAction::Edit;
+    size_t fuzzyIdx = 0;
+
+    // Content search: hits accumulate as batches arrive; a new query starts over.
+    ContentSearch grep{[this](ContentSearch::Results results) {
+        post([this, results = std::move(results)]() mutable {
+            addGrepResults(std::move(results));
+        });
+    }};
+    std::vector<fs::path> grepRoots;
+    std::vector<ContentSearch::Hit> grepHits;
+    size_t grepFiles = 0;
+    bool grepDone = true;
+    bool grepCapped = false;
+    size_t grepIdx = 0;
+
+    // Duplicate finder: rows list each group's header (file npos) followed by its files.
+    DuplicateFinder duplicates{[this](DuplicateFinder::Status status) {
+        post([this, status = std::move(status)]() mutable {
+            setDuplicates(std::move(status));
+        });
+    }};
+    struct DupRow {
+        size_t group;
+        size_t file;
+    };
+    fs::path dupRoot;
+    DuplicateFinder::Status dupStatus;
+    std::vector<DupRow> dupRows;
+    size_t dupIdx = 0;
+
+    // Directory compare of compareLeft (the cwd it was started from) against compareRight.
+    // compareMarks holds the differences found on the left by path relative to compareLeft,
+    // and marks the directories above them Changed, for the tree view.
+    DirCompare compare{[this](DirCompare::Status status) {
+        post([this, status = std::move(status)]() mutable { setCompare(std::move(status)); });
+    }};
+    fs::path compareLeft, compareRight;
+    DirCompare::Status compareStatus;
+    std::unordered_map<std::string, DirCompare::Kind> compareMarks;
+    size_t compareIdx = 0;
+
+    // Background directory loading. Every navigation bumps loadGen; batches tagged with an
+    // older generation are dropped and the loader abandons the scan it is running.
+    struct LoadRequest {
+        uint64_t gen = 0;
+        fs::path dir;
+        std::set<fs::path> expanded;
+        EntryOrder order;
+    };
+    std::mutex loadMutex;
+    std::condition_variable_any loadCv;
+    LoadRequest loadRequest;
+    std::atomic<uint64_t> loadGen{0};
+    bool loading = false;
+    std::chrono::steady_clock::time_point loadStart;
+    std::optional<fs::path> pendingSelect;
+    std::set<Tree::NodeId> insertedWhileLoading;
+    std::jthread loader;
+
+    // File operations run as jobs; jobList mirrors their state for the UI.
+    std::vector<JobQueue::Status> jobList;
+    size_t selJobIdx = 0;
+    JobQueue jobs{[this](const JobQueue::Status &status, JobQueue::Completion done) {
+        post([this, status, done] {
+            updateJob(status);
+            if (done)
+                done();
+            else if (status.state != JobQueue::State::Queued &&
+                     status.state != JobQueue::State::Running)
+                finishUndo(status.id, std::nullopt); // dropped before it ran, or threw
+        });
+    }};
 
     // Core methods
     int Run();
     void refresh();
     void buildTree(const fs::path &, int);
+    static std::unique_ptr<ScanNode> scanTree(const fs::path &, const std::set<fs::path> &,
+                                              const EntryOrder &);
+    std::vector<Entry> scanTree(const fs::path &, int);
+    void internTree(Tree::NodeId, int, ScanNode &, std::vector<Entry> &);
+    std::set<fs::path> expandedPaths(Tree::NodeId under) const;
+    void loadDir();
+    void startIndexing();
+    void cancelLoad();
+    void loaderLoop(std::stop_token);
+    void mergeBatch(uint64_t, std::vector<Tree::Item>);
+    void finishLoad(uint64_t, std::vector<std::pair<std::string, std::unique_ptr<ScanNode>>>);
+    void spliceChildren(size_t, std::vector<Entry>);
+    void requestDirSizes(size_t begin, size_t end);
     std::vector<fs::path> entriesPaths() const;
+    fs::path entryPath(size_t idx) const { return tree.path(entries[idx].node); }
     int maxExpandedDepth() const;
+    EntryOrder order() const { return {sortMode, sortReversed, &tree}; }
+    void setSortMode(SortMode, bool reversed);
+    void sortRange(size_t, size_t, int, const EntryOrder &);
+
+    // Incremental updates
+    void post(std::function<void()>);
+    void drainInbox();
+    void applyChanges(const std::vector<FsChange> &);
+    void insertEntry(const fs::path &);
+    void removeEntry(const fs::path &);
+    std::optional<size_t> findEntry(const fs::path &) const;
+    std::optional<size_t> findEntry(Tree::NodeId) const;
+    void restoreSelection(const fs::path &);
+    void syncWatches();
 
     // Input handlers
     void handleEvent(Event, ScreenInteractive &);
@@ -124,10 +310,45 @@ class FileManager {
     void changeDrive(ScreenInteractive &);
     void changeDirFromHistory(ScreenInteractive &);
     void toggleSelect();
+    void openFuzzy(FuzzyAction, fs::path root);
+    void setFuzzyResults(FuzzyFinder::Results);
+    void acceptFuzzy(ScreenInteractive &);
+    void openGrep(std::vector<fs::path> roots);
+    void startGrep();
+    void addGrepResults(ContentSearch::Results);
+    void acceptGrep(bool inTree, ScreenInteractive &);
+    void openDuplicates(fs::path root);
+    void setDuplicates(DuplicateFinder::Status);
+    void moveDupCursor(int delta);
+    void markDuplicate(const fs::path &, bool on);
+    void markAllDuplicates();
+    bool dupMarked(const fs::path &) const;
+    void linkDuplicates();
+    void deleteDuplicates();
+    void submitLink(Transfers);
+    void startCompare(fs::path right);
+    void setCompare(DirCompare::Status);
+    void clearCompare();
+    Transfers syncItems() const;
+    std::optional<DirCompare::Kind> compareMark(Tree::NodeId) const;
+    void reveal(const fs::path &);
     void promptUser(Prompt);
-    std::optional<Prompt> tryPaste();
+    std::optional<Prompt> tryPaste(bool replace = false);
+    void submitCopy(Transfers, bool replace);
+    void submitMove(Prompt undoAs, Transfers);
+    void submitDelete(std::vector<fs::path>, std::vector<fs::path> originals = {});
+    void submitDeleteForever(std::vector<fs::path>);
+    void pushUndo(std::vector<Undo>);
+    void saveUndo();
+    void loadUndo();
+    std::vector<fs::path> selectionPaths() const;
+    void endBatch();
+    void updateJob(const JobQueue::Status &);
     void undo();
+    void finishUndo(uint64_t job, std::optional<std::vector<Undo>> left);
     void updateSelEntryPath();
+    void togglePreview();
+    void requestPreview();
 };
 
 #endif
@@ -0,0 +1,40 @@
+#ifndef FILEREADER_HPP_
+#define FILEREADER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// A regular file opened for positioned reads. Anything else (a fifo, a device, a directory,
+// including through a symlink) is refused without blocking, so walking a tree and reading
+// what it finds can never hang in open(). Unlike a mapping, a file that shrinks while it is
+// read only gives a short read.
+class FileReader {
+  public:
+    // `sequential` hints that the file will be read front to back.
+    explicit FileReader(const fs::path &path, bool sequential = false);
+    ~FileReader();
+
+    FileReader(const FileReader &) = delete;
+    FileReader &operator=(const FileReader &) = delete;
+
+    explicit operator bool() const;
+    std::uintmax_t size() const { return _size; } // when opened
+
+    // Bytes read, 0 at the end of the file, -1 on error.
+    int64_t readAt(char *buf, size_t n, uint64_t offset);
+    // Fills buf with n bytes at offset; false on a short read or an error.
+    bool readFully(char *buf, size_t n, uint64_t offset);
+
+  private:
+#ifdef _WIN32
+    void *_handle;
+#else
+    int _fd = -1;
+#endif
+    std::uintmax_t _size = 0;
+};
+
+#endif
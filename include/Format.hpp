@@ -0,0 +1,109 @@
+#ifndef FORMAT_HPP_
+#define FORMAT_HPP_
+
+#include "Tree.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+// Column and progress text, shared by the UI and the headless listing.
+
+inline std::string getFileTypeString(std::string_view extension, const Tree::Meta &meta) {
+    if (meta.brokenLink) return "brk";
+    if (meta.type == fs::file_type::none || meta.type == fs::file_type::not_found) return "mis";
+
+    if (meta.type == fs::file_type::regular) {
+        std::string ext(extension);
+        if (ext.length() >= 2) {
+            ext = ext.substr(1);
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (ext.length() > 3) ext = ext.substr(0, 3);
+            return ext;
+        }
+        return "non";
+    }
+
+    switch (meta.type) {
+    case fs::file_type::directory:
+        return "dir";
+    case fs::file_type::symlink:
+        return "sym";
+    case fs::file_type::block:
+        return "blk";
+    case fs::file_type::character:
+        return "chr";
+    case fs::file_type::fifo:
+        return "fif";
+    case fs::file_type::socket:
+        return "soc";
+    case fs::file_type::unknown:
+        return "unk";
+    default:
+        return "oth";
+    }
+}
+
+inline std::string formatSize(std::uintmax_t size) {
+    const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+    size_t unitIndex = 0;
+    double displaySize = static_cast<double>(size);
+    while (displaySize >= 1024 && unitIndex < 4) {
+        displaySize /= 1024;
+        ++unitIndex;
+    }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1) << displaySize << " " << units[unitIndex];
+    return oss.str();
+}
+
+// "m:ss" for a duration in seconds, "--:--" if unknown (negative).
+inline std::string formatDuration(double seconds) {
+    if (seconds < 0) return "--:--";
+    long secs = static_cast<long>(seconds + 0.5);
+    std::ostringstream oss;
+    oss << secs / 60 << ":" << std::setw(2) << std::setfill('0') << secs % 60;
+    return oss.str();
+}
+
+inline std::string getFileSizeString(const Tree::Meta &meta) {
+    if (meta.brokenLink) return "";
+    if (meta.isDir) return meta.sizeKnown ? formatSize(meta.size) : "";
+    if (meta.type != fs::file_type::regular && meta.type != fs::file_type::symlink) return "";
+    return formatSize(meta.size);
+}
+
+// File contents: a NUL byte among the first 8 KiB means binary.
+inline bool looksBinary(const char *data, size_t size) {
+    return std::memchr(data, '\0', std::min<size_t>(size, 8192)) != nullptr;
+}
+
+// One line of file contents for display: tabs expanded, other control characters shown as
+// '.', cut at maxColumns bytes without splitting a UTF-8 sequence.
+inline std::string displayLine(std::string_view line, size_t maxColumns) {
+    constexpr size_t kTabWidth = 4;
+    std::string out;
+    for (unsigned char c : line) {
+        if (c == '\t')
+            out.append(kTabWidth - out.size() % kTabWidth, ' ');
+        else
+            out += c < 0x20 || c == 0x7f ? '.' : static_cast<char>(c);
+        if (out.size() >= maxColumns) break;
+    }
+    if (out.size() > maxColumns) out.resize(maxColumns);
+    size_t cut = out.size();
+    while (cut > 0 && (static_cast<unsigned char>(out[cut - 1]) & 0xC0) == 0x80) --cut;
+    if (cut > 0 && static_cast<unsigned char>(out[cut - 1]) >= 0xC0) {
+        // Keep a trailing sequence only if it is complete.
+        unsigned char lead = static_cast<unsigned char>(out[cut - 1]);
+        size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+        if (out.size() - (cut - 1) < need) out.resize(cut - 1);
+    }
+    return out;
+}
+
+#endif
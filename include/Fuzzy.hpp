@@ -0,0 +1,91 @@
+#ifndef FUZZY_HPP_
+#define FUZZY_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+class PathIndex;
+
+// In-process fuzzy finder. A walker thread enumerates a directory tree into a chunked
+// candidate store while a matcher thread re-ranks it on every query change or new batch of
+// candidates, scoring chunks in parallel on the shared pool. Results are delivered through
+// the callback (on the matcher thread), tagged with the generation they were computed for.
+class FuzzyFinder {
+  public:
+    struct Match {
+        uint32_t id;
+        int score;
+        uint16_t len;
+    };
+
+    struct Results {
+        uint64_t gen = 0;
+        std::vector<Match> top; // best first, at most kMaxResults
+        size_t matched = 0;
+        size_t total = 0;
+        bool done = false; // enumeration finished
+    };
+
+    using Callback = std::function<void(Results)>;
+    static constexpr size_t kMaxResults = 200;
+
+    explicit FuzzyFinder(Callback callback);
+    ~FuzzyFinder();
+
+    FuzzyFinder(const FuzzyFinder &) = delete;
+    FuzzyFinder &operator=(const FuzzyFinder &) = delete;
+
+    // Starts enumerating files (or only directories) below `root` with an empty query. With an
+    // `index` covering root, candidates come from it instead of the disk.
+    void open(const fs::path &root, bool dirsOnly,
+              std::shared_ptr<const PathIndex> index = nullptr);
+    void close();
+    void setQuery(std::string query);
+
+    uint64_t generation() const { return _gen.load(); }
+    fs::path root() const;
+    // Candidate path relative to root().
+    std::string text(uint32_t id) const;
+
+    // Score of `text` against a space-separated `query` (0 = no match). Matched character
+    // positions are appended to `positions` when given.
+    static int score(std::string_view text, size_t nameStart, std::string_view query,
+                     std::vector<uint16_t> *positions = nullptr);
+    static std::vector<uint16_t> highlight(std::string_view text, std::string_view query);
+
+  private:
+    struct Chunk;
+    struct Store;
+    struct MatchState;
+
+    Callback _callback;
+    mutable std::mutex _mutex;
+    std::condition_variable_any _cv;
+    std::shared_ptr<Store> _store;
+    std::string _query;
+    std::atomic<uint64_t> _gen{0};
+    uint64_t _dataVersion = 0;
+    std::jthread _walker;
+    std::jthread _matcher;
+
+    void walk(std::stop_token, std::shared_ptr<Store>, bool dirsOnly);
+    void readIndex(std::stop_token, std::shared_ptr<Store>, bool dirsOnly, const PathIndex &);
+    void matchLoop(std::stop_token);
+    bool match(const std::shared_ptr<Store> &, const std::string &query, uint64_t gen,
+               MatchState &, Results &);
+    void notifyData();
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef HASH_HPP_
+#define HASH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Streaming 64-bit XXH64: fast enough to keep up with sequential reads, and the same digest
+// as the reference implementation whatever the split of the input into update() calls.
+// Not cryptographic. Assumes a little-endian host, as every supported platform is.
+class Hash64 {
+  public:
+    explicit Hash64(uint64_t seed = 0)
+        : _v{seed + kP1 + kP2, seed + kP2, seed, seed - kP1}, _seed(seed) {}
+
+    void update(const void *data, size_t size) {
+        auto *p = static_cast<const unsigned char *>(data);
+        const unsigned char *end = p + size;
+        _total += size;
+
+        if (_buffered + size < kStripe) {
+            std::memcpy(_buffer + _buffered, p, size);
+            _buffered += size;
+            return;
+        }
+        if (_buffered) {
+            size_t fill = kStripe - _buffered;
+            std::memcpy(_buffer + _buffered, p, fill);
+            stripe(_buffer);
+            p += fill;
+            _buffered = 0;
+        }
+        for (; end - p >= static_cast<ptrdiff_t>(kStripe); p += kStripe) stripe(p);
+        _buffered = static_cast<size_t>(end - p);
+        std::memcpy(_buffer, p, _buffered);
+    }
+
+    uint64_t digest() const {
+        uint64_t h;
+        if (_total >= kStripe) {
+            h = rotl(_v[0], 1) + rotl(_v[1], 7) + rotl(_v[2], 12) + rotl(_v[3], 18);
+            for (uint64_t v : _v) {
+                h ^= round(0, v);
+                h = h * kP1 + kP4;
+            }
+        } else {
+            h = _seed + kP5;
+        }
+        h += _total;
+
+        const unsigned char *p = _buffer, *end = _buffer + _buffered;
+        for (; end - p >= 8; p += 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * kP1 + kP4;
+        }
+        if (end - p >= 4) {
+            h ^= read32(p) * kP1;
+            h = rotl(h, 23) * kP2 + kP3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            h ^= *p * kP5;
+            h = rotl(h, 11) * kP1;
+        }
+
+        h ^= h >> 33;
+        h *= kP2;
+        h ^= h >> 29;
+        h *= kP3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t of(const void *data, size_t size, uint64_t seed = 0) {
+        Hash64 hash(seed);
+        hash.update(data, size);
+        return hash.digest();
+    }
+
+  private:
+    static constexpr uint64_t kP1 = 0x9E3779B185EBCA87ull;
+    static constexpr uint64_t kP2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr uint64_t kP3 = 0x165667B19E3779F9ull;
+    static constexpr uint64_t kP4 = 0x85EBCA77C2B2AE63ull;
+    static constexpr uint64_t kP5 = 0x27D4EB2F165667C5ull;
+    static constexpr size_t kStripe = 32;
+
+    uint64_t _v[4];
+    uint64_t _seed;
+    uint64_t _total = 0;
+    unsigned char _buffer[kStripe];
+    size_t _buffered = 0;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        return rotl(acc + input * kP2, 31) * kP1;
+    }
+    static uint64_t read64(const unsigned char *p) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+    static uint64_t read32(const unsigned char *p) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+    void stripe(const unsigned char *p) {
+        for (int i = 0; i < 4; ++i) _v[i] = round(_v[i], read64(p + 8 * i));
+    }
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef HISTORY_HPP_
+#define HISTORY_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Directory history as an append-only log of "<unix time>\t<weight>\t<path>" lines. A visit
+// appends one line; reading maps the file and sums every line's weight, halved for each
+// kHalfLifeDays since it was written, into a frecency score per directory. Once the log has
+// grown well past one line per directory, load() rewrites it with one line per directory
+// carrying its current score, which keeps the scores unchanged. Directories whose score has
+// decayed below kMinScore are dropped then; there is no cap on the number kept. A lock file
+// next to the log keeps visits from other instances from landing in a log being replaced.
+class History {
+  public:
+    struct Entry {
+        fs::path dir;
+        double score;
+    };
+
+    static constexpr double kHalfLifeDays = 14;
+    static constexpr double kMinScore = 1e-3; // about 20 weeks after a single visit
+
+    explicit History(fs::path file) : _file(std::move(file)) {}
+
+    void visit(const fs::path &dir, double weight = 1) const;
+    // Every directory by descending score. Compacts the log when due.
+    std::vector<Entry> load() const;
+
+  private:
+    fs::path _file;
+
+    fs::path lockFile() const;
+    std::vector<Entry> read(int64_t now, size_t &lines) const;
+    void compact(int64_t now) const;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef JOBQUEUE_HPP_
+#define JOBQUEUE_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Runs file operations on a few worker threads. Jobs start in submission order, except that
+// a job never starts while an earlier one touching an overlapping path (the same path, an
+// ancestor or a descendant) is queued or running, so dependent operations stay ordered.
+class JobQueue {
+  public:
+    enum class State {
+        Queued,
+        Running,
+        Done,
+        Failed,
+        Cancelled
+    };
+
+    struct Progress {
+        std::uintmax_t done = 0;
+        std::uintmax_t total = 0; // 0 = unknown
+        std::string detail;
+    };
+
+    struct Status {
+        uint64_t id = 0;
+        std::string title;
+        State state = State::Queued;
+        Progress progress;
+        std::string error;
+    };
+
+    // Not thread-safe: a job reporting from several threads must serialize the calls.
+    using Report = std::function<void(Progress)>;
+    // Run on the UI thread once the job has finished; applies its result there.
+    using Completion = std::function<void()>;
+    // Does the work on a worker thread. Throwing marks the job failed.
+    using Work = std::function<Completion(std::stop_token, const Report &)>;
+    // Thrown by a job that failed part way: it is marked failed, but `done` still runs so
+    // whatever did succeed is applied.
+    struct PartialFailure : std::runtime_error {
+        PartialFailure(const std::string &what, Completion done)
+            : std::runtime_error(what), done(std::move(done)) {}
+        Completion done;
+    };
+    // Called on state changes and (throttled) progress, from whichever thread caused them.
+    // `done` is the job's completion, set only with its final status.
+    using Callback = std::function<void(const Status &, Completion done)>;
+
+    static constexpr auto kReportInterval = std::chrono::milliseconds(100);
+
+    explicit JobQueue(Callback callback, unsigned workers = 4);
+    ~JobQueue();
+
+    JobQueue(const JobQueue &) = delete;
+    JobQueue &operator=(const JobQueue &) = delete;
+
+    uint64_t submit(std::string title, std::vector<fs::path> paths, Work work);
+    // Drops a queued job or asks a running one to stop.
+    void cancel(uint64_t id);
+
+  private:
+    struct Job {
+        uint64_t id;
+        std::string title;
+        std::vector<fs::path> paths;
+        Work work;
+        std::stop_source stop;
+    };
+
+    Callback _callback;
+    std::mutex _mutex;
+    std::condition_variable_any _cv;
+    std::deque<std::shared_ptr<Job>> _queued;
+    std::vector<std::shared_ptr<Job>> _running;
+    uint64_t _nextId = 1;
+    std::vector<std::jthread> _workers;
+
+    void workerLoop(std::stop_token);
+    std::shared_ptr<Job> takeRunnable();
+    static bool overlaps(const Job &, const Job &);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef JUMP_HPP_
+#define JUMP_HPP_
+
+#include "History.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// zoxide-style directory jumping over the whole history. A query is a list of
+// space-separated keywords that must appear, case-insensitively and in order, in a
+// directory's path; directories whose last component holds the last keyword rank first,
+// then by frecency. When nothing matches that way the keywords are fuzzy-matched instead.
+// Display strings, folded paths and a character-set mask per path (which rejects most
+// non-matches without a search) are built once per load().
+class JumpList {
+  public:
+    static constexpr size_t kMaxResults = 200;
+
+    // `entries` as returned by History::load(), best first.
+    void load(std::vector<History::Entry> entries, const fs::path &cwd);
+    // Narrowing queries (the previous one plus more characters) only re-test earlier hits.
+    void setQuery(std::string_view query);
+
+    const std::vector<uint32_t> &results() const { return _results; } // best first
+    size_t matched() const { return _matched; }
+    size_t size() const { return _dirs.size(); }
+    const fs::path &dir(uint32_t id) const { return _dirs[id]; }
+    const std::string &display(uint32_t id) const { return _display[id]; }
+
+  private:
+    std::vector<fs::path> _dirs;
+    std::vector<std::string> _display;
+    std::string _text;              // every lower-cased path, back to back
+    std::vector<uint32_t> _offset;  // start of each path in _text, plus one past the last
+    std::vector<uint32_t> _nameStart; // offset of the last component within its path
+    std::vector<uint64_t> _mask;      // charMask() of each lower-cased path
+
+    std::vector<uint32_t> containing(std::string_view key) const;
+    std::string_view folded(uint32_t id) const {
+        return std::string_view(_text).substr(_offset[id], _offset[id + 1] - _offset[id]);
+    }
+    std::vector<double> _score;
+
+    std::string _query;
+    std::vector<uint32_t> _hits; // every keyword match for _query, in id order
+    std::vector<uint32_t> _results;
+    size_t _matched = 0;
+};
+
+#endif
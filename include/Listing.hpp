@@ -0,0 +1,68 @@
+#ifndef LISTING_HPP_
+#define LISTING_HPP_
+
+#include "DirScanner.hpp"
+#include "Tree.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Listing logic shared by the UI and the headless `--list` mode; nothing here depends on
+// the terminal UI.
+
+enum class SortMode {
+    Name,
+    Natural,
+    Size,
+    Mtime,
+    Extension
+};
+
+// Ordering used for every listing: directories first, then by the selected key.
+struct EntryOrder {
+    SortMode mode = SortMode::Name;
+    bool reversed = false;
+    const Tree *tree = nullptr; // only needed to compare rows
+
+    bool less(const Tree::SortKey &, const Tree::SortKey &) const;
+    bool operator()(const Tree::Item &, const Tree::Item &) const;
+    // Rows referring to interned nodes (anything with a `node` member).
+    template <class Row>
+        requires requires(const Row &r) { r.node; }
+    bool operator()(const Row &a, const Row &b) const {
+        return less(tree->sortKey(a.node), tree->sortKey(b.node));
+    }
+};
+
+// Lists and sorts a single directory. Safe to call from any thread.
+std::vector<Tree::Item> scanDir(const fs::path &, const EntryOrder &,
+                                unsigned fields = DirScanner::Size | DirScanner::Mtime);
+
+enum class ListFormat {
+    Text,   // "<type>\t<size>\t<path>" lines
+    Ndjson, // one JSON object per line
+    Json,   // one JSON array
+    Null,   // NUL-terminated paths
+};
+
+struct ListOptions {
+    int depth = 1; // levels listed; 0 = unlimited
+    ListFormat format = ListFormat::Text;
+    EntryOrder order;
+};
+
+// Writes the tree below `root` to `out` depth first, in display order, each directory as
+// soon as it has been read; memory is bounded by the directories along the current path.
+// Output goes through a large buffer with no per-entry flush. Symlinked directories are
+// listed but not entered. Unreadable subdirectories are reported on stderr and skipped.
+// Returns false if anything could not be read or written.
+bool writeListing(const fs::path &root, const ListOptions &, std::FILE *out);
+
+// `FileManager --list ...`: parses the arguments after "--list" and runs writeListing on
+// stdout. Returns the process exit code.
+int listCommand(const std::vector<std::string_view> &args);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef MAPPEDFILE_HPP_
+#define MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Read-only memory mapping of a file, or of its first `limit` bytes. Empty (and false) if the
+// file could not be opened or mapped, or is not a regular file (symlinks are followed).
+class MappedFile {
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const fs::path &path, size_t limit = SIZE_MAX);
+    ~MappedFile();
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return _data; }
+    size_t size() const { return _size; } // of the mapping
+    std::uintmax_t fileSize() const { return _fileSize; }
+    explicit operator bool() const { return _data != nullptr; }
+
+  private:
+    const char *_data = nullptr;
+    size_t _size = 0;
+    std::uintmax_t _fileSize = 0;
+#ifdef _WIN32
+    void *_file = nullptr;
+    void *_mapping = nullptr;
+#endif
+
+    void reset();
+};
+
+#endif
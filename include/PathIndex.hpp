@@ -0,0 +1,98 @@
+#ifndef PATHINDEX_HPP_
+#define PATHINDEX_HPP_
+
+#include "MappedFile.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Read-only, memory-mapped index of every path below a root directory. Nodes are stored
+// breadth-first so each directory's children are contiguous and sorted by (case-folded)
+// name, so a path is looked up by binary search per component; names are deduplicated into
+// a sorted table. Queries never touch the filesystem.
+class PathIndex {
+  public:
+    using NodeId = uint32_t;
+    static constexpr NodeId npos = UINT32_MAX;
+
+    // Maps an index file written by build(). nullptr if missing, truncated or outdated.
+    static std::shared_ptr<const PathIndex> open(const fs::path &file);
+    // Walks `root` and writes a fresh index to `file`. Directories whose mtime still matches
+    // `previous` reuse its listing instead of being read again. Returns false if stopped.
+    static bool build(const fs::path &root, const fs::path &file, const PathIndex *previous,
+                      std::stop_token stop);
+    // Directories the index (and the fuzzy walker) never descend into.
+    static bool skipped(std::string_view name);
+
+    const fs::path &root() const { return _root; }
+    bool complete() const; // false if the walk hit the node limit
+    size_t size() const;
+
+    // Node for a path relative to root(), if indexed.
+    std::optional<NodeId> find(const fs::path &rel) const;
+    bool isDir(NodeId) const;
+    bool listed(NodeId) const; // a directory whose children are in the index
+    std::string relPath(NodeId) const;
+    // Calls `fn` with the path (relative to `node`) of every file, or every directory, below
+    // it, until `fn` returns false.
+    void forEach(NodeId node, bool dirsOnly,
+                 const std::function<bool(const std::string &)> &fn) const;
+
+  private:
+    struct Header;
+    struct Node;
+
+    MappedFile _file;
+    fs::path _root;
+    const Header *_header = nullptr;
+    const Node *_nodes = nullptr;
+    const uint32_t *_nameOffs = nullptr;
+    const char *_names = nullptr;
+
+    std::string_view name(uint32_t nameId) const {
+        return {_names + _nameOffs[nameId], _nameOffs[nameId + 1] - _nameOffs[nameId]};
+    }
+    NodeId child(NodeId dir, std::string_view name) const;
+};
+
+// Keeps one PathIndex per root under `dir`, refreshing them on a background thread.
+// Everything except the builder runs on the UI thread; `onBuilt` fires on the builder
+// thread and should hand control back to the UI thread before calling install().
+class Indexer {
+  public:
+    using Callback = std::function<void(fs::path root)>;
+
+    explicit Indexer(Callback onBuilt) : _onBuilt(std::move(onBuilt)) {}
+
+    // Maps the existing indexes for `roots` and starts refreshing them in the background.
+    void start(const fs::path &dir, std::vector<fs::path> roots);
+    // Swaps in the freshly built index for `root`.
+    void install(const fs::path &root);
+
+    // The complete index whose root contains `dir`, if any.
+    std::shared_ptr<const PathIndex> covering(const fs::path &dir) const;
+
+  private:
+    struct Entry {
+        fs::path root;
+        std::shared_ptr<const PathIndex> index;
+    };
+
+    Callback _onBuilt;
+    fs::path _dir;
+    std::vector<Entry> _entries;
+    std::jthread _builder;
+
+    fs::path fileFor(const fs::path &root) const;
+};
+
+#endif
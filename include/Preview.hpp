@@ -0,0 +1,102 @@
+#ifndef PREVIEW_HPP_
+#define PREVIEW_HPP_
+
+#include "Tree.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Builds previews of files and directories on a background thread: the head of a file, read
+// through a mapping of at most kWindow bytes, or the first kMaxEntries names of a directory.
+// A new request replaces the pending one and stops the one being built, so moving the cursor
+// never queues work. Finished previews are kept in an LRU keyed by path, size and mtime.
+class Previewer {
+  public:
+    static constexpr size_t kWindow = 64 * 1024; // bytes mapped per file
+    static constexpr size_t kMaxLines = 200;
+    static constexpr size_t kMaxColumns = 256;
+    static constexpr size_t kHexBytes = 4096; // shown of binary files
+    static constexpr size_t kMaxEntries = 2000;
+    static constexpr size_t kCacheSize = 64;
+
+    struct Preview {
+        enum class Kind {
+            Text,
+            Binary, // lines hold a hex dump
+            Directory,
+            Other, // devices, fifos, sockets: never opened
+            Error,
+        };
+
+        fs::path path;
+        Kind kind = Kind::Error;
+        std::vector<std::string> lines;
+        std::vector<Tree::Item> entries; // directories, sorted by name
+        std::uintmax_t size = 0;         // file size, or number of entries read
+        bool truncated = false;          // more lines or entries than shown
+        std::string error;
+    };
+    using Result = std::shared_ptr<const Preview>;
+    using Callback = std::function<void(Result)>;
+
+    explicit Previewer(Callback callback);
+    ~Previewer();
+
+    Previewer(const Previewer &) = delete;
+    Previewer &operator=(const Previewer &) = delete;
+
+    // Returns the cached preview of `path` if `meta` still matches it. Otherwise schedules
+    // one, reported through the callback, and returns null.
+    Result request(const fs::path &path, const Tree::Meta &meta);
+    // Drops the pending request and stops the one being built.
+    void cancel();
+
+  private:
+    struct Key {
+        std::string path;
+        std::uintmax_t size = 0;
+        int64_t mtime = 0;
+        bool operator==(const Key &) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &k) const {
+            return std::hash<std::string>()(k.path) ^ std::hash<int64_t>()(k.mtime) * 31 ^ k.size;
+        }
+    };
+    struct Request {
+        Key key;
+        fs::path path;
+        Tree::Meta meta;
+    };
+
+    Callback _callback;
+    std::mutex _mutex;
+    std::condition_variable_any _cv;
+    std::optional<Request> _pending;
+    std::optional<Key> _current; // being built, for generation _currentGen
+    uint64_t _currentGen = 0;
+    std::atomic<uint64_t> _gen{0};
+    // Most recently used first.
+    std::list<std::pair<Key, Result>> _lru;
+    std::unordered_map<Key, std::list<std::pair<Key, Result>>::iterator, KeyHash> _cache;
+    std::jthread _thread;
+
+    void loop(std::stop_token);
+    Result build(const Request &, uint64_t gen, std::stop_token);
+    static Key keyOf(const fs::path &, const Tree::Meta &);
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef STATS_HPP_
+#define STATS_HPP_
+
+#include "Trace.hpp"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+// Process-wide timers and counters for the hot paths. Recording is a few relaxed atomic
+// operations and takes no lock, so the instrumentation stays on in release builds and may be
+// used from any thread. Each timer keeps its last kSamples durations for the percentiles.
+class Stats {
+  public:
+    enum Timer : unsigned {
+        Frame,   // from an event (or redraw request) until FTXUI has painted the frame
+        Event,   // handleEvent, including draining the inbox
+        Render,  // building the element tree in UI::render
+        Paint,   // FTXUI layout and drawing into its screen buffer
+        Refresh, // synchronous refresh()
+        Load,    // background load of cwd, from loadDir() to finishLoad()
+        Scan,    // reading one directory in scanDir()
+        Sort,    // sorting a listing
+        kTimers
+    };
+    enum Counter : unsigned {
+        EntriesScanned, // directory entries returned by DirScanner
+        StatCalls,      // stat/statx calls issued by DirScanner
+        kCounters
+    };
+
+    static constexpr size_t kSamples = 256;
+
+    struct Summary {
+        uint64_t count = 0;
+        std::chrono::nanoseconds last{}, p50{}, p99{}, total{};
+    };
+
+    static void record(Timer, std::chrono::nanoseconds);
+    static void add(Counter, uint64_t n = 1);
+
+    static Summary summary(Timer);
+    static uint64_t counter(Counter);
+    static const char *name(Timer);
+    static const char *name(Counter);
+
+    // Frame timing: beginFrame() marks the start of the next frame unless one is pending,
+    // endFrame() records it.
+    static void beginFrame();
+    static void endFrame();
+
+    // Writes every timer and counter as a plain text table.
+    static void write(std::ostream &);
+};
+
+// Records the lifetime of the scope into a Stats timer and, while tracing, as a span named
+// after the timer (with `traceArg` as its detail).
+class ScopedTimer {
+  public:
+    explicit ScopedTimer(Stats::Timer timer)
+        : _timer(timer), _span(Stats::name(timer)), _start(std::chrono::steady_clock::now()) {}
+    ScopedTimer(Stats::Timer timer, const std::filesystem::path &traceArg)
+        : _timer(timer), _span(Stats::name(timer), traceArg),
+          _start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { Stats::record(_timer, std::chrono::steady_clock::now() - _start); }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  private:
+    Stats::Timer _timer;
+    TraceSpan _span;
+    std::chrono::steady_clock::time_point _start;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+// Work-stealing pool: every worker owns a deque, pops its own work LIFO and steals
+// from the other workers FIFO once it runs dry.
+class ThreadPool {
+  public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(unsigned threads = std::max(2u, std::thread::hardware_concurrency()));
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(Task task, const TaskGroup *group = nullptr);
+    // Runs one queued task of `group` on the calling thread, if there is one.
+    bool runPendingTask(const TaskGroup *group);
+    unsigned size() const { return static_cast<unsigned>(_workers.size()); }
+
+    static ThreadPool &shared();
+
+  private:
+    struct Queued {
+        Task task;
+        const TaskGroup *group; // null for plain submits
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Queued> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::atomic<size_t> _queued{0};
+    std::atomic<size_t> _nextQueue{0};
+    bool _stop = false;
+
+    bool tryPop(size_t self, Task &task);
+    bool tryPopFrom(const TaskGroup *group, Task &task);
+    void workerLoop(size_t index);
+};
+
+// Fork/join helper. wait() runs the group's own queued tasks on the calling thread and
+// sleeps while the rest are running elsewhere, so tasks may spawn and wait on nested groups
+// without deadlocking the pool, and a waiter never picks up unrelated work.
+class TaskGroup {
+  public:
+    explicit TaskGroup(ThreadPool &pool = ThreadPool::shared()) : _pool(pool) {}
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void run(std::function<void()> fn);
+    // Blocks until every task has finished and rethrows the first exception thrown.
+    void wait();
+
+  private:
+    ThreadPool &_pool;
+    std::mutex _mutex; // guards the rest
+    std::condition_variable _cv;
+    size_t _pending = 0; // run() but not finished
+    size_t _queued = 0;  // run() but not started
+    std::exception_ptr _error;
+};
+
+// Sorts chunks concurrently, then merges neighbouring runs pairwise in parallel rounds.
+// Not stable. Small ranges fall back to std::sort.
+template <class It, class Cmp> void parallelSort(It first, It last, Cmp cmp) {
+    constexpr size_t kSerialCutoff = 1 << 14;
+    size_t n = static_cast<size_t>(last - first);
+    if (n < kSerialCutoff) { // before touching the pool, so small sorts never start it
+        std::sort(first, last, cmp);
+        return;
+    }
+    ThreadPool &pool = ThreadPool::shared();
+    if (pool.size() < 2) {
+        std::sort(first, last, cmp);
+        return;
+    }
+
+    size_t chunks = std::min<size_t>(pool.size() * 2, n / (kSerialCutoff / 4));
+    std::vector<It> bounds;
+    for (size_t i = 0; i <= chunks; ++i) bounds.push_back(first + (n * i) / chunks);
+
+    TaskGroup group(pool);
+    for (size_t i = 0; i < chunks; ++i)
+        group.run([&, i] { std::sort(bounds[i], bounds[i + 1], cmp); });
+    group.wait();
+
+    while (bounds.size() > 2) {
+        std::vector<It> next;
+        for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+            next.push_back(bounds[i]);
+            group.run([&, i] { std::inplace_merge(bounds[i], bounds[i + 1], bounds[i + 2], cmp); });
+        }
+        if (bounds.size() % 2 == 0) next.push_back(bounds[bounds.size() - 2]); // odd run out
+        next.push_back(bounds.back());
+        group.wait();
+        bounds.swap(next);
+    }
+}
+
+#endif
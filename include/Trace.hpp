@@ -0,0 +1,73 @@
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+// Opt-in span recorder that writes Chrome trace-event JSON (chrome://tracing, Perfetto).
+// Every thread appends to its own fixed-size ring, allocated with its first span, so
+// recording takes no lock; a long session keeps the latest kRingSize spans of each thread.
+// While tracing is off a span costs one relaxed atomic load.
+class Trace {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t kRingSize = 1 << 14;
+    static constexpr size_t kArgSize = 104; // longer arguments are truncated
+
+    // Starts recording; stop() writes the trace to `file`.
+    static void start(fs::path file);
+    // Stops recording and writes everything buffered. False if the file could not be written.
+    static bool stop();
+    static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    // Labels the calling thread in the viewer.
+    static void setThreadName(std::string_view);
+    // `name` must be a string literal (or otherwise outlive the trace).
+    static void record(const char *name, std::string_view arg, Clock::time_point begin,
+                       Clock::time_point end);
+
+  private:
+    static inline std::atomic<bool> _enabled{false};
+};
+
+// Records its own lifetime as a span, if tracing is on when it is created.
+class TraceSpan {
+  public:
+    explicit TraceSpan(const char *name) {
+        if (Trace::enabled()) begin(name);
+    }
+    // `arg` (a string or a path) becomes the span's detail; it is only copied while tracing.
+    template <class Arg> TraceSpan(const char *name, const Arg &arg) {
+        if (!Trace::enabled()) return;
+        if constexpr (std::is_same_v<Arg, fs::path>)
+            _arg = arg.string();
+        else
+            _arg = std::string_view(arg);
+        begin(name);
+    }
+    ~TraceSpan() {
+        if (_name) Trace::record(_name, _arg, _start, Trace::Clock::now());
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+  private:
+    const char *_name = nullptr;
+    std::string _arg;
+    Trace::Clock::time_point _start;
+
+    void begin(const char *name) {
+        _name = name;
+        _start = Trace::Clock::now();
+    }
+};
+
+#endif
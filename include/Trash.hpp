@@ -0,0 +1,34 @@
+#ifndef TRASH_HPP_
+#define TRASH_HPP_
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Deleting by moving into a trash directory on the item's own file system, so a delete is a
+// single rename and undoing it is another. Uses the XDG layout (files/ plus
+// info/<name>.trashinfo): the home trash for items on the home file system,
+// $topdir/.Trash-$uid on other mounts. Windows has no XDG trash; each volume gets a hidden
+// .FileManagerTrash directory with the same layout instead of the Recycle Bin, whose items
+// cannot be renamed back.
+class Trash {
+  public:
+    // Thrown by put() when the item's file system has no trash and none can be made there.
+    struct Unavailable : fs::filesystem_error {
+        using fs::filesystem_error::filesystem_error;
+    };
+
+    // Moves `path` into the trash and returns its new location. Throws fs::filesystem_error,
+    // or Unavailable if there is nowhere to put it.
+    static fs::path put(const fs::path &path);
+    // Renames a trashed item back to `original`, which must not exist.
+    static void restore(const fs::path &trashed, const fs::path &original);
+    // Deletes a trashed item and its info file for good.
+    static void purge(const fs::path &trashed);
+
+  private:
+    static fs::path dirFor(const fs::path &path);
+    static fs::path infoFor(const fs::path &trashed);
+};
+
+#endif
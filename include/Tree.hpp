@@ -0,0 +1,135 @@
+#ifndef TREE_HPP_
+#define TREE_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Compact model of every directory the UI has listed. Names are interned once in an
+// append-only arena, nodes point at their parent by index and per-node data lives in
+// parallel arrays; full paths are only assembled on demand. Owned by the UI thread.
+class Tree {
+  public:
+    using NodeId = uint32_t;
+    static constexpr NodeId npos = UINT32_MAX;
+
+    // Metadata captured once per scan so rendering never has to touch the disk.
+    struct Meta {
+        fs::file_type type = fs::file_type::none; // type of the entry itself (lstat)
+        bool isDir = false;                       // follows symlinks
+        bool brokenLink = false;
+        std::uintmax_t size = 0; // regular files, or directories once sizeKnown
+        fs::file_time_type mtime{};
+        bool sizeKnown = false; // directories: size holds the recursive total
+
+        static Meta read(const fs::directory_entry &);
+        static Meta read(const fs::path &);
+    };
+
+    // A directory entry produced by a scan (on any thread), before it is interned.
+    struct Item {
+        std::string name;
+        std::string sortName; // lowercased name
+        size_t extPos = std::string::npos;
+        Meta meta;
+
+        static Item make(std::string name, const Meta &meta);
+    };
+
+    struct SortKey {
+        bool isDir;
+        std::string_view sortName;
+        std::string_view ext;
+        std::uintmax_t size;
+        fs::file_time_type mtime;
+    };
+
+    Tree();
+
+    // Node for an absolute path, creating missing components.
+    NodeId intern(const fs::path &);
+    std::optional<NodeId> find(const fs::path &) const;
+    NodeId child(NodeId parent, std::string_view name);
+    NodeId findChild(NodeId parent, std::string_view name) const;
+    NodeId add(NodeId parent, const Item &);
+
+    fs::path path(NodeId) const;
+    std::string_view name(NodeId id) const { return {chars(_nameOff[id]), _nameLen[id]}; }
+    std::string_view extension(NodeId) const;
+    NodeId parent(NodeId id) const { return _parent[id]; }
+    bool isAncestor(NodeId ancestor, NodeId id) const;
+
+    Meta meta(NodeId) const;
+    void setMeta(NodeId, const Meta &);
+    void setDirSize(NodeId, std::uintmax_t);
+    bool isDir(NodeId id) const { return _flags[id] & IsDir; }
+    SortKey sortKey(NodeId) const;
+
+    bool expanded(NodeId id) const { return _flags[id] & Expanded; }
+    bool selected(NodeId id) const { return _flags[id] & Selected; }
+    void setExpanded(NodeId, bool);
+    void setSelected(NodeId, bool);
+    const std::vector<NodeId> &expandedNodes() const { return _expanded; }
+    // Expanded descendants of `under` reachable through expanded directories only: those
+    // whose children are listed when `under` is.
+    std::vector<NodeId> expandedBelow(NodeId under) const;
+    std::vector<NodeId> selection() const;
+    void clearExpanded();
+    void clearSelection();
+    size_t selectionCount() const { return _selectedCount; }
+
+    size_t size() const { return _parent.size(); }
+    // Drops every node that is not in `keep`, flagged, or an ancestor of one of those.
+    // Returns the old -> new id mapping (npos for dropped nodes).
+    std::vector<NodeId> compact(const std::vector<NodeId> &keep);
+
+  private:
+    enum Flag : uint8_t {
+        IsDir = 1,
+        BrokenLink = 2,
+        Expanded = 4,
+        Selected = 8,
+        SizeKnown = 16, // directory size computed by DirSizer
+    };
+    static constexpr uint32_t kChunkBits = 20; // 1 MiB arena chunks
+    static constexpr uint16_t kNoExt = UINT16_MAX;
+
+    std::vector<std::unique_ptr<char[]>> _chunks;
+    uint32_t _chunkUsed = 0;
+
+    std::vector<NodeId> _parent;
+    std::vector<uint32_t> _nameOff; // lowercased copy follows the name in the arena
+    std::vector<uint16_t> _nameLen;
+    std::vector<uint16_t> _extPos;
+    std::vector<uint8_t> _type;
+    std::vector<uint8_t> _flags;
+    std::vector<std::uintmax_t> _size;
+    std::vector<fs::file_time_type::rep> _mtime;
+    std::vector<uint32_t> _hash;
+
+    std::vector<NodeId> _slots; // open-addressing index keyed by (parent, name)
+    std::vector<NodeId> _expanded; // a handful at a time, so kept apart from the flags
+    size_t _selectedCount = 0;
+
+    const char *chars(uint32_t off) const {
+        return _chunks[off >> kChunkBits].get() + (off & ((1u << kChunkBits) - 1));
+    }
+    std::string_view sortName(NodeId id) const {
+        return {chars(_nameOff[id] + _nameLen[id]), _nameLen[id]};
+    }
+    void setFlag(NodeId id, uint8_t flag, bool on) {
+        _flags[id] = on ? _flags[id] | flag : _flags[id] & ~flag;
+    }
+    uint32_t store(std::string_view name);
+    NodeId append(NodeId parent, std::string_view name, uint32_t hash);
+    void rehash(size_t capacity);
+    static uint32_t hashOf(NodeId parent, std::string_view name);
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/dom/elements.hpp>
+#include <ftxui/dom/node.hpp>
 #include <regex>
 #include <unordered_map>
 
@@ -17,9 +18,6 @@ class UI {
 
     ftxui::Element render(ftxui::ScreenInteractive &screen);
 
-  private:
-    const FileManager &_fm;
-
     struct Layout {
         int total_width;
         int max_indent_width;
@@ -35,6 +33,10 @@ class UI {
 
         static Layout compute(int screen_width, int max_expanded_depth);
     };
+
+  private:
+    const FileManager &_fm;
+
     ftxui::Element createPromptBox(const ftxui::Element &main_view, const std::string &title,
                                    std::optional<ftxui::Element> body_opt = std::nullopt);
 
@@ -43,10 +45,19 @@ class UI {
     ftxui::Element createDriveSelectOverlay(const ftxui::Element &main_view);
     ftxui::Element createHistoryOverlay(const ftxui::Element &main_view);
     ftxui::Element createFzfMenuOverlay(const ftxui::Element &main_view);
+    ftxui::Element createFuzzyOverlay(const ftxui::Element &main_view);
+    ftxui::Element createGrepOverlay(const ftxui::Element &main_view);
+    ftxui::Element createDuplicatesOverlay(const ftxui::Element &main_view);
+    ftxui::Element createCompareOverlay(const ftxui::Element &main_view);
+    ftxui::Element createJobsOverlay(const ftxui::Element &main_view);
+    ftxui::Element createJobStatus();
+    ftxui::Element createStatsOverlay();
+    ftxui::Element createPreviewPane(int height);
+    ftxui::Element jobElement(const JobQueue::Status &job);
     ftxui::Element createOverlay(const ftxui::Element &main_view);
 
-    ftxui::Element fileElement(const std::filesystem::path &p, bool isDir,
-                               const std::set<std::filesystem::path> &expandedDirs);
+    ftxui::Element fileElement(std::string_view name, std::string_view ext, bool isDir,
+                               bool expanded);
 };
 
 #endif
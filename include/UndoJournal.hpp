@@ -0,0 +1,49 @@
+#ifndef UNDOJOURNAL_HPP_
+#define UNDOJOURNAL_HPP_
+
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Keeps the undo history on disk so it survives restarts. Saving and purging trashed items
+// happen on a background thread; only the newest pending snapshot is written.
+class UndoJournal {
+  public:
+    struct Step {
+        std::string type; // "rename", "move", "delete", "newfile" or "newdir"
+        fs::path source, target;
+    };
+    using Record = std::vector<Step>; // one undo step: a single operation or a batch
+
+    UndoJournal();
+    ~UndoJournal();
+
+    UndoJournal(const UndoJournal &) = delete;
+    UndoJournal &operator=(const UndoJournal &) = delete;
+
+    // Reads the records stored in `file` (oldest first); later saves go there too.
+    std::vector<Record> open(const fs::path &file);
+    void save(std::vector<Record> records);
+    // Deletes trashed items for good, e.g. once their record falls off the history.
+    void purge(std::vector<fs::path> trashed);
+
+  private:
+    std::mutex _mutex;
+    std::condition_variable_any _cv;
+    fs::path _file;
+    std::optional<std::vector<Record>> _pending;
+    std::vector<fs::path> _purge;
+    std::jthread _thread;
+
+    void loop(std::stop_token);
+    void write(const fs::path &file, const std::vector<Record> &records) const;
+};
+
+#endif
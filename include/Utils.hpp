@@ -2,6 +2,8 @@
 #define UTILS_HPP_
 
 #include "FileManager.hpp"
+#include "Format.hpp"
+#include "History.hpp"
 #include <codecvt>
 #include <cstdio>
 #include <filesystem>
@@ -10,16 +12,30 @@
 #include <iomanip>
 #include <nlohmann/json.hpp>
 #include <regex>
-#include <shlobj.h>
 #include <sstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
+
+#ifdef _WIN32
+#include <shlobj.h>
 #include <windows.h>
+#else
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
+// --- Platform layer: Windows ---
+#ifdef _WIN32
+
+// Quoted for cmd.exe.
+inline std::string shellQuote(const std::string &s) { return "\"" + s + "\""; }
+
 inline std::string getAppDataDir() {
     static std::string appDataDir = [] {
         PWSTR path = NULL;
@@ -37,60 +53,11 @@ inline std::string getAppDataDir() {
     return appDataDir;
 }
 
-inline void writeToAppDataRoamingFile(const std::string &changePath) {
-    static const std::string appDataDir = getAppDataDir();
-    static const std::string historyFile = appDataDir + "\\history.txt";
-    static const std::string historyJsonFile = appDataDir + "\\history.json";
-
-    {
-        std::ofstream outFile(historyFile);
-        outFile << changePath;
-    }
-
-    json historyData;
-
-    if (fs::exists(historyJsonFile)) {
-        std::ifstream inJson(historyJsonFile);
-        try {
-            inJson >> historyData;
-        } catch (...) { historyData = json::object(); }
-    }
-
-    if (!historyData.is_object()) historyData = json::object();
-
-    if (historyData.contains(changePath))
-        historyData[changePath] = historyData[changePath].get<int>() + 1;
-    else
-        historyData[changePath] = 1;
-
-    {
-        std::ofstream outJson(historyJsonFile);
-        outJson << historyData.dump(4);
-    }
-}
-
-inline bool edit(const std::string &arg) {
-    std::system(("hx \"" + arg + "\"").c_str());
-    return true;
-}
-
 inline bool start(const std::string &arg) {
-    std::system(("start /B explorer \"" + arg + "\"").c_str());
+    std::system(("start /B explorer " + shellQuote(arg)).c_str());
     return true;
 }
 
-inline bool changeDir(const fs::path &arg) {
-    if (fs::is_directory(arg)) {
-        writeToAppDataRoamingFile(arg.string());
-        return true;
-
-    } else {
-        writeToAppDataRoamingFile(arg.parent_path().string());
-        return true;
-    }
-    return false;
-}
-
 inline bool copyFileToClip(const std::string &utf8Path) {
     int wlen = MultiByteToWideChar(CP_UTF8, 0, utf8Path.c_str(), -1, nullptr, 0);
     if (wlen == 0) return false;
@@ -171,45 +138,6 @@ inline std::vector<FileManager::Drive> listDrives() {
     return drives;
 }
 
-inline std::vector<std::string> listHistory() {
-    static std::vector<std::string> history;
-    if (history.empty()) {
-        static const std::string appDataDir = getAppDataDir();
-        static const std::string historyFile = appDataDir + "\\history.json";
-
-        std::ifstream inFile(historyFile);
-        if (!inFile.is_open()) return history;
-
-        json j;
-        inFile >> j;
-        if (!j.is_object()) return history;
-
-        auto counts = j.get<std::unordered_map<std::string, int>>();
-        std::vector<std::pair<std::string, int>> sorted(counts.begin(), counts.end());
-        std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
-            if (a.second != b.second) return a.second > b.second;
-            return a.first < b.first;
-        });
-
-        for (size_t i = 0; i < sorted.size() && i < 5; ++i) {
-            fs::path absPath(sorted[i].first);
-            history.push_back(absPath.string());
-        }
-    }
-    return history;
-}
-
-inline void deleteFilOrDir(const fs::path &p) {
-    if (fs::is_directory(p))
-        fs::remove_all(p);
-    else
-        fs::remove(p);
-}
-
-inline void deleteFilOrDir(const std::set<fs::path> &paths) {
-    for (const auto &p : paths) { deleteFilOrDir(p); }
-}
-
 inline bool runFileFromTerm(const fs::path &path) {
     if (!fs::exists(path)) { return true; }
 
@@ -217,121 +145,211 @@ inline bool runFileFromTerm(const fs::path &path) {
     std::string ext = path.extension().string();
 
     if (ext == ".py") {
-        cmd = "start cmd /C python \"" + path.string() + "\"";
+        cmd = "start cmd /C python " + shellQuote(path.string());
     } else {
-        cmd = "start \"\" \"" + path.string() + "\"";
+        cmd = "start \"\" " + shellQuote(path.string());
     }
     std::system(cmd.c_str());
     return true;
 }
 
-inline std::optional<fs::path> runFzf(const fs::path &dir) {
-    if (!fs::exists(dir) || !fs::is_directory(dir)) return std::nullopt;
+#else // --- Platform layer: POSIX ---
 
-    std::string cmd = "cd /d \"" + dir.string() + "\" && fzf";
+// Single-quoted for /bin/sh.
+inline std::string shellQuote(const std::string &s) {
+    std::string out = "'";
+    for (char c : s) out += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    return out + "'";
+}
 
-    FILE *pipe = _popen(cmd.c_str(), "r");
-    if (!pipe) return std::nullopt;
+// $XDG_CONFIG_HOME/FileManager, by default ~/.config/FileManager.
+inline std::string getAppDataDir() {
+    static std::string appDataDir = [] {
+        fs::path base;
+        if (const char *xdg = std::getenv("XDG_CONFIG_HOME"); xdg && *xdg)
+            base = xdg;
+        else if (const char *home = std::getenv("HOME"); home && *home)
+            base = fs::path(home) / ".config";
+        if (base.empty()) return std::string();
+        std::error_code ec;
+        fs::create_directories(base / "FileManager", ec);
+        return ec ? std::string() : (base / "FileManager").string();
+    }();
+    return appDataDir;
+}
 
-    char buffer[4096];
-    std::string selected;
-    if (fgets(buffer, sizeof(buffer), pipe) != nullptr) { selected = buffer; }
+#ifdef __APPLE__
+inline constexpr const char *kOpenCommand = "open";
+#else
+inline constexpr const char *kOpenCommand = "xdg-open";
+#endif
 
-    _pclose(pipe);
+inline bool start(const std::string &arg) {
+    std::string cmd = std::string(kOpenCommand) + " " + shellQuote(arg) + " >/dev/null 2>&1 &";
+    std::system(cmd.c_str());
+    return true;
+}
 
-    while (!selected.empty() && (selected.back() == '\n' || selected.back() == '\r')) {
-        selected.pop_back();
+// Hands `data` to the system clipboard tool: pbcopy on macOS, wl-copy on Wayland, else xclip.
+// Fed from a temporary file rather than a pipe, so a missing tool cannot raise SIGPIPE.
+inline bool pipeToClipboard(const std::string &data, const std::string &mime) {
+#ifdef __APPLE__
+    std::string cmd = "pbcopy";
+#else
+    std::string cmd = std::getenv("WAYLAND_DISPLAY") ? "wl-copy --type " + mime
+                                                     : "xclip -selection clipboard -t " + mime;
+#endif
+    fs::path tmp = fs::temp_directory_path() / ("FileManager-clip-" + std::to_string(getpid()));
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        out << data;
+        if (!out) return false;
     }
+    int rc = std::system((cmd + " < " + shellQuote(tmp.string()) + " >/dev/null 2>&1").c_str());
+    std::error_code ec;
+    fs::remove(tmp, ec);
+    return rc == 0;
+}
 
-    if (!selected.empty()) {
-        fs::path fullPath = fs::absolute(dir / selected);
-        return fullPath;
+// As a file:// URI, which file managers paste as the file itself.
+inline bool copyFileToClip(const std::string &utf8Path) {
+    std::string uri = "file://";
+    for (unsigned char c : fs::absolute(utf8Path).string()) {
+        if (std::isalnum(c) || std::strchr("/-._~", c)) {
+            uri += static_cast<char>(c);
+        } else {
+            char hex[4];
+            std::snprintf(hex, sizeof(hex), "%%%02X", c);
+            uri += hex;
+        }
     }
+    return pipeToClipboard(uri + "\n", "text/uri-list");
+}
 
-    return std::nullopt;
+inline bool copyPathToClip(const std::string &utf8Path) {
+    return pipeToClipboard(utf8Path, "text/plain");
 }
 
-inline std::string formatHistoryPath(const fs::path &absPath, const fs::path &cwd) {
-    try {
-        // 1. Try relative to cwd
-        fs::path relToCwd = fs::relative(absPath, cwd);
-        if (!relToCwd.empty() && relToCwd.string().find("..") != 0) { return relToCwd.string(); }
-    } catch (const fs::filesystem_error &) {}
-
-    try {
-        const char *homeEnv = std::getenv("USERPROFILE");
-        if (homeEnv) {
-            fs::path home(homeEnv);
-            fs::path relToHome = fs::relative(absPath, home);
-            if (!relToHome.empty() && relToHome.string().find("..") != 0) {
-                return std::string("~\\") + relToHome.string();
+// Mount points of real devices, read from /proc/self/mounts (just "/" where that is missing).
+inline std::vector<FileManager::Drive> listDrives() {
+    static std::vector<FileManager::Drive> drives;
+    if (drives.empty()) {
+        std::ifstream mounts("/proc/self/mounts");
+        std::string device, dir, rest;
+        while (mounts >> device >> dir && std::getline(mounts, rest)) {
+            if (device.rfind("/dev/", 0) != 0 || dir.rfind("/snap/", 0) == 0) continue;
+            // Spaces and tabs in mount points are escaped as octal ("\040").
+            std::string path;
+            for (size_t i = 0; i < dir.size(); ++i) {
+                if (dir[i] == '\\' && i + 3 < dir.size()) {
+                    path += static_cast<char>(std::stoi(dir.substr(i + 1, 3), nullptr, 8));
+                    i += 3;
+                } else {
+                    path += dir[i];
+                }
             }
+            if (std::none_of(drives.begin(), drives.end(),
+                             [&](const FileManager::Drive &d) { return d.path == path; }))
+                drives.push_back({path, fs::path(device).filename().string()});
         }
-    } catch (const fs::filesystem_error &) {}
-
-    return absPath.string();
+        if (drives.empty()) drives.push_back({"/", ""});
+    }
+    return drives;
 }
 
-inline std::string getFileTypeString(const fs::path &p) {
-    std::error_code ec;
+// Runs in the terminal the UI has just left: Python scripts through python3, executables
+// directly, anything else through the desktop's opener.
+inline bool runFileFromTerm(const fs::path &path) {
+    if (!fs::exists(path)) { return true; }
+
+    std::string cmd;
+    std::string ext = path.extension().string();
 
-    if (!fs::exists(p, ec)) {
-        if (fs::is_symlink(p, ec)) return "brk";
-        return "mis";
+    if (ext == ".py") {
+        cmd = "python3 " + shellQuote(path.string());
+    } else if (fs::is_regular_file(path) && ::access(path.c_str(), X_OK) == 0) {
+        cmd = shellQuote(path.string());
+    } else {
+        cmd = std::string(kOpenCommand) + " " + shellQuote(path.string()) + " >/dev/null 2>&1";
     }
+    std::system(cmd.c_str());
+    return true;
+}
 
-    fs::file_status status = fs::symlink_status(p, ec);
+#endif
 
-    if (status.type() == fs::file_type::regular) {
-        auto ext = p.extension().string();
-        if (ext.length() >= 2) {
-            ext = ext.substr(1);
-            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-            if (ext.length() > 3) ext = ext.substr(0, 3);
-            return ext;
-        }
-        return "non";
+// The frecency log, imported once from the old history.json (visit counts) if present.
+inline History openHistory() {
+    static const std::string appDataDir = getAppDataDir();
+    History history(fs::path(appDataDir) / "history.log");
+    static bool imported = [&] {
+        fs::path legacy = fs::path(appDataDir) / "history.json";
+        if (fs::exists(fs::path(appDataDir) / "history.log") || !fs::exists(legacy)) return true;
+        std::ifstream in(legacy);
+        try {
+            json j;
+            in >> j;
+            if (j.is_object())
+                for (auto &[dir, count] : j.items()) history.visit(dir, count.get<int>());
+        } catch (...) {}
+        return true;
+    }();
+    (void)imported;
+    return history;
+}
+
+// history.txt holds only the last directory, for the shell wrapper to cd into on exit.
+inline void writeToAppDataRoamingFile(const std::string &changePath) {
+    static const std::string appDataDir = getAppDataDir();
+    static const std::string historyFile = (fs::path(appDataDir) / "history.txt").string();
+
+    {
+        std::ofstream outFile(historyFile);
+        outFile << changePath;
     }
 
-    switch (status.type()) {
-    case fs::file_type::directory:
-        return "dir";
-    case fs::file_type::symlink:
-        return "sym";
-    case fs::file_type::block:
-        return "blk";
-    case fs::file_type::character:
-        return "chr";
-    case fs::file_type::fifo:
-        return "fif";
-    case fs::file_type::socket:
-        return "soc";
-    case fs::file_type::unknown:
-        return "unk";
-    case fs::file_type::none:
-        return "non";
-    default:
-        return "oth";
+    if (fs::path(changePath).is_absolute()) openHistory().visit(changePath);
+}
+
+// A non-zero `line` opens the file at that line.
+inline bool edit(const std::string &arg, size_t line = 0) {
+    std::string target = line ? arg + ":" + std::to_string(line) : arg;
+    std::system(("hx " + shellQuote(target)).c_str());
+    return true;
+}
+
+inline bool changeDir(const fs::path &arg) {
+    if (fs::is_directory(arg)) {
+        writeToAppDataRoamingFile(arg.string());
+        return true;
+
+    } else {
+        writeToAppDataRoamingFile(arg.parent_path().string());
+        return true;
     }
+    return false;
 }
 
-inline std::string getFileSizeString(const fs::path &p) {
-    try {
-        if (fs::is_regular_file(p)) {
-            auto size = fs::file_size(p);
-            const char *units[] = {"B", "KB", "MB", "GB", "TB"};
-            size_t unitIndex = 0;
-            double displaySize = static_cast<double>(size);
-            while (displaySize >= 1024 && unitIndex < 4) {
-                displaySize /= 1024;
-                ++unitIndex;
-            }
-            std::ostringstream oss;
-            oss << std::fixed << std::setprecision(1) << displaySize << " " << units[unitIndex];
-            return oss.str();
+inline std::vector<std::string> listHistory() {
+    static std::vector<std::string> history;
+    if (history.empty()) {
+        for (const auto &entry : openHistory().load()) {
+            if (history.size() == 5) break;
+            history.push_back(entry.dir.string());
         }
-    } catch (...) {}
-    return "";
+    }
+    return history;
+}
+
+inline void deleteFilOrDir(const fs::path &p) {
+    if (fs::is_directory(p))
+        fs::remove_all(p);
+    else
+        fs::remove(p);
+}
+
+inline void deleteFilOrDir(const std::set<fs::path> &paths) {
+    for (const auto &p : paths) { deleteFilOrDir(p); }
 }
 
 #endif
@@ -0,0 +1,61 @@
+#ifndef WATCHER_HPP_
+#define WATCHER_HPP_
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct FsChange {
+    enum class Kind {
+        Created,
+        Removed,
+        Modified,
+        Overflow, // events were dropped; only a full rescan is reliable
+    };
+
+    Kind kind;
+    fs::path path;
+};
+
+// Watches a set of directories (non-recursively) and reports batched changes to their
+// direct children from a background thread. Built on inotify; a no-op elsewhere.
+class Watcher {
+  public:
+    using Callback = std::function<void(std::vector<FsChange>)>;
+
+    explicit Watcher(Callback callback);
+    ~Watcher();
+
+    Watcher(const Watcher &) = delete;
+    Watcher &operator=(const Watcher &) = delete;
+
+    // Watch exactly `dirs`, adding and removing watches as needed.
+    void setDirs(const std::set<fs::path> &dirs);
+    // Start or stop watching `dirs`, leaving the other watches alone.
+    void addDirs(const std::set<fs::path> &dirs);
+    void removeDirs(const std::set<fs::path> &dirs);
+    bool active() const;
+
+  private:
+    Callback _callback;
+    std::mutex _mutex;
+    std::map<fs::path, int> _watches;
+    std::unordered_map<int, fs::path> _paths;
+    int _fd = -1;
+    int _wakeFd = -1;
+    std::thread _thread;
+
+    // With _mutex held.
+    void add(const fs::path &dir);
+    void remove(std::map<fs::path, int>::iterator);
+    void loop();
+};
+
+#endif
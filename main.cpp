@@ -1,6 +1,43 @@
 #include "FileManager.hpp"
+#include "Listing.hpp"
+#include "Trace.hpp"
 
-int main() {
-    FileManager fm;
-    return fm.Run();
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+// Removes "<flag> VALUE" from the arguments and returns VALUE, or an empty path.
+fs::path takeOption(std::vector<std::string_view> &args, std::string_view flag) {
+    fs::path value;
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+        if (args[i] != flag) continue;
+        value = fs::path(args[i + 1]);
+        args.erase(args.begin() + i, args.begin() + i + 2);
+        break;
+    }
+    return value;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string_view> args(argv + 1, argv + argc);
+    fs::path statsFile = takeOption(args, "--stats");
+    fs::path traceFile = takeOption(args, "--trace");
+    if (const char *env = std::getenv("FILEMANAGER_TRACE"); traceFile.empty() && env && *env)
+        traceFile = env;
+    if (!traceFile.empty()) Trace::start(traceFile);
+
+    int rc;
+    if (!args.empty() && args[0] == "--list") {
+        // Headless listing for scripts: no terminal UI is created.
+        rc = listCommand({args.begin() + 1, args.end()});
+    } else {
+        FileManager fm;
+        fm.statsFile = statsFile;
+        rc = fm.Run();
+    }
+
+    if (!traceFile.empty() && !Trace::stop())
+        std::fprintf(stderr, "cannot write trace to %s\n", traceFile.string().c_str());
+    return rc;
 }
@@ -0,0 +1,273 @@
+#include "ContentSearch.hpp"
+#include "DirScanner.hpp"
+#include "FileReader.hpp"
+#include "Format.hpp"
+#include "PathIndex.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace {
+constexpr size_t kFileBatch = 32;      // files searched per pool task
+constexpr size_t kChunk = 4 << 20;     // bytes read and searched between cancellation checks
+constexpr size_t kMinChunk = 64 << 10; // window of files that were small when opened
+constexpr size_t kLookahead = 1024;    // read past a window to finish the line of a match
+constexpr size_t kContext = 40;        // bytes kept before a match deep into a long line
+constexpr size_t kColumns = ContentSearch::kMaxColumns;
+constexpr const char *kEllipsis = "…"; // marks a line shown from the middle
+
+// The line holding a match, starting late enough to keep the match in view.
+ContentSearch::Hit makeHit(const fs::path &file, uint32_t line, const char *lineStart,
+                           const char *match, size_t len, const char *lineEnd) {
+    const char *from = lineStart;
+    if (static_cast<size_t>(match - lineStart) > kContext) {
+        from = match - kContext;
+        while (from < match && (static_cast<unsigned char>(*from) & 0xC0) == 0x80) ++from;
+    }
+    if (lineEnd > from && lineEnd[-1] == '\r') --lineEnd;
+
+    ContentSearch::Hit hit;
+    hit.file = file;
+    hit.line = line;
+    hit.text = displayLine(std::string_view(from, lineEnd - from), kColumns);
+    size_t at = displayLine(std::string_view(from, match - from), kColumns).size();
+    size_t n = displayLine(std::string_view(match, len), kColumns).size();
+    at = std::min(at, hit.text.size());
+    n = std::min(n, hit.text.size() - at);
+    if (from != lineStart) {
+        hit.text = kEllipsis + hit.text;
+        at += std::strlen(kEllipsis);
+    }
+    hit.matchAt = static_cast<uint16_t>(at);
+    hit.matchLen = static_cast<uint16_t>(n);
+    return hit;
+}
+} // namespace
+
+// State shared by the coordinator and the pool tasks of one search.
+struct ContentSearch::Search {
+    Search(uint64_t gen, std::vector<fs::path> roots, std::string query)
+        : gen(gen), roots(std::move(roots)), query(std::move(query)),
+          searcher(this->query.data(), this->query.data() + this->query.size()) {}
+
+    const uint64_t gen;
+    const std::vector<fs::path> roots;
+    const std::string query;
+    const std::boyer_moore_horspool_searcher<const char *> searcher;
+    std::stop_token stop;
+    std::atomic<bool> full{false};
+    std::atomic<size_t> files{0};
+    std::atomic<size_t> hits{0};
+
+    std::mutex mutex; // guards the rest
+    std::vector<Hit> pending;
+    std::chrono::steady_clock::time_point lastReport;
+};
+
+ContentSearch::ContentSearch(Callback callback) : _callback(std::move(callback)) {
+    _thread = std::jthread([this](std::stop_token stop) { loop(stop); });
+}
+
+ContentSearch::~ContentSearch() { cancel(); }
+
+void ContentSearch::start(std::vector<fs::path> roots, std::string query) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // The search in progress sees the new generation and winds down on its own.
+        uint64_t gen = ++_gen;
+        _request.reset();
+        if (!query.empty())
+            _request = std::make_shared<Search>(gen, std::move(roots), std::move(query));
+    }
+    _cv.notify_one();
+}
+
+void ContentSearch::cancel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _request.reset();
+    ++_gen;
+}
+
+void ContentSearch::loop(std::stop_token stop) {
+    Trace::setThreadName("grep");
+    while (true) {
+        std::shared_ptr<Search> search;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_cv.wait(lock, stop, [&] { return _request != nullptr; })) return;
+            search = std::move(_request);
+        }
+        if (_gen.load() == search->gen) run(stop, *search);
+    }
+}
+
+bool ContentSearch::stopped(const Search &s) const {
+    return s.stop.stop_requested() || _gen.load() != s.gen || s.full.load();
+}
+
+// Walks the roots like the fuzzy finder (symlinked directories listed but not followed,
+// VCS/dependency directories skipped), handing files to the pool in batches.
+void ContentSearch::run(std::stop_token stop, Search &s) {
+    TraceSpan span("grep", s.query);
+    s.stop = stop;
+    s.lastReport = std::chrono::steady_clock::now();
+
+    TaskGroup group;
+    auto searchBatch = [this, &s, &group](std::vector<fs::path> batch) {
+        group.run([this, &s, batch = std::move(batch)] {
+            for (const auto &file : batch) {
+                if (stopped(s)) return;
+                searchFile(file, s);
+            }
+        });
+    };
+    std::function<void(const fs::path &)> visit = [&](const fs::path &dir) {
+        std::vector<fs::path> files;
+        std::error_code ec;
+        DirScanner scanner(dir, 0, ec);
+        for (DirScanner::Entry e; scanner.next(e);) {
+            if (stopped(s)) return;
+            const Tree::Meta &m = e.meta;
+            if (m.isDir) {
+                if (m.type != fs::file_type::symlink && !PathIndex::skipped(e.name))
+                    group.run([&visit, child = dir / e.name] { visit(child); });
+                continue;
+            }
+            if (m.brokenLink ||
+                (m.type != fs::file_type::regular && m.type != fs::file_type::symlink))
+                continue;
+            files.push_back(dir / e.name);
+            if (files.size() == kFileBatch) searchBatch(std::exchange(files, {}));
+        }
+        if (!files.empty()) searchBatch(std::move(files));
+    };
+
+    std::vector<fs::path> files;
+    for (const auto &root : s.roots) {
+        std::error_code ec;
+        if (fs::is_directory(root, ec))
+            group.run([&visit, &root] { visit(root); });
+        else
+            files.push_back(root);
+    }
+    if (!files.empty()) searchBatch(std::move(files));
+    try {
+        group.wait();
+    } catch (const std::exception &) {} // unreadable entries are skipped, not fatal
+    if (stop.stop_requested() || _gen.load() != s.gen) return;
+    report(s, true);
+}
+
+// Reports at most kMaxHitsPerFile hits of one file, one per line. The file is read in kChunk
+// windows rather than mapped, so one truncated while it is searched (a rotated log) only ends
+// the search early; fifos and devices are never opened. Each window keeps kContext bytes from
+// before its search start and reads kLookahead bytes past its end, so a match near either
+// edge still comes with its context, and one straddling two windows is found in the second.
+void ContentSearch::searchFile(const fs::path &path, Search &s) {
+    FileReader in(path, true);
+    s.files.fetch_add(1, std::memory_order_relaxed);
+    if (!in) {
+        report(s, false);
+        return;
+    }
+
+    const size_t len = s.query.size();
+    const size_t back = kContext + 1, ahead = kLookahead + len;
+    const size_t capacity =
+        static_cast<size_t>(std::clamp<std::uintmax_t>(in.size(), kMinChunk, kChunk)) + back +
+        ahead;
+    auto buffer = std::make_unique<char[]>(capacity);
+    char *const buf = buffer.get();
+    const char *const data = buf;
+    uint64_t offset = 0;   // of data[0] in the file
+    size_t have = 0;       // bytes in data
+    size_t from = 0;       // where this window's search starts
+    size_t counted = 0;    // newlines before data + counted are in `line`
+    uint32_t line = 1;
+    bool eof = false;
+    bool skipLine = false; // the previous window ended inside a line that already had a hit
+    std::vector<Hit> hits;
+    while (hits.size() < kMaxHitsPerFile) {
+        if (stopped(s)) return;
+        while (!eof && have < capacity) {
+            int64_t got = in.readAt(buf + have, capacity - have, offset + have);
+            if (got <= 0) // an error ends the file like a truncation would
+                eof = true;
+            else
+                have += static_cast<size_t>(got);
+        }
+        if (offset == 0 && looksBinary(data, have)) break;
+
+        const char *end = data + have;
+        const char *limit = eof ? end : end - ahead; // matches start before this
+        const char *searchEnd = eof ? end : limit + len - 1;
+        const char *pos = data + from;
+        if (skipLine) {
+            auto *nl = static_cast<const char *>(std::memchr(pos, '\n', limit - pos));
+            skipLine = !nl;
+            pos = nl ? nl : limit;
+        }
+        while (pos < limit && hits.size() < kMaxHitsPerFile) {
+            const char *match = std::search(pos, searchEnd, s.searcher);
+            if (match == searchEnd) break;
+            line += static_cast<uint32_t>(std::count(data + counted, match, '\n'));
+            counted = match - data;
+            // Past the first window, a line with no newline before the match in the window
+            // starts more than kContext back, which is all makeHit needs to know.
+            const char *lineStart = match;
+            while (lineStart > data && lineStart[-1] != '\n') --lineStart;
+            auto *lineEnd = static_cast<const char *>(std::memchr(match, '\n', end - match));
+            if (!lineEnd) {
+                lineEnd = end;
+                skipLine = !eof;
+            }
+            hits.push_back(makeHit(path, line, lineStart, match, len, lineEnd));
+            pos = lineEnd;
+        }
+        if (eof) break;
+
+        // Slide the window, keeping `back` bytes before where the next search starts.
+        size_t next = static_cast<size_t>(std::max(pos, limit) - data);
+        size_t drop = next - std::min(next, back);
+        line += static_cast<uint32_t>(std::count(data + counted, data + next, '\n'));
+        std::memmove(buf, buf + drop, have - drop);
+        offset += drop;
+        have -= drop;
+        from = counted = next - drop;
+    }
+
+    if (!hits.empty()) {
+        size_t before = s.hits.fetch_add(hits.size());
+        if (before + hits.size() >= kMaxHits) {
+            hits.resize(before < kMaxHits ? kMaxHits - before : 0);
+            s.full = true;
+        }
+        std::lock_guard<std::mutex> lock(s.mutex);
+        std::move(hits.begin(), hits.end(), std::back_inserter(s.pending));
+    }
+    report(s, false);
+}
+
+// Hands the pending hits to the callback, at most every kReportInterval unless `done`.
+void ContentSearch::report(Search &s, bool done) {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (!done && now - s.lastReport < kReportInterval) return;
+    s.lastReport = now;
+
+    Results results;
+    results.gen = s.gen;
+    results.hits = std::move(s.pending);
+    s.pending.clear();
+    results.filesSearched = s.files.load();
+    results.done = done;
+    results.capped = s.full.load();
+    if (_gen.load() == s.gen) _callback(std::move(results));
+}
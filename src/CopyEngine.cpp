@@ -0,0 +1,297 @@
+#include "CopyEngine.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <memory>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+#endif
+
+namespace {
+constexpr size_t kChunk = 8 << 20;    // bytes per kernel call, bounds cancellation latency
+constexpr size_t kBufferSize = 1 << 20; // read/write fallback
+constexpr unsigned kMaxParallel = 8;
+
+[[noreturn]] void fail(const char *what, const fs::path &from, const fs::path &to, int err) {
+    throw fs::filesystem_error(what, from, to, std::error_code(err, std::system_category()));
+}
+
+#ifdef _WIN32
+struct ChunkContext {
+    std::stop_token stop;
+    LONGLONG last = 0;
+    std::function<void(std::uintmax_t)> add;
+};
+
+DWORD CALLBACK onChunk(LARGE_INTEGER, LARGE_INTEGER transferred, LARGE_INTEGER, LARGE_INTEGER,
+                       DWORD, DWORD, HANDLE, HANDLE, LPVOID data) {
+    auto *ctx = static_cast<ChunkContext *>(data);
+    ctx->add(static_cast<std::uintmax_t>(transferred.QuadPart - ctx->last));
+    ctx->last = transferred.QuadPart;
+    return ctx->stop.stop_requested() ? PROGRESS_CANCEL : PROGRESS_CONTINUE;
+}
+#endif
+} // namespace
+
+CopyEngine::CopyEngine(ProgressFn onProgress, unsigned maxParallel)
+    : _onProgress(std::move(onProgress)),
+      _maxParallel(maxParallel ? maxParallel
+                               : std::min(kMaxParallel, ThreadPool::shared().size())) {}
+
+bool CopyEngine::run(const std::vector<std::pair<fs::path, fs::path>> &items,
+                     std::stop_token stop) {
+    for (const auto &[from, to] : items)
+        if (fs::exists(fs::symlink_status(to)))
+            throw fs::filesystem_error("destination exists", from, to,
+                                       std::make_error_code(std::errc::file_exists));
+
+    _bytesDone = 0;
+    _filesDone = 0;
+    _progress = {};
+    _lastReport = std::chrono::steady_clock::now();
+    _lastBytes = 0;
+
+    // No destination existed before, so stopping or failing can remove all of them.
+    auto rollback = [&] {
+        std::error_code ec;
+        for (const auto &item : items) fs::remove_all(item.second, ec);
+    };
+
+    try {
+        std::vector<File> dirs, files, links;
+        {
+            TraceSpan span("copy plan");
+            for (const auto &[from, to] : items) plan(from, to, dirs, files, links, stop);
+        }
+        if (stop.stop_requested()) return false;
+        {
+            std::lock_guard<std::mutex> lock(_reportMutex);
+            _progress.planning = false;
+        }
+        report(true);
+
+        for (const auto &d : dirs) fs::create_directory(d.to, d.from);
+
+        // Largest first, so one big file does not trail behind at the end.
+        std::sort(files.begin(), files.end(),
+                  [](const File &a, const File &b) { return a.size > b.size; });
+
+        std::stop_source abort;
+        std::stop_callback forward(stop, [&] { abort.request_stop(); });
+        std::atomic<size_t> next{0};
+        TaskGroup group;
+        unsigned workers = static_cast<unsigned>(std::min<size_t>(_maxParallel, files.size()));
+        for (unsigned w = 0; w < workers; ++w)
+            group.run([&] {
+                try {
+                    for (size_t i; (i = next++) < files.size();) {
+                        TraceSpan span("copyFile", files[i].from);
+                        if (!copyFile(files[i], abort.get_token())) return;
+                        ++_filesDone;
+                        report();
+                    }
+                } catch (...) {
+                    abort.request_stop(); // the first failure ends the whole copy
+                    throw;
+                }
+            });
+        group.wait();
+
+        for (const auto &l : links) {
+            if (stop.stop_requested()) break;
+            fs::copy_symlink(l.from, l.to);
+            ++_filesDone;
+        }
+        report(true);
+    } catch (...) {
+        rollback();
+        throw;
+    }
+
+    if (stop.stop_requested()) {
+        rollback();
+        return false;
+    }
+    return true;
+}
+
+void CopyEngine::plan(const fs::path &from, const fs::path &to, std::vector<File> &dirs,
+                      std::vector<File> &files, std::vector<File> &links,
+                      std::stop_token stop) {
+    auto add = [&](const fs::path &src, const fs::path &dest, fs::file_status st) {
+        if (fs::is_symlink(st)) {
+            links.push_back({src, dest, 0});
+            ++_progress.filesTotal;
+        } else if (fs::is_directory(st)) {
+            dirs.push_back({src, dest, 0});
+        } else if (fs::is_regular_file(st)) {
+            std::uintmax_t size = fs::file_size(src);
+            files.push_back({src, dest, size});
+            ++_progress.filesTotal;
+            _progress.bytesTotal += size;
+        } // sockets, fifos and devices are skipped, as fs::copy does
+        report();
+    };
+
+    fs::file_status st = fs::symlink_status(from);
+    add(from, to, st);
+    if (!fs::is_directory(st)) return;
+
+    // Pre-order, so every directory is created before anything inside it.
+    for (auto it = fs::recursive_directory_iterator(from); it != fs::recursive_directory_iterator();
+         ++it) {
+        if (stop.stop_requested()) return;
+        add(it->path(), to / it->path().lexically_relative(from), it->symlink_status());
+    }
+}
+
+void CopyEngine::report(bool force) {
+    std::unique_lock<std::mutex> lock(_reportMutex, std::defer_lock);
+    if (force) {
+        lock.lock();
+    } else if (!lock.try_lock()) {
+        return; // someone else is reporting right now
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - _lastReport < kReportInterval) return;
+
+    std::uintmax_t bytes = _bytesDone.load();
+    double dt = std::chrono::duration<double>(now - _lastReport).count();
+    if (!_progress.planning && dt > 0) {
+        double rate = (bytes - _lastBytes) / dt;
+        _progress.bytesPerSec =
+            _progress.bytesPerSec == 0 ? rate : 0.7 * _progress.bytesPerSec + 0.3 * rate;
+    }
+    _progress.bytesDone = bytes;
+    _progress.filesDone = _filesDone.load();
+    std::uintmax_t left = _progress.bytesTotal > bytes ? _progress.bytesTotal - bytes : 0;
+    _progress.etaSec = _progress.bytesPerSec > 0 ? left / _progress.bytesPerSec : -1;
+    _lastReport = now;
+    _lastBytes = bytes;
+    _onProgress(_progress);
+}
+
+#ifdef _WIN32
+
+bool CopyEngine::copyFile(const File &file, std::stop_token stop) {
+    ChunkContext ctx{stop, 0, [this](std::uintmax_t n) {
+                         _bytesDone += n;
+                         report();
+                     }};
+    if (CopyFileExW(file.from.c_str(), file.to.c_str(), onChunk, &ctx, nullptr,
+                    COPY_FILE_FAIL_IF_EXISTS))
+        return true;
+    DWORD err = GetLastError();
+    if (err == ERROR_REQUEST_ABORTED) return false; // CopyFileExW removes the partial file
+    fail("copy", file.from, file.to, static_cast<int>(err));
+}
+
+#else
+
+bool CopyEngine::copyFile(const File &file, std::stop_token stop) {
+    int in = ::open(file.from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) fail("open", file.from, file.to, errno);
+    struct stat st;
+    if (::fstat(in, &st) != 0) {
+        int err = errno;
+        ::close(in);
+        fail("stat", file.from, file.to, err);
+    }
+    int out = ::open(file.to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+    if (out < 0) {
+        int err = errno;
+        ::close(in);
+        fail("create", file.from, file.to, err);
+    }
+
+    auto abandon = [&] {
+        ::close(in);
+        ::close(out);
+        ::unlink(file.to.c_str());
+    };
+    auto add = [&](std::uintmax_t n) {
+        _bytesDone += n;
+        report();
+    };
+
+    enum class Method { CopyRange, SendFile, ReadWrite };
+#ifdef __linux__
+    // A reflink shares the extents and finishes in constant time on btrfs, XFS and friends.
+    Method method = Method::CopyRange;
+    bool cloned = ::ioctl(out, FICLONE, in) == 0;
+    if (cloned) add(static_cast<std::uintmax_t>(st.st_size));
+#else
+    Method method = Method::ReadWrite;
+    bool cloned = false;
+#endif
+    std::unique_ptr<char[]> buffer;
+
+    while (!cloned) {
+        if (stop.stop_requested()) {
+            abandon();
+            return false;
+        }
+        ssize_t n = 0;
+#ifdef __linux__
+        if (method == Method::CopyRange) {
+            n = ::copy_file_range(in, nullptr, out, nullptr, kChunk, 0);
+            if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP ||
+                          errno == EINVAL)) {
+                method = Method::SendFile;
+                continue;
+            }
+        } else if (method == Method::SendFile) {
+            n = ::sendfile(out, in, nullptr, kChunk);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                method = Method::ReadWrite;
+                continue;
+            }
+        }
+#endif
+        if (method == Method::ReadWrite) {
+            if (!buffer) buffer = std::make_unique<char[]>(kBufferSize);
+            n = ::read(in, buffer.get(), kBufferSize);
+            for (ssize_t written = 0; n > 0 && written < n;) {
+                ssize_t w = ::write(out, buffer.get() + written, n - written);
+                if (w < 0 && errno != EINTR) {
+                    n = -1;
+                    break;
+                }
+                if (w > 0) written += w;
+            }
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            int err = errno;
+            abandon();
+            fail("copy", file.from, file.to, err);
+        }
+        if (n == 0) break;
+        add(static_cast<std::uintmax_t>(n));
+    }
+
+    // The umask applied at creation; copy the permissions exactly, as fs::copy_file does.
+    int err = ::fchmod(out, st.st_mode & 07777) != 0 ? errno : 0;
+    if (::close(out) != 0 && !err) err = errno;
+    ::close(in);
+    if (err) {
+        ::unlink(file.to.c_str());
+        fail("copy", file.from, file.to, err);
+    }
+    return true;
+}
+
+#endif
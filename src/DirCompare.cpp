@@ -0,0 +1,229 @@
+#include "DirCompare.hpp"
+#include "DirScanner.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+
+namespace {
+struct Listed {
+    std::string name;
+    Tree::Meta meta;
+};
+
+constexpr size_t kCancelCheck = 256; // entries listed between cancellation checks
+
+// Entries of `dir` sorted by name; none if it cannot be read, and only some once cancelled.
+template <class Cancelled> std::vector<Listed> list(const fs::path &dir, Cancelled cancelled) {
+    std::vector<Listed> out;
+    std::error_code ec;
+    DirScanner scanner(dir, DirScanner::Size | DirScanner::Mtime, ec);
+    for (DirScanner::Entry e; scanner.next(e);) {
+        if (out.size() % kCancelCheck == kCancelCheck - 1 && cancelled()) break;
+        out.push_back({std::string(e.name), e.meta});
+    }
+    std::sort(out.begin(), out.end(),
+              [](const Listed &a, const Listed &b) { return a.name < b.name; });
+    return out;
+}
+
+bool isRealDir(const Tree::Meta &m) { return m.isDir && m.type != fs::file_type::symlink; }
+
+// True if `inner` is `outer` or below it.
+bool contains(const fs::path &outer, const fs::path &inner) {
+    auto [o, i] = std::mismatch(outer.begin(), outer.end(), inner.begin(), inner.end());
+    return o == outer.end() || (std::next(o) == outer.end() && o->empty());
+}
+} // namespace
+
+struct DirCompare::Search {
+    Search(uint64_t gen, const std::atomic<uint64_t> &current, fs::path left, fs::path right,
+           std::stop_token stop)
+        : gen(gen), current(current), left(std::move(left)), right(std::move(right)),
+          stop(std::move(stop)) {}
+
+    const uint64_t gen;
+    const std::atomic<uint64_t> &current;
+    const fs::path left;
+    const fs::path right;
+    const std::stop_token stop;
+    TaskGroup group;
+    std::atomic<size_t> compared{0};
+    std::atomic<size_t> same{0};
+    std::atomic<std::uintmax_t> bytesRead{0};
+
+    std::mutex mutex; // guards the rest
+    std::vector<Diff> diffs;
+    std::chrono::steady_clock::time_point lastReport;
+
+    bool cancelled() const { return stop.stop_requested() || current.load() != gen; }
+    void add(Diff diff) {
+        std::lock_guard<std::mutex> lock(mutex);
+        diffs.push_back(std::move(diff));
+    }
+};
+
+DirCompare::DirCompare(Callback callback) : _callback(std::move(callback)) {
+    _thread = std::jthread([this](std::stop_token stop) { loop(stop); });
+}
+
+DirCompare::~DirCompare() { cancel(); }
+
+void DirCompare::start(fs::path left, fs::path right) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // The comparison in progress sees the new generation and winds down on its own.
+        _request = Request{++_gen, std::move(left), std::move(right)};
+    }
+    _cv.notify_one();
+}
+
+void DirCompare::cancel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _request.reset();
+    ++_gen;
+}
+
+void DirCompare::loop(std::stop_token stop) {
+    Trace::setThreadName("compare");
+    while (true) {
+        Request req;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_cv.wait(lock, stop, [&] { return _request.has_value(); })) return;
+            req = std::move(*_request);
+            _request.reset();
+        }
+        Search search(req.gen, _gen, req.left, req.right, stop);
+        if (!search.cancelled()) run(search);
+    }
+}
+
+void DirCompare::run(Search &s) {
+    TraceSpan span("compare", s.left);
+    Status status;
+    status.gen = s.gen;
+    status.done = true;
+
+    std::error_code ec;
+    fs::path left = fs::weakly_canonical(s.left, ec), right = fs::weakly_canonical(s.right, ec);
+    if (!fs::is_directory(s.left, ec) || !fs::is_directory(s.right, ec))
+        status.error = (fs::is_directory(s.left, ec) ? s.right : s.left).string() +
+                       ": not a directory";
+    else if (contains(left, right) || contains(right, left))
+        status.error = "one directory contains the other";
+    if (!status.error.empty()) {
+        if (!s.cancelled()) _callback(std::move(status));
+        return;
+    }
+
+    s.group.run([this, &s] { compareDir(s, {}); });
+    try {
+        s.group.wait();
+    } catch (const std::exception &) {} // unreadable entries are skipped, not fatal
+    if (s.cancelled()) return;
+
+    status.compared = s.compared;
+    status.same = s.same;
+    status.bytesRead = s.bytesRead;
+    status.diffs = std::move(s.diffs);
+    std::sort(status.diffs.begin(), status.diffs.end(),
+              [](const Diff &a, const Diff &b) { return a.rel < b.rel; });
+    _callback(std::move(status));
+}
+
+// Merges the sorted listings of one directory pair. Directories on both sides are queued as
+// their own tasks, and so are content checks, so a big file never holds up the walk.
+void DirCompare::compareDir(Search &s, const fs::path &rel) {
+    fs::path leftDir = s.left / rel, rightDir = s.right / rel;
+    auto cancelled = [&s] { return s.cancelled(); };
+    std::vector<Listed> a = list(leftDir, cancelled), b = list(rightDir, cancelled);
+    size_t same = 0, compared = 0;
+    for (size_t i = 0, j = 0; i < a.size() || j < b.size(); ++compared) {
+        if (s.cancelled()) return;
+        int order = i == a.size() ? 1 : j == b.size() ? -1 : a[i].name.compare(b[j].name);
+        if (order < 0) {
+            const Tree::Meta &m = a[i].meta;
+            std::uintmax_t size = m.type == fs::file_type::regular ? m.size : 0;
+            s.add({rel / a[i++].name, Kind::OnlyLeft, isRealDir(m), size});
+            continue;
+        }
+        if (order > 0) {
+            s.add({rel / b[j].name, Kind::OnlyRight, isRealDir(b[j].meta), 0});
+            ++j;
+            continue;
+        }
+
+        const Tree::Meta &x = a[i].meta, &y = b[j].meta;
+        const std::string &name = a[i].name;
+        fs::path child = rel / name;
+        ++i, ++j;
+        bool changed = false;
+        if (x.type != y.type) {
+            changed = true;
+        } else if (x.type == fs::file_type::directory) {
+            s.group.run([this, &s, child] { compareDir(s, child); });
+            continue;
+        } else if (x.type == fs::file_type::symlink) {
+            std::error_code ec1, ec2;
+            fs::path target = fs::read_symlink(leftDir / name, ec1);
+            changed = target != fs::read_symlink(rightDir / name, ec2) || ec1 || ec2;
+        } else if (x.type == fs::file_type::regular) {
+            changed = x.size != y.size;
+            if (!changed && x.mtime != y.mtime) {
+                s.group.run([this, &s, child, size = x.size] { compareContents(s, child, size); });
+                continue;
+            }
+        }
+        if (changed)
+            s.add({child, Kind::Changed, isRealDir(x),
+                   x.type == fs::file_type::regular ? x.size : 0});
+        else
+            ++same;
+    }
+    s.compared += compared;
+    s.same += same;
+    report(s);
+}
+
+// Files of equal size whose mtimes differ: compared block by block, stopping at the first
+// difference. A file that cannot be read counts as changed.
+void DirCompare::compareContents(Search &s, const fs::path &rel, std::uintmax_t size) {
+    TraceSpan span("compare file", rel);
+    bool same = size == 0;
+    if (!same) {
+        MappedFile a(s.left / rel), b(s.right / rel);
+        same = a && b && a.size() == b.size();
+        for (size_t off = 0; same && off < a.size(); off += kBlock) {
+            if (s.cancelled()) return;
+            size_t n = std::min(kBlock, a.size() - off);
+            same = std::memcmp(a.data() + off, b.data() + off, n) == 0;
+            s.bytesRead += 2 * n;
+        }
+    }
+    if (same)
+        ++s.same;
+    else
+        s.add({rel, Kind::Changed, false, size});
+    report(s);
+}
+
+// Progress, at most every kReportInterval.
+void DirCompare::report(Search &s) {
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (now - s.lastReport < kReportInterval) return;
+        s.lastReport = now;
+    }
+    Status status;
+    status.gen = s.gen;
+    status.compared = s.compared;
+    status.same = s.same;
+    status.bytesRead = s.bytesRead;
+    if (!s.cancelled()) _callback(std::move(status));
+}
@@ -0,0 +1,236 @@
+#include "DirScanner.hpp"
+#include "Stats.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+namespace {
+constexpr size_t kBufferSize = 256 * 1024; // a few thousand entries per getdents64 call
+
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1]; // NUL-terminated, running on to d_reclen; read it through nameOf()
+};
+
+const char *nameOf(const LinuxDirent64 *d) {
+    return reinterpret_cast<const char *>(d) + offsetof(LinuxDirent64, d_name);
+}
+
+fs::file_type typeOf(unsigned mode) {
+    switch (mode & S_IFMT) {
+    case S_IFREG:
+        return fs::file_type::regular;
+    case S_IFDIR:
+        return fs::file_type::directory;
+    case S_IFLNK:
+        return fs::file_type::symlink;
+    case S_IFBLK:
+        return fs::file_type::block;
+    case S_IFCHR:
+        return fs::file_type::character;
+    case S_IFIFO:
+        return fs::file_type::fifo;
+    case S_IFSOCK:
+        return fs::file_type::socket;
+    default:
+        return fs::file_type::unknown;
+    }
+}
+
+fs::file_type typeOfDirent(unsigned char type) {
+    switch (type) {
+    case DT_REG:
+        return fs::file_type::regular;
+    case DT_DIR:
+        return fs::file_type::directory;
+    case DT_LNK:
+        return fs::file_type::symlink;
+    case DT_BLK:
+        return fs::file_type::block;
+    case DT_CHR:
+        return fs::file_type::character;
+    case DT_FIFO:
+        return fs::file_type::fifo;
+    case DT_SOCK:
+        return fs::file_type::socket;
+    default:
+        return fs::file_type::none; // DT_UNKNOWN: ask statx
+    }
+}
+
+// Same clock conversion as fs::last_write_time.
+fs::file_time_type fileTime(const struct statx_timestamp &ts) {
+    auto sys = std::chrono::sys_time<std::chrono::nanoseconds>(
+        std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec));
+    return std::chrono::time_point_cast<fs::file_time_type::duration>(
+        fs::file_time_type::clock::from_sys(sys));
+}
+} // namespace
+
+struct DirScanner::Impl {
+    int fd = -1;
+    unsigned fields = 0;
+    std::unique_ptr<char[]> buffer{new char[kBufferSize]};
+    size_t pos = 0, end = 0;
+    mutable uint64_t entries = 0, stats = 0; // published to Stats once, on destruction
+
+    ~Impl() {
+        if (fd >= 0) ::close(fd);
+        Stats::add(Stats::EntriesScanned, entries);
+        Stats::add(Stats::StatCalls, stats);
+    }
+
+    // Fills in what d_type could not tell: symlink targets, and size/mtime when asked for.
+    void describe(const char *name, Tree::Meta &m) const {
+        unsigned want = (fields & Mtime ? STATX_MTIME : 0);
+        struct statx st;
+        if (m.type == fs::file_type::none) {
+            unsigned mask = STATX_TYPE | want | (fields & Size ? STATX_SIZE : 0);
+            ++stats;
+            if (statx(fd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, mask, &st) != 0) {
+                m.type = fs::file_type::unknown;
+                return;
+            }
+            m.type = typeOf(st.stx_mode);
+            if (m.type != fs::file_type::symlink) {
+                m.isDir = m.type == fs::file_type::directory;
+                if (m.type == fs::file_type::regular && (fields & Size) &&
+                    (st.stx_mask & STATX_SIZE))
+                    m.size = st.stx_size;
+                if (want && (st.stx_mask & STATX_MTIME)) m.mtime = fileTime(st.stx_mtime);
+                return;
+            }
+        }
+
+        if (m.type == fs::file_type::symlink) {
+            unsigned mask = STATX_TYPE | want | (fields & Size ? STATX_SIZE : 0);
+            ++stats;
+            if (statx(fd, name, AT_STATX_DONT_SYNC, mask, &st) != 0) {
+                m.brokenLink = errno == ENOENT || errno == ELOOP || errno == ENOTDIR;
+                return;
+            }
+            fs::file_type target = typeOf(st.stx_mode);
+            m.isDir = target == fs::file_type::directory;
+            if (target == fs::file_type::regular && (fields & Size) && (st.stx_mask & STATX_SIZE))
+                m.size = st.stx_size;
+            if (want && (st.stx_mask & STATX_MTIME)) m.mtime = fileTime(st.stx_mtime);
+            return;
+        }
+
+        m.isDir = m.type == fs::file_type::directory;
+        bool size = (fields & Size) && m.type == fs::file_type::regular;
+        unsigned mask = want | (size ? STATX_SIZE : 0);
+        if (!mask) return;
+        ++stats;
+        if (statx(fd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, mask, &st) != 0) return;
+        if (size && (st.stx_mask & STATX_SIZE)) m.size = st.stx_size;
+        if (want && (st.stx_mask & STATX_MTIME)) m.mtime = fileTime(st.stx_mtime);
+    }
+};
+
+DirScanner::DirScanner(const fs::path &dir, unsigned fields) {
+    _impl = std::make_unique<Impl>();
+    _impl->fields = fields;
+    _impl->fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (_impl->fd < 0)
+        throw fs::filesystem_error("cannot open directory", dir,
+                                   std::error_code(errno, std::generic_category()));
+}
+
+DirScanner::DirScanner(const fs::path &dir, unsigned fields, std::error_code &ec) : _ec(&ec) {
+    ec.clear();
+    _impl = std::make_unique<Impl>();
+    _impl->fields = fields;
+    _impl->fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (_impl->fd < 0) ec = std::error_code(errno, std::generic_category());
+}
+
+DirScanner::~DirScanner() = default;
+
+bool DirScanner::next(Entry &entry) {
+    Impl &s = *_impl;
+    if (s.fd < 0) return false;
+    while (true) {
+        if (s.pos >= s.end) {
+            long n = syscall(SYS_getdents64, s.fd, s.buffer.get(), kBufferSize);
+            if (n <= 0) {
+                int err = errno;
+                ::close(s.fd);
+                s.fd = -1;
+                if (n == 0) return false;
+                std::error_code ec(err, std::generic_category());
+                if (!_ec) throw fs::filesystem_error("cannot read directory", ec);
+                *_ec = ec;
+                return false;
+            }
+            s.pos = 0;
+            s.end = static_cast<size_t>(n);
+        }
+
+        auto *d = reinterpret_cast<const LinuxDirent64 *>(s.buffer.get() + s.pos);
+        s.pos += d->d_reclen;
+        const char *name = nameOf(d);
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+        ++s.entries;
+        entry.name = std::string_view(name, std::strlen(name));
+        entry.meta = Tree::Meta{};
+        entry.meta.type = typeOfDirent(d->d_type);
+        s.describe(name, entry.meta);
+        return true;
+    }
+}
+
+#else
+
+struct DirScanner::Impl {
+    fs::directory_iterator it;
+    std::string name;
+    uint64_t entries = 0;
+
+    ~Impl() { Stats::add(Stats::EntriesScanned, entries); }
+};
+
+DirScanner::DirScanner(const fs::path &dir, unsigned) : _impl(std::make_unique<Impl>()) {
+    _impl->it = fs::directory_iterator(dir);
+}
+
+DirScanner::DirScanner(const fs::path &dir, unsigned, std::error_code &ec)
+    : _impl(std::make_unique<Impl>()), _ec(&ec) {
+    _impl->it = fs::directory_iterator(dir, ec);
+}
+
+DirScanner::~DirScanner() = default;
+
+// Directory listings on Windows already carry sizes and times, so `fields` changes nothing.
+bool DirScanner::next(Entry &entry) {
+    Impl &s = *_impl;
+    if (s.it == fs::directory_iterator()) return false;
+    ++s.entries;
+    s.name = s.it->path().filename().string();
+    entry.name = s.name;
+    entry.meta = Tree::Meta::read(*s.it);
+    if (_ec) {
+        s.it.increment(*_ec);
+        if (*_ec) s.it = fs::directory_iterator();
+    } else {
+        ++s.it;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "DirSizer.hpp"
+#include "ThreadPool.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+constexpr size_t kMaxCached = 1 << 20; // directories
+constexpr size_t kCancelCheck = 256;   // entries between cancellation checks
+} // namespace
+
+DirSizer::DirSizer(Callback callback) : _callback(std::move(callback)) {
+    _thread = std::jthread([this](std::stop_token stop) { loop(stop); });
+}
+
+DirSizer::~DirSizer() { cancel(); }
+
+void DirSizer::request(const std::vector<fs::path> &dirs) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &d : dirs)
+            if (_queued.insert(d.string()).second) _queue.push_back(d);
+    }
+    _cv.notify_one();
+}
+
+void DirSizer::cancel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.clear();
+    _queued.clear();
+    ++_gen;
+}
+
+void DirSizer::invalidate(const fs::path &path) {
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    ++_epoch;
+    for (fs::path p = path;; p = p.parent_path()) {
+        _cache.erase(p.string());
+        if (!p.has_relative_path()) break;
+    }
+}
+
+void DirSizer::invalidateAll() {
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    ++_epoch;
+    _cache.clear();
+}
+
+bool DirSizer::Walk::firstSighting(uint64_t dev, uint64_t ino) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return seen.insert({dev, ino, 0}).second;
+}
+
+void DirSizer::loop(std::stop_token stop) {
+    while (true) {
+        fs::path dir;
+        uint64_t gen;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_cv.wait(lock, stop, [&] { return !_queue.empty(); })) return;
+            dir = std::move(_queue.front());
+            _queue.pop_front();
+            _queued.erase(dir.string());
+            gen = _gen.load();
+        }
+
+        std::optional<Key> key = keyOf(dir);
+        if (!key) continue;
+        Walk walk;
+        {
+            std::lock_guard<std::mutex> lock(_cacheMutex);
+            walk.epoch = _epoch;
+        }
+        std::optional<Measured> measured;
+        try {
+            measured = sizeOf(dir, *key, gen, stop, walk);
+        } catch (const std::exception &) {}
+        if (measured && _gen.load() == gen) _callback(dir, measured->size);
+    }
+}
+
+// Total apparent size below `dir`, or nullopt if cancelled. Subdirectories are measured
+// concurrently and cached individually; other file systems are not entered.
+std::optional<DirSizer::Measured> DirSizer::sizeOf(const fs::path &dir, const Key &key,
+                                                   uint64_t gen, std::stop_token stop,
+                                                   Walk &walk) {
+    {
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        if (auto it = _cache.find(dir.string()); it != _cache.end() && it->second.key == key)
+            return Measured{it->second.size, {}};
+    }
+    auto cancelled = [&] { return stop.stop_requested() || _gen.load() != gen; };
+
+    Measured m;
+    std::uintmax_t &total = m.size;
+    std::vector<std::pair<fs::path, Key>> subdirs;
+    std::error_code ec;
+    size_t seen = 0;
+    fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (++seen % kCancelCheck == 0 && cancelled()) return std::nullopt;
+#ifdef _WIN32
+        // Sizes come with the directory listing; hard links are not detected here, as that
+        // would mean opening every file.
+        std::error_code tec;
+        fs::file_type type = it->symlink_status(tec).type();
+        if (type == fs::file_type::directory) {
+            if (auto sub = keyOf(it->path()); sub && sub->dev == key.dev)
+                subdirs.emplace_back(it->path(), *sub);
+        } else if (type == fs::file_type::regular) {
+            std::uintmax_t size = it->file_size(tec);
+            if (!tec) total += size;
+        }
+#else
+        struct stat st;
+        if (::lstat(it->path().c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (static_cast<uint64_t>(st.st_dev) != key.dev) continue;
+            int64_t mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            subdirs.emplace_back(it->path(), Key{static_cast<uint64_t>(st.st_dev),
+                                                 static_cast<uint64_t>(st.st_ino), mtime});
+            continue;
+        }
+        if (st.st_nlink > 1) {
+            Links &links = m.open[{static_cast<uint64_t>(st.st_dev),
+                                   static_cast<uint64_t>(st.st_ino), 0}];
+            ++links.seen;
+            links.total = st.st_nlink;
+            if (!walk.firstSighting(st.st_dev, st.st_ino)) continue;
+        }
+        total += static_cast<std::uintmax_t>(st.st_size);
+#endif
+    }
+
+    std::vector<std::optional<Measured>> sizes(subdirs.size());
+    TaskGroup group;
+    for (size_t i = 0; i < subdirs.size(); ++i)
+        group.run([&, i] {
+            sizes[i] = sizeOf(subdirs[i].first, subdirs[i].second, gen, stop, walk);
+        });
+    group.wait();
+    for (const auto &s : sizes) {
+        if (!s) return std::nullopt;
+        total += s->size;
+        for (const auto &[inode, links] : s->open) {
+            Links &l = m.open[inode];
+            l.seen += links.seen;
+            l.total = links.total;
+        }
+    }
+    std::erase_if(m.open, [](const auto &e) { return e.second.seen >= e.second.total; });
+    if (!m.open.empty()) return m; // counted or not depending on the rest of the walk
+
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    if (_epoch != walk.epoch) return m; // something below may have changed meanwhile
+    if (_cache.size() >= kMaxCached) _cache.clear();
+    _cache[dir.string()] = {key, total};
+    return m;
+}
+
+#ifdef _WIN32
+
+std::optional<DirSizer::Key> DirSizer::keyOf(const fs::path &path) {
+    HANDLE h = CreateFileW(path.c_str(), 0,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return std::nullopt;
+    BY_HANDLE_FILE_INFORMATION info;
+    bool ok = GetFileInformationByHandle(h, &info);
+    CloseHandle(h);
+    if (!ok) return std::nullopt;
+    Key k;
+    k.dev = info.dwVolumeSerialNumber;
+    k.ino = uint64_t(info.nFileIndexHigh) << 32 | info.nFileIndexLow;
+    k.mtime = int64_t(uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32 |
+                      info.ftLastWriteTime.dwLowDateTime);
+    return k;
+}
+
+#else
+
+std::optional<DirSizer::Key> DirSizer::keyOf(const fs::path &path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return std::nullopt;
+    int64_t mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return Key{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino), mtime};
+}
+
+#endif
@@ -0,0 +1,361 @@
+#include "Duplicates.hpp"
+#include "DirScanner.hpp"
+#include "FileReader.hpp"
+#include "Hash.hpp"
+#include "PathIndex.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+constexpr size_t kStatBatch = 256; // files identified per pool task
+
+// One inode: what the hashing stages read, once however many links it has.
+struct Unit {
+    std::uintmax_t size = 0;
+    std::vector<fs::path> paths; // hard links; the first is read
+    uint64_t edges = 0;
+    uint64_t contents = 0;
+    bool complete = false; // the edges covered the whole file, so contents == edges
+    bool failed = false;   // unreadable, or changed size while being read
+};
+
+struct Identity {
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    auto operator<=>(const Identity &) const = default;
+};
+
+// Runs fn(i) for every i in [0, n) on the shared pool, each worker taking the next index.
+template <class Fn> void forEach(size_t n, const Fn &fn) {
+    std::atomic<size_t> next{0};
+    TaskGroup group;
+    size_t workers = std::min<size_t>(ThreadPool::shared().size(), n);
+    for (size_t w = 0; w < workers; ++w)
+        group.run([&] {
+            for (size_t i; (i = next++) < n;) fn(i);
+        });
+    group.wait();
+}
+
+// Calls fn(begin, end) for every run of at least two indices with the same key, after sorting
+// `idx` by key.
+template <class Key, class Fn> void forEachShared(std::vector<size_t> &idx, Key key, Fn fn) {
+    std::sort(idx.begin(), idx.end(), [&](size_t a, size_t b) { return key(a) < key(b); });
+    for (size_t begin = 0, end; begin < idx.size(); begin = end) {
+        for (end = begin + 1; end < idx.size() && key(idx[end]) == key(idx[begin]);) ++end;
+        if (end - begin > 1) fn(begin, end);
+    }
+}
+
+#ifdef _WIN32
+
+std::optional<Identity> identityOf(const fs::path &path) {
+    HANDLE h = CreateFileW(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return std::nullopt;
+    BY_HANDLE_FILE_INFORMATION info;
+    bool ok = GetFileInformationByHandle(h, &info);
+    CloseHandle(h);
+    if (!ok) return std::nullopt;
+    return Identity{info.dwVolumeSerialNumber,
+                    uint64_t(info.nFileIndexHigh) << 32 | info.nFileIndexLow};
+}
+
+#else
+
+std::optional<Identity> identityOf(const fs::path &path) {
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return std::nullopt;
+    return Identity{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino)};
+}
+
+#endif
+
+// Hashes the first and last kEdgeBytes, or the whole file if that is all there is.
+void hashEdges(Unit &unit) {
+    constexpr size_t kEdge = DuplicateFinder::kEdgeBytes;
+    char buf[2 * kEdge];
+    FileReader in(unit.paths.front());
+    bool whole = unit.size <= 2 * kEdge;
+    size_t n = whole ? static_cast<size_t>(unit.size) : 2 * kEdge;
+    bool ok = in && (whole ? in.readFully(buf, n, 0)
+                           : in.readFully(buf, kEdge, 0) &&
+                                 in.readFully(buf + kEdge, kEdge, unit.size - kEdge));
+    if (!ok) {
+        unit.failed = true;
+        return;
+    }
+    unit.edges = Hash64::of(buf, n);
+    if (whole) {
+        unit.complete = true;
+        unit.contents = unit.edges;
+    }
+}
+
+// Hashes the whole file front to back; `progress` gets the bytes as they are read.
+void hashContents(Unit &unit, std::atomic<std::uintmax_t> &progress,
+                  const std::function<bool()> &cancelled) {
+    TraceSpan span("hash", unit.paths.front());
+    FileReader in(unit.paths.front(), true);
+    if (!in) {
+        unit.failed = true;
+        return;
+    }
+    size_t bufSize = static_cast<size_t>(
+        std::min<std::uintmax_t>(unit.size, DuplicateFinder::kReadSize));
+    auto buf = std::make_unique<char[]>(bufSize);
+    Hash64 hash;
+    std::uintmax_t offset = 0;
+    while (true) {
+        if (cancelled()) return;
+        int64_t got = in.readAt(buf.get(), bufSize, offset);
+        if (got < 0) {
+            unit.failed = true;
+            return;
+        }
+        if (got == 0) break;
+        hash.update(buf.get(), static_cast<size_t>(got));
+        offset += static_cast<std::uintmax_t>(got);
+        progress += static_cast<std::uintmax_t>(got);
+    }
+    unit.failed = offset != unit.size;
+    unit.contents = hash.digest();
+}
+} // namespace
+
+struct DuplicateFinder::Search {
+    Search(uint64_t gen, const std::atomic<uint64_t> &current, fs::path root, std::stop_token stop)
+        : gen(gen), current(current), root(std::move(root)), stop(std::move(stop)) {}
+
+    const uint64_t gen;
+    const std::atomic<uint64_t> &current;
+    const fs::path root;
+    const std::stop_token stop;
+    std::atomic<Stage> stage{Stage::Scanning};
+    std::atomic<size_t> files{0};
+    std::atomic<std::uintmax_t> hashed{0};
+    std::atomic<std::uintmax_t> toHash{0};
+
+    std::mutex mutex; // guards the rest
+    std::vector<std::pair<fs::path, std::uintmax_t>> found; // regular files and their sizes
+    std::chrono::steady_clock::time_point lastReport;
+
+    bool cancelled() const { return stop.stop_requested() || current.load() != gen; }
+};
+
+DuplicateFinder::DuplicateFinder(Callback callback) : _callback(std::move(callback)) {
+    _thread = std::jthread([this](std::stop_token stop) { loop(stop); });
+}
+
+DuplicateFinder::~DuplicateFinder() { cancel(); }
+
+void DuplicateFinder::start(fs::path root) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // The search in progress sees the new generation and winds down on its own.
+        _request = Request{++_gen, std::move(root)};
+    }
+    _cv.notify_one();
+}
+
+void DuplicateFinder::cancel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _request.reset();
+    ++_gen;
+}
+
+void DuplicateFinder::loop(std::stop_token stop) {
+    Trace::setThreadName("duplicates");
+    while (true) {
+        Request req;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_cv.wait(lock, stop, [&] { return _request.has_value(); })) return;
+            req = std::move(*_request);
+            _request.reset();
+        }
+        Search search(req.gen, _gen, req.root, stop);
+        if (!search.cancelled()) run(search);
+    }
+}
+
+void DuplicateFinder::run(Search &s) {
+    TraceSpan span("duplicates", s.root);
+    std::error_code ec;
+    if (!fs::is_directory(s.root, ec)) {
+        Status status;
+        status.gen = s.gen;
+        status.stage = Stage::Done;
+        status.error = ec ? ec.message() : "not a directory";
+        if (!s.cancelled()) _callback(std::move(status));
+        return;
+    }
+    scan(s);
+    if (s.cancelled()) return;
+
+    // Only files sharing their size with another can be duplicates. Those are identified,
+    // so that hard links collapse into one unit and are never read twice.
+    std::vector<std::pair<fs::path, std::uintmax_t>> &found = s.found;
+    std::vector<size_t> idx(found.size());
+    for (size_t i = 0; i < idx.size(); ++i) idx[i] = i;
+    std::vector<size_t> sameSize;
+    forEachShared(idx, [&](size_t i) { return found[i].second; }, [&](size_t b, size_t e) {
+        sameSize.insert(sameSize.end(), idx.begin() + b, idx.begin() + e);
+    });
+    std::vector<std::optional<Identity>> ids(found.size());
+    forEach((sameSize.size() + kStatBatch - 1) / kStatBatch, [&](size_t batch) {
+        if (s.cancelled()) return;
+        size_t end = std::min(sameSize.size(), (batch + 1) * kStatBatch);
+        for (size_t i = batch * kStatBatch; i < end; ++i)
+            ids[sameSize[i]] = identityOf(found[sameSize[i]].first);
+    });
+    if (s.cancelled()) return;
+
+    std::vector<Unit> units;
+    std::erase_if(sameSize, [&](size_t i) { return !ids[i]; });
+    std::sort(sameSize.begin(), sameSize.end(), [&](size_t a, size_t b) {
+        return std::tie(found[a].second, *ids[a], found[a].first) <
+               std::tie(found[b].second, *ids[b], found[b].first);
+    });
+    for (size_t i = 0; i < sameSize.size(); ++i) {
+        const auto &[path, size] = found[sameSize[i]];
+        if (i == 0 || *ids[sameSize[i]] != *ids[sameSize[i - 1]]) units.push_back({size, {}});
+        units.back().paths.push_back(path);
+    }
+
+    std::vector<size_t> live(units.size());
+    for (size_t i = 0; i < live.size(); ++i) live[i] = i;
+    auto keepShared = [&](auto key) {
+        std::erase_if(live, [&](size_t i) { return units[i].failed; });
+        std::vector<size_t> kept;
+        forEachShared(live, key, [&](size_t b, size_t e) {
+            kept.insert(kept.end(), live.begin() + b, live.begin() + e);
+        });
+        live = std::move(kept);
+    };
+    keepShared([&](size_t i) { return units[i].size; });
+
+    // First and last few KB, which tell apart most files of equal size.
+    std::uintmax_t edgeBytes = 0;
+    for (size_t i : live) edgeBytes += std::min<std::uintmax_t>(units[i].size, 2 * kEdgeBytes);
+    s.toHash = edgeBytes;
+    s.hashed = 0;
+    s.stage = Stage::Edges;
+    report(s, true);
+    forEach(live.size(), [&](size_t k) {
+        if (s.cancelled()) return;
+        Unit &unit = units[live[k]];
+        hashEdges(unit);
+        s.hashed += std::min<std::uintmax_t>(unit.size, 2 * kEdgeBytes);
+        report(s, false);
+    });
+    if (s.cancelled()) return;
+    keepShared([&](size_t i) { return std::pair(units[i].size, units[i].edges); });
+
+    // Whole contents of what is left, biggest first so the pool stays busy to the end.
+    std::vector<size_t> pending;
+    std::uintmax_t contentBytes = 0;
+    for (size_t i : live)
+        if (!units[i].complete) {
+            pending.push_back(i);
+            contentBytes += units[i].size;
+        }
+    std::sort(pending.begin(), pending.end(),
+              [&](size_t a, size_t b) { return units[a].size > units[b].size; });
+    s.toHash = contentBytes;
+    s.hashed = 0;
+    s.stage = Stage::Contents;
+    report(s, true);
+    std::function<bool()> cancelled = [&] { return s.cancelled(); };
+    forEach(pending.size(), [&](size_t k) {
+        if (s.cancelled()) return;
+        hashContents(units[pending[k]], s.hashed, cancelled);
+        report(s, false);
+    });
+    if (s.cancelled()) return;
+
+    Status status;
+    status.gen = s.gen;
+    status.stage = Stage::Done;
+    status.files = s.files;
+    status.hashed = status.toHash = contentBytes;
+    std::erase_if(live, [&](size_t i) { return units[i].failed; });
+    forEachShared(live, [&](size_t i) { return std::pair(units[i].size, units[i].contents); },
+                  [&](size_t b, size_t e) {
+                      Group group;
+                      group.size = units[live[b]].size;
+                      group.copies = static_cast<uint32_t>(e - b);
+                      for (size_t k = b; k < e; ++k)
+                          for (const auto &path : units[live[k]].paths)
+                              group.files.push_back({path, static_cast<uint32_t>(k - b)});
+                      std::sort(group.files.begin(), group.files.end(),
+                                [](const File &x, const File &y) { return x.path < y.path; });
+                      status.groups.push_back(std::move(group));
+                  });
+    std::sort(status.groups.begin(), status.groups.end(), [](const Group &a, const Group &b) {
+        return a.size * (a.copies - 1) > b.size * (b.copies - 1);
+    });
+    if (!s.cancelled()) _callback(std::move(status));
+}
+
+// Collects every non-empty regular file below the root, walking directories in parallel.
+// Symlinked directories are not followed.
+void DuplicateFinder::scan(Search &s) {
+    TaskGroup group;
+    std::function<void(const fs::path &)> visit = [&](const fs::path &dir) {
+        std::vector<std::pair<fs::path, std::uintmax_t>> files;
+        std::error_code ec;
+        DirScanner scanner(dir, DirScanner::Size, ec);
+        for (DirScanner::Entry e; scanner.next(e);) {
+            if (s.cancelled()) return;
+            const Tree::Meta &m = e.meta;
+            if (m.isDir) {
+                if (m.type != fs::file_type::symlink && !PathIndex::skipped(e.name))
+                    group.run([&visit, child = dir / e.name] { visit(child); });
+            } else if (m.type == fs::file_type::regular && m.size > 0) {
+                files.emplace_back(dir / e.name, m.size);
+            }
+        }
+        s.files += files.size();
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            std::move(files.begin(), files.end(), std::back_inserter(s.found));
+        }
+        report(s, false);
+    };
+    group.run([&] { visit(s.root); });
+    try {
+        group.wait();
+    } catch (const std::exception &) {} // unreadable directories are skipped, not fatal
+}
+
+// Progress, at most every kReportInterval unless `force`.
+void DuplicateFinder::report(Search &s, bool force) {
+    Status status;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (!force && now - s.lastReport < kReportInterval) return;
+        s.lastReport = now;
+    }
+    status.gen = s.gen;
+    status.stage = s.stage;
+    status.files = s.files;
+    status.hashed = s.hashed;
+    status.toHash = s.toHash;
+    if (!s.cancelled()) _callback(std::move(status));
+}
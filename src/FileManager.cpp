@@ -1,11 +1,176 @@
 #include "FileManager.hpp"
+#include "CopyEngine.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include "Trash.hpp"
 #include "Ui.hpp"
 #include "Utils.hpp"
 
 using namespace ftxui;
 
+namespace {
+JobQueue::Progress copyProgress(const CopyEngine::Progress &p) {
+    JobQueue::Progress out{p.bytesDone, p.bytesTotal, {}};
+    if (p.planning) {
+        out.detail = "scanning: " + std::to_string(p.filesTotal) + " files";
+    } else {
+        out.detail = std::to_string(p.filesDone) + "/" + std::to_string(p.filesTotal) +
+                     " files  " + formatSize(static_cast<std::uintmax_t>(p.bytesPerSec)) +
+                     "/s  ETA " + formatDuration(p.etaSec);
+    }
+    return out;
+}
+
+// Renames, or copies and deletes when `to` is on another file system. False if stopped.
+bool movePath(const fs::path &from, const fs::path &to, std::stop_token stop,
+              const JobQueue::Report &report) {
+    std::error_code ec;
+    fs::rename(from, to, ec);
+    if (!ec) return true;
+    if (ec != std::errc::cross_device_link) throw fs::filesystem_error("rename", from, to, ec);
+    CopyEngine engine([&](const CopyEngine::Progress &p) { report(copyProgress(p)); });
+    if (!engine.run(from, to, stop)) return false;
+    fs::remove_all(from);
+    return true;
+}
+
+// Throws unless `copy` still has the same contents as `original`, byte for byte: a hash
+// match found by a search is no proof, and either file may have changed since.
+void requireSameContents(const fs::path &original, const fs::path &copy) {
+    constexpr size_t kBlock = 1 << 20;
+    bool same = fs::file_size(original) == fs::file_size(copy);
+    if (same && fs::file_size(original) > 0) {
+        MappedFile a(original), b(copy);
+        same = a && b && a.size() == b.size();
+        for (size_t off = 0; same && off < a.size(); off += kBlock)
+            same = std::memcmp(a.data() + off, b.data() + off,
+                               std::min(kBlock, a.size() - off)) == 0;
+    }
+    if (!same) throw std::runtime_error(copy.filename().string() + " differs from its original");
+}
+
+// Replaces `to` with a hard link to `from`, made under a temporary name and renamed over `to`
+// so the swap is atomic. Refuses unless both still have the same contents.
+void linkOver(const fs::path &from, const fs::path &to) {
+    requireSameContents(from, to);
+    fs::path tmp = to.parent_path() / ("." + to.filename().string() + ".fmlink");
+    fs::create_hard_link(from, tmp);
+    std::error_code ec;
+    fs::rename(tmp, to, ec);
+    if (ec) {
+        fs::remove(tmp);
+        throw fs::filesystem_error("link", to, ec);
+    }
+}
+
+// Where a copy that replaces `to` is made, so `to` stays intact until the copy is complete.
+fs::path stagingPath(const fs::path &to) {
+    return to.parent_path() / ("." + to.filename().string() + ".fmcopy");
+}
+
+// Puts the finished copy `staged` in place of `to`. A file is renamed over it atomically;
+// anything else is first renamed aside, and put back if the swap fails.
+void replaceWith(const fs::path &staged, const fs::path &to) {
+    std::error_code ec;
+    bool dirs = fs::is_directory(fs::symlink_status(to)) ||
+                fs::is_directory(fs::symlink_status(staged));
+    if (!dirs) {
+        fs::rename(staged, to, ec);
+    } else {
+        fs::path old = to.parent_path() / ("." + to.filename().string() + ".fmold");
+        fs::rename(to, old, ec);
+        if (!ec) {
+            fs::rename(staged, to, ec);
+            std::error_code ignored;
+            if (ec) fs::rename(old, to, ignored);
+            else fs::remove_all(old, ignored);
+        }
+    }
+    if (ec) {
+        std::error_code ignored;
+        fs::remove_all(staged, ignored);
+        throw fs::filesystem_error("replace", to, ec);
+    }
+}
+
+// Runs fn(i) for every i in [0, n) on the shared pool and reports progress by item count.
+// fn gets a reporter for its own progress, live only when n == 1. Failures are collected,
+// not thrown, so what did succeed can still be applied: one message per item, empty if ok.
+std::vector<std::string>
+runBatch(size_t n, std::stop_token stop, const JobQueue::Report &report,
+         const std::function<void(size_t, const JobQueue::Report &)> &fn) {
+    std::vector<std::string> errors(n);
+    std::mutex reportMutex;
+    JobQueue::Report itemReport = [&](JobQueue::Progress p) {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        if (n == 1) report(std::move(p));
+    };
+    std::atomic<size_t> next{0}, done{0};
+    TaskGroup group;
+    size_t workers = std::min<size_t>(ThreadPool::shared().size(), n);
+    for (size_t w = 0; w < workers; ++w)
+        group.run([&] {
+            for (size_t i; (i = next++) < n;) {
+                if (stop.stop_requested()) return;
+                try {
+                    fn(i, itemReport);
+                } catch (const std::exception &ex) {
+                    errors[i] = ex.what();
+                }
+                std::lock_guard<std::mutex> lock(reportMutex);
+                if (n > 1) report({++done, n, {}});
+            }
+        });
+    group.wait();
+    return errors;
+}
+
+// `done` as is, or thrown inside a PartialFailure describing `errors`.
+JobQueue::Completion batchDone(const std::vector<std::string> &errors, JobQueue::Completion done) {
+    auto isError = [](const std::string &e) { return !e.empty(); };
+    auto first = std::find_if(errors.begin(), errors.end(), isError);
+    if (first == errors.end()) return done;
+    if (errors.size() == 1) throw JobQueue::PartialFailure(*first, std::move(done));
+    size_t failed = std::count_if(first, errors.end(), isError);
+    throw JobQueue::PartialFailure(std::to_string(failed) + " of " + std::to_string(errors.size()) +
+                                       " failed, first: " + *first,
+                                   std::move(done));
+}
+
+std::string batchTitle(const std::string &verb, const std::vector<fs::path> &paths) {
+    if (paths.size() == 1) return verb + " " + paths.front().filename().string();
+    return verb + " " + std::to_string(paths.size()) + " items";
+}
+
+std::string batchTitle(const std::string &verb, const FileManager::Transfers &items) {
+    if (items.size() == 1) return verb + " " + items.front().first.filename().string();
+    return verb + " " + std::to_string(items.size()) + " items";
+}
+
+// Paths a job declares to the queue. Big batches declare their parent directories instead,
+// which orders them a little more conservatively but keeps conflict checks cheap.
+std::vector<fs::path> lockPaths(std::vector<fs::path> paths) {
+    constexpr size_t kMaxLockPaths = 64;
+    if (paths.size() > kMaxLockPaths) {
+        for (auto &p : paths) p = p.parent_path();
+        std::sort(paths.begin(), paths.end());
+        paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+    }
+    return paths;
+}
+
+std::vector<fs::path> lockPaths(const FileManager::Transfers &items) {
+    std::vector<fs::path> paths;
+    for (const auto &[from, to] : items) paths.insert(paths.end(), {from, to});
+    return lockPaths(std::move(paths));
+}
+} // namespace
+
 int FileManager::Run() {
+    Trace::setThreadName("ui");
     UI ui(*this);
+    startIndexing();
+    loadUndo();
     while (true) {
         ScreenInteractive screen = ScreenInteractive::Fullscreen();
         auto renderer = Renderer([&ui, &screen] { return ui.render(screen); });
@@ -13,52 +178,476 @@ int FileManager::Run() {
             handleEvent(e, screen);
             return true;
         });
+        {
+            std::lock_guard<std::mutex> lock(inboxMutex);
+            activeScreen = &screen;
+            if (!inbox.empty()) screen.PostEvent(Event::Custom);
+        }
         screen.Loop(interactive);
+        {
+            std::lock_guard<std::mutex> lock(inboxMutex);
+            activeScreen = nullptr;
+        }
         if (handleTermCmd(termCmd)) {
+            if (!statsFile.empty()) {
+                std::ofstream out(statsFile);
+                Stats::write(out);
+            }
             break;
         } else {
             termCmd = FileManager::TermCmds::None;
-            refresh();
+            termTarget.reset();
+            termLine.reset();
+            pendingSelect = selEntryPath;
+            loadDir();
         }
     }
     return 0;
 }
 
 void FileManager::refresh() {
+    ScopedTimer timer(Stats::Refresh);
+    cancelLoad();
+    dirSizer.cancel();
+    dirSizer.invalidateAll(); // a rescan is how changes the watcher cannot see get picked up
+    cwdNode = tree.intern(cwd);
     entries.clear();
     buildTree(cwd, 0);
     if (!entries.empty()) {
         selIdx = std::min(selIdx, entries.size() - 1);
         updateSelEntryPath();
     }
+    requestDirSizes(0, entries.size());
+    syncWatches();
 }
 
 void FileManager::buildTree(const fs::path &path, int depth) {
-    if (!fs::exists(path) || !fs::is_directory(path)) return;
+    TraceSpan span("buildTree", path);
+    std::vector<Entry> rows = scanTree(path, depth);
+    entries.insert(entries.end(), rows.begin(), rows.end());
+}
 
-    std::vector<fs::directory_entry> children;
-    for (auto &e : fs::directory_iterator(path)) children.push_back(e);
+void FileManager::setSortMode(SortMode m, bool reversed) {
+    sortMode = m;
+    sortReversed = reversed;
+    if (loading) { // batches in flight were sorted with the old order
+        pendingSelect = selEntryPath;
+        loadDir();
+        return;
+    }
+    fs::path prevSel = selEntryPath;
+    {
+        ScopedTimer timer(Stats::Sort);
+        sortRange(0, entries.size(), 0, order());
+    }
+    restoreSelection(prevSel);
+}
 
-    std::sort(children.begin(), children.end(), [](auto &a, auto &b) {
-        bool da = fs::is_directory(a), db = fs::is_directory(b);
-        if (da != db) return da > db;
-        auto an = a.path().filename().string();
-        auto bn = b.path().filename().string();
-        std::transform(an.begin(), an.end(), an.begin(), ::tolower);
-        std::transform(bn.begin(), bn.end(), bn.begin(), ::tolower);
-        return an < bn;
-    });
+// Re-sorts the rows in [begin, end), all at `depth` or deeper, from the cached keys. Each
+// row moves together with its expanded subtree, which is sorted recursively.
+void FileManager::sortRange(size_t begin, size_t end, int depth, const EntryOrder &order) {
+    auto first = entries.begin() + begin, last = entries.begin() + end;
+    if (std::all_of(first, last, [&](const Entry &e) { return e.depth == depth; })) {
+        parallelSort(first, last, order);
+        return;
+    }
 
-    for (auto &e : children) {
-        entries.push_back({e.path(), depth});
-        if (fs::is_directory(e.path()) && expandedDirs.count(e.path()))
-            buildTree(e.path(), depth + 1);
+    std::vector<std::pair<size_t, size_t>> blocks;
+    for (size_t i = begin; i < end;) {
+        size_t j = i + 1;
+        while (j < end && entries[j].depth > depth) ++j;
+        if (j - i > 1) sortRange(i + 1, j, depth + 1, order);
+        blocks.emplace_back(i, j);
+        i = j;
     }
+    parallelSort(blocks.begin(), blocks.end(),
+                 [&](const auto &x, const auto &y) {
+                     return order(entries[x.first], entries[y.first]);
+                 });
+
+    std::vector<Entry> sorted;
+    sorted.reserve(end - begin);
+    for (auto [b, e] : blocks) sorted.insert(sorted.end(), first - begin + b, first - begin + e);
+    std::copy(sorted.begin(), sorted.end(), first);
+}
+
+// Scans `path` and every expanded directory below it concurrently on the shared pool.
+// Touches no shared state, so it can run on any thread.
+std::unique_ptr<FileManager::ScanNode> FileManager::scanTree(const fs::path &path,
+                                                             const std::set<fs::path> &expanded,
+                                                             const EntryOrder &order) {
+    auto root = std::make_unique<ScanNode>();
+    if (!fs::is_directory(path)) return root;
+
+    TaskGroup group;
+    std::function<void(ScanNode &, const fs::path &)> scan = [&](ScanNode &node,
+                                                                const fs::path &dir) {
+        node.items = scanDir(dir, order);
+        for (size_t i = 0; i < node.items.size(); ++i) {
+            const Tree::Item &item = node.items[i];
+            if (!item.meta.isDir) continue;
+            fs::path child = dir / item.name;
+            if (!expanded.count(child)) continue;
+            node.subs.emplace_back(i, std::make_unique<ScanNode>());
+            ScanNode *sub = node.subs.back().second.get();
+            group.run([&scan, sub, child = std::move(child)] { scan(*sub, child); });
+        }
+    };
+
+    group.run([&] { scan(*root, path); });
+    group.wait();
+    return root;
+}
+
+// Scans and interns the visible subtree of `path`, in display order.
+std::vector<FileManager::Entry> FileManager::scanTree(const fs::path &path, int depth) {
+    Tree::NodeId node = tree.intern(path);
+    std::unique_ptr<ScanNode> scan = scanTree(path, expandedPaths(node), order());
+    std::vector<Entry> rows;
+    internTree(node, depth, *scan, rows);
+    return rows;
+}
+
+// Interns a scan result below `parent`, appending the rows in display order (each expanded
+// directory followed by its children).
+void FileManager::internTree(Tree::NodeId parent, int depth, ScanNode &scan,
+                             std::vector<Entry> &out) {
+    size_t next = 0;
+    for (size_t i = 0; i < scan.items.size(); ++i) {
+        Tree::NodeId node = tree.add(parent, scan.items[i]);
+        out.push_back({node, depth});
+        if (next < scan.subs.size() && scan.subs[next].first == i)
+            internTree(node, depth + 1, *scan.subs[next++].second, out);
+    }
+}
+
+// Paths of the expanded directories listed when `under` is.
+std::set<fs::path> FileManager::expandedPaths(Tree::NodeId under) const {
+    std::set<fs::path> paths;
+    for (Tree::NodeId id : tree.expandedBelow(under)) paths.insert(tree.path(id));
+    return paths;
+}
+
+// --- Background loading ---
+namespace {
+constexpr size_t kFirstBatch = 256; // roughly a screenful, so the first frame comes quickly
+constexpr auto kFlushInterval = std::chrono::milliseconds(50);
+constexpr size_t kCompactThreshold = 1 << 20; // tree nodes
+} // namespace
+
+// Starts streaming cwd in the background; rows arrive through mergeBatch().
+void FileManager::loadDir() {
+    LoadRequest req{++loadGen, cwd, expandedPaths(cwdNode), {sortMode, sortReversed}};
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        loadRequest = std::move(req);
+    }
+    loadCv.notify_one();
+    dirSizer.cancel();
+
+    entries.clear();
+    insertedWhileLoading.clear();
+    selIdx = scrollOffset = 0;
+    selEntryPath.clear();
+    loading = true;
+    loadStart = std::chrono::steady_clock::now();
+
+    // Nothing refers to rows right now, so this is the cheap moment to drop stale nodes.
+    if (tree.size() > kCompactThreshold) tree.compact({});
+    cwdNode = tree.intern(cwd);
+}
+
+// Refreshes the path indexes of the most visited directories in the background.
+void FileManager::startIndexing() {
+    std::string appData = getAppDataDir();
+    if (appData.empty()) return;
+    std::vector<fs::path> roots;
+    for (const auto &dir : listHistory()) roots.emplace_back(dir);
+    indexer.start(fs::path(appData) / "index", std::move(roots));
+}
+
+void FileManager::cancelLoad() {
+    ++loadGen;
+    loading = false;
+    pendingSelect.reset();
+}
+
+void FileManager::loaderLoop(std::stop_token stop) {
+    Trace::setThreadName("loader");
+    uint64_t handled = 0;
+    while (true) {
+        LoadRequest req;
+        {
+            std::unique_lock<std::mutex> lock(loadMutex);
+            if (!loadCv.wait(lock, stop, [&] { return loadRequest.gen != handled; })) return;
+            req = loadRequest;
+            handled = req.gen;
+        }
+        uint64_t gen = req.gen;
+        auto cancelled = [&] { return stop.stop_requested() || loadGen.load() != gen; };
+        TraceSpan span("loadDir", req.dir);
+
+        try {
+            std::vector<Tree::Item> batch;
+            std::vector<std::string> expandedNames;
+            size_t loaded = 0;
+            auto lastFlush = std::chrono::steady_clock::now();
+            auto flush = [&] {
+                {
+                    ScopedTimer timer(Stats::Sort);
+                    parallelSort(batch.begin(), batch.end(), req.order);
+                }
+                loaded += batch.size();
+                post([this, gen, b = std::move(batch)]() mutable {
+                    mergeBatch(gen, std::move(b));
+                });
+                batch.clear();
+                lastFlush = std::chrono::steady_clock::now();
+            };
+
+            DirScanner scanner(req.dir, DirScanner::Size | DirScanner::Mtime);
+            for (DirScanner::Entry e; scanner.next(e);) {
+                if (cancelled()) break;
+                batch.push_back(Tree::Item::make(std::string(e.name), e.meta));
+                if (batch.back().meta.isDir && req.expanded.count(req.dir / e.name))
+                    expandedNames.push_back(batch.back().name);
+
+                // Batches grow with the listing so merging stays O(n log n) overall.
+                bool full = batch.size() >= std::max(kFirstBatch, loaded / 2);
+                if (full || std::chrono::steady_clock::now() - lastFlush >= kFlushInterval) flush();
+            }
+            if (cancelled()) continue;
+            if (!batch.empty()) flush();
+
+            std::vector<std::pair<std::string, std::unique_ptr<ScanNode>>> subtrees;
+            for (auto &name : expandedNames) {
+                if (cancelled()) break;
+                subtrees.emplace_back(name, scanTree(req.dir / name, req.expanded, req.order));
+            }
+            if (cancelled()) continue;
+            post([this, gen, s = std::make_shared<decltype(subtrees)>(std::move(subtrees))] {
+                finishLoad(gen, std::move(*s));
+            });
+        } catch (const std::exception &ex) {
+            std::string msg = ex.what();
+            post([this, gen, msg] {
+                if (gen != loadGen) return;
+                loading = false;
+                error = "Error: " + msg;
+                prompt = Prompt::Error;
+            });
+        }
+    }
+}
+
+void FileManager::mergeBatch(uint64_t gen, std::vector<Tree::Item> batch) {
+    if (gen != loadGen) return;
+
+    fs::path prevSel = selEntryPath;
+    size_t mid = entries.size();
+    for (const auto &item : batch) {
+        Tree::NodeId node = tree.add(cwdNode, item);
+        if (!insertedWhileLoading.count(node)) entries.push_back({node, 0});
+    }
+    std::inplace_merge(entries.begin(), entries.begin() + mid, entries.end(), order());
+
+    if (pendingSelect) {
+        if (auto idx = findEntry(*pendingSelect)) {
+            selIdx = *idx;
+            prevSel = *pendingSelect;
+            pendingSelect.reset();
+        }
+    }
+    restoreSelection(prevSel);
+}
+
+void FileManager::finishLoad(
+    uint64_t gen, std::vector<std::pair<std::string, std::unique_ptr<ScanNode>>> subtrees) {
+    if (gen != loadGen) return;
+    loading = false;
+    insertedWhileLoading.clear();
+    Stats::record(Stats::Load, std::chrono::steady_clock::now() - loadStart);
+
+    fs::path prevSel = pendingSelect.value_or(selEntryPath);
+    pendingSelect.reset();
+    for (auto &[name, scan] : subtrees) {
+        Tree::NodeId node = tree.findChild(cwdNode, name);
+        auto idx = node == Tree::npos ? std::nullopt : findEntry(node);
+        if (!idx) continue;
+        std::vector<Entry> rows;
+        internTree(node, 1, *scan, rows);
+        spliceChildren(*idx, std::move(rows));
+    }
+    restoreSelection(prevSel);
+    requestDirSizes(0, entries.size());
+    syncWatches();
+}
+
+// Asks for the recursive size of every directory row in [begin, end).
+void FileManager::requestDirSizes(size_t begin, size_t end) {
+    std::vector<fs::path> dirs;
+    for (size_t i = begin; i < end && i < entries.size(); ++i)
+        if (tree.isDir(entries[i].node)) dirs.push_back(entryPath(i));
+    if (!dirs.empty()) dirSizer.request(dirs);
+}
+
+// Inserts the (already flattened) subtree of the row at `parentIdx` right below it.
+void FileManager::spliceChildren(size_t parentIdx, std::vector<Entry> rows) {
+    entries.insert(entries.begin() + parentIdx + 1, rows.begin(), rows.end());
+}
+
+// --- Incremental updates ---
+void FileManager::post(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(inboxMutex);
+    inbox.push_back(std::move(fn));
+    if (activeScreen) activeScreen->PostEvent(Event::Custom);
+}
+
+void FileManager::drainInbox() {
+    std::vector<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        pending.swap(inbox);
+    }
+    for (auto &fn : pending) fn();
+}
+
+// Patches the rows affected by `changes` in place; a full rescan only happens when the
+// watcher lost events.
+void FileManager::applyChanges(const std::vector<FsChange> &changes) {
+    // Past this many rows one rescan is cheaper than patching them one by one.
+    constexpr size_t kMaxPatches = 256;
+    fs::path prevSel = selEntryPath;
+    if (changes.size() > kMaxPatches) {
+        refresh();
+        restoreSelection(prevSel);
+        return;
+    }
+    std::set<fs::path> resize; // visible directories whose totals changed
+    for (const auto &c : changes) {
+        if (c.kind != FsChange::Kind::Overflow) {
+            dirSizer.invalidate(c.path);
+            for (fs::path p = c.path.parent_path(); p != cwd && p.has_relative_path();
+                 p = p.parent_path())
+                resize.insert(p);
+        }
+        switch (c.kind) {
+        case FsChange::Kind::Overflow:
+            refresh();
+            restoreSelection(prevSel);
+            return;
+        case FsChange::Kind::Created:
+            insertEntry(c.path);
+            break;
+        case FsChange::Kind::Removed:
+            removeEntry(c.path);
+            break;
+        case FsChange::Kind::Modified:
+            if (auto node = tree.find(c.path); node && findEntry(*node))
+                tree.setMeta(*node, Meta::read(c.path));
+            break;
+        }
+    }
+    std::vector<fs::path> dirs;
+    for (const auto &p : resize)
+        if (findEntry(p)) dirs.push_back(p);
+    if (!dirs.empty()) dirSizer.request(dirs);
+    restoreSelection(prevSel);
+    syncWatches();
+}
+
+void FileManager::insertEntry(const fs::path &path) {
+    auto parent = tree.find(path.parent_path());
+    if (!parent) return;
+    size_t begin = 0, end = entries.size();
+    int depth = 0;
+
+    if (*parent != cwdNode) {
+        auto pidx = findEntry(*parent);
+        if (!pidx || !tree.expanded(*parent)) return; // not visible
+        depth = entries[*pidx].depth + 1;
+        begin = end = *pidx + 1;
+        while (end < entries.size() && entries[end].depth >= depth) ++end;
+    }
+
+    Meta meta = Meta::read(path);
+    if (meta.type == fs::file_type::not_found || meta.type == fs::file_type::none) return;
+    Tree::NodeId node = tree.add(*parent, Tree::Item::make(path.filename().string(), meta));
+    if (loading && depth == 0) insertedWhileLoading.insert(node);
+
+    Entry e{node, depth};
+    size_t pos = end;
+    for (size_t i = begin; i < end; ++i) {
+        if (entries[i].depth != depth) continue;
+        if (entries[i].node == node) return; // already listed; metadata refreshed above
+        if (pos == end && order()(e, entries[i])) pos = i;
+    }
+
+    std::vector<Entry> rows{e};
+    if (meta.isDir && tree.expanded(node)) {
+        std::vector<Entry> sub = scanTree(path, depth + 1);
+        rows.insert(rows.end(), sub.begin(), sub.end());
+    }
+    entries.insert(entries.begin() + pos, rows.begin(), rows.end());
+    if (meta.isDir) requestDirSizes(pos, pos + rows.size());
+}
+
+void FileManager::removeEntry(const fs::path &path) {
+    if (path == cwd) {
+        while (cwd.has_parent_path() && !fs::is_directory(cwd)) cwd = cwd.parent_path();
+        loadDir();
+        return;
+    }
+    auto idx = findEntry(path);
+    if (!idx) return;
+    size_t end = *idx + 1;
+    while (end < entries.size() && entries[end].depth > entries[*idx].depth) ++end;
+    for (size_t i = *idx; i < end; ++i) tree.setSelected(entries[i].node, false);
+    entries.erase(entries.begin() + *idx, entries.begin() + end);
+}
+
+std::optional<size_t> FileManager::findEntry(const fs::path &path) const {
+    auto node = tree.find(path);
+    if (!node) return std::nullopt;
+    return findEntry(*node);
+}
+
+std::optional<size_t> FileManager::findEntry(Tree::NodeId node) const {
+    for (size_t i = 0; i < entries.size(); ++i)
+        if (entries[i].node == node) return i;
+    return std::nullopt;
+}
+
+// Keeps the cursor on the same path after rows moved around it.
+void FileManager::restoreSelection(const fs::path &path) {
+    if (entries.empty()) {
+        selIdx = scrollOffset = 0;
+        return;
+    }
+    if (auto idx = path.empty() ? std::nullopt : findEntry(path))
+        selIdx = *idx;
+    else
+        selIdx = std::min(selIdx, entries.size() - 1);
+    scrollOffset = std::min(scrollOffset, selIdx);
+    updateSelEntryPath();
+}
+
+// Watches cwd and every expanded directory listed below it.
+void FileManager::syncWatches() {
+    std::set<fs::path> dirs = expandedPaths(cwdNode);
+    dirs.insert(cwd);
+    watcher.setDirs(dirs);
 }
 
 // --- Input handling ---
 void FileManager::handleEvent(Event event, ScreenInteractive &screen) {
+    Stats::beginFrame();
+    ScopedTimer timer(Stats::Event);
     try {
+        if (event == Event::Custom) {
+            drainInbox();
+            return;
+        }
         if (prompt != Prompt::None) {
             handlePromptEvent(event, screen);
             return;
@@ -152,23 +741,54 @@ void FileManager::handleNormalEvent(Event event, ScreenInteractive &screen) {
                 promptUser(Prompt::NewDir);
                 break;
             case 'y':
-                copyPath = selEntryPath;
+                clipboard = {selEntryPath};
+                clipCut = false;
                 break;
             case 'Y':
                 termCmd = FileManager::TermCmds::CopyToSys;
                 screen.ExitLoopClosure()();
                 break;
             case 'x':
-                cutPath = selEntryPath;
+                clipboard = {selEntryPath};
+                clipCut = true;
                 break;
             case 'p':
                 if (std::optional<Prompt> result = tryPaste()) { promptUser(*result); }
                 break;
+            case 'b':
+                promptUser(Prompt::Jobs);
+                break;
             case 'u':
                 undo();
+                break;
             case 'v':
                 mode = Mode::Select;
                 break;
+            case 's':
+                setSortMode(static_cast<SortMode>((static_cast<int>(sortMode) + 1) % 5),
+                            sortReversed);
+                break;
+            case 'S':
+                setSortMode(sortMode, !sortReversed);
+                break;
+            case 'i':
+                showStats = !showStats;
+                break;
+            case 'P':
+                togglePreview();
+                break;
+            case 'g':
+                openGrep({cwd});
+                break;
+            case '=':
+                prompt = Prompt::CompareWith;
+                promptInput = compareRight.empty() ? cwd.string() : compareRight.string();
+                break;
+            case 'D':
+                openDuplicates(!selEntryPath.empty() && fs::is_directory(selEntryPath)
+                                   ? selEntryPath
+                                   : cwd);
+                break;
             default:
                 break;
             }
@@ -176,7 +796,8 @@ void FileManager::handleNormalEvent(Event event, ScreenInteractive &screen) {
     } else if (event == Event::Return) {
         toggleExpand();
     } else if (event == Event::Escape) {
-        expandedDirs.clear();
+        tree.clearExpanded();
+        tree.setExpanded(cwdNode, true);
         refresh();
     } else if (event == Event::ArrowUp) {
         changeDirFromHistory(screen);
@@ -203,6 +824,29 @@ void FileManager::handleSelectEvent(Event event, ScreenInteractive &screen) {
             case ' ':
                 toggleSelect();
                 break;
+            case 'd':
+                promptBatch = selectionPaths();
+                if (!promptBatch.empty()) prompt = Prompt::Delete;
+                break;
+            case 'm':
+                promptBatch = selectionPaths();
+                if (!promptBatch.empty()) {
+                    prompt = Prompt::Move;
+                    promptInput = cwd.string();
+                }
+                break;
+            case 'y':
+            case 'x':
+                clipboard = selectionPaths();
+                clipCut = ch[0] == 'x';
+                endBatch();
+                break;
+            case 'g': {
+                std::vector<fs::path> roots = selectionPaths();
+                endBatch();
+                openGrep(roots.empty() ? std::vector<fs::path>{cwd} : std::move(roots));
+                break;
+            }
             default:
                 break;
             }
@@ -210,7 +854,7 @@ void FileManager::handleSelectEvent(Event event, ScreenInteractive &screen) {
     } else if (event == Event::Return) {
         toggleExpand();
     } else if (event == Event::Escape) {
-        selItems.clear();
+        tree.clearSelection();
         mode = Mode::Normal;
     } else if (event == Event::ArrowUp) {
         changeDirFromHistory(screen);
@@ -226,9 +870,9 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
             selDriveIdx = (selDriveIdx + 1) % drives.size();
         } else if (event == Event::Return) {
             cwd = fs::path(drives[selDriveIdx].path);
-            expandedDirs.clear();
-            expandedDirs.insert(cwd);
-            refresh();
+            tree.clearExpanded();
+            tree.setExpanded(tree.intern(cwd), true);
+            loadDir();
             prompt = Prompt::None;
         } else if (event == Event::Escape) {
             prompt = Prompt::None;
@@ -236,29 +880,34 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
         break;
 
     case Prompt::History:
-        if (event == Event::Character("k")) {
-            selHistIdx = (selHistIdx - 1 + history.size()) % history.size();
-        } else if (event == Event::Character("j")) {
-            selHistIdx = (selHistIdx + 1) % history.size();
+        if (event == Event::ArrowUp) {
+            if (selHistIdx > 0) --selHistIdx;
+        } else if (event == Event::ArrowDown) {
+            if (selHistIdx + 1 < jump.results().size()) ++selHistIdx;
         } else if (event == Event::Return) {
-            cwd = fs::path(history[selHistIdx]);
-            expandedDirs.clear();
-            expandedDirs.insert(cwd);
-            refresh();
+            if (selHistIdx < jump.results().size()) {
+                cwd = jump.dir(jump.results()[selHistIdx]);
+                tree.clearExpanded();
+                tree.setExpanded(tree.intern(cwd), true);
+                loadDir();
+            }
             prompt = Prompt::None;
         } else if (event == Event::Escape) {
             prompt = Prompt::None;
+        } else {
+            std::string before = promptInput;
+            promptContainer->OnEvent(event);
+            if (promptInput != before) {
+                selHistIdx = 0;
+                jump.setQuery(promptInput);
+            }
         }
         break;
 
     case Prompt::Rename:
         if (event == Event::Return) {
-            fs::path newPath = promptPath.parent_path() / promptInput;
-            fs::rename(promptPath, newPath);
-            Undo u = Undo{prompt, promptPath, newPath};
-            undoStack.push(u);
+            submitMove(Prompt::Rename, {{promptPath, promptPath.parent_path() / promptInput}});
             prompt = Prompt::None;
-            refresh();
         } else if (event == Event::Escape) {
             prompt = Prompt::None;
         } else {
@@ -268,12 +917,12 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
 
     case Prompt::Move:
         if (event == Event::Return) {
-            fs::path newPath = promptInput / promptPath.filename();
-            fs::rename(promptPath, newPath);
-            Undo u = Undo{prompt, promptPath, newPath};
-            undoStack.push(u);
+            Transfers items;
+            for (const auto &p : promptBatch.empty() ? std::vector{promptPath} : promptBatch)
+                items.emplace_back(p, promptInput / p.filename());
+            submitMove(Prompt::Move, std::move(items));
+            endBatch();
             prompt = Prompt::None;
-            refresh();
         } else if (event == Event::Escape) {
             prompt = Prompt::None;
         } else {
@@ -283,30 +932,33 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
 
     case Prompt::Delete:
         if (event == Event::Return) {
-            if (fs::is_regular_file(promptPath)) {
-                Undo u{prompt, promptPath, {}, std::nullopt};
-                std::ifstream in(promptPath, std::ios::binary);
-                std::string data((std::istreambuf_iterator<char>(in)),
-                                 std::istreambuf_iterator<char>());
-                u.contents = data;
-                undoStack.push(u);
-            }
-            deleteFilOrDir(promptPath);
+            submitDelete(promptBatch.empty() ? std::vector{promptPath} : promptBatch,
+                         std::move(promptOriginals));
+            endBatch();
             prompt = Prompt::None;
-            refresh();
         } else if (event == Event::Escape) {
+            promptOriginals.clear();
             prompt = Prompt::None;
         } else {
             promptContainer->OnEvent(event);
         }
         break;
 
+    case Prompt::DeleteForever:
+        if (event == Event::Return) {
+            submitDeleteForever(std::move(promptBatch));
+            promptBatch.clear();
+            prompt = Prompt::None;
+        } else if (event == Event::Escape) {
+            promptBatch.clear();
+            prompt = Prompt::None;
+        }
+        break;
+
     case Prompt::Replace:
         if (event == Event::Return) {
-            deleteFilOrDir(promptPath);
-            tryPaste();
+            tryPaste(true);
             prompt = Prompt::None;
-            refresh();
         } else if (event == Event::Escape) {
             prompt = Prompt::None;
         } else {
@@ -317,10 +969,10 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
     case Prompt::NewFile:
         if (event == Event::Return) {
             std::ofstream((promptPath / promptInput).string());
-            Undo u = Undo{prompt, promptPath / promptInput, {}, std::nullopt};
-            undoStack.push(u);
+            Undo u = Undo{prompt, promptPath / promptInput, {}};
+            pushUndo({u});
             prompt = Prompt::None;
-            refresh();
+            applyChanges({{FsChange::Kind::Created, u.source}});
         } else if (event == Event::Escape) {
             prompt = Prompt::None;
         } else {
@@ -331,10 +983,10 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
     case Prompt::NewDir:
         if (event == Event::Return) {
             fs::create_directory(promptPath / promptInput);
-            Undo u = Undo{prompt, promptPath / promptInput, {}, std::nullopt};
-            undoStack.push(u);
+            Undo u = Undo{prompt, promptPath / promptInput, {}};
+            pushUndo({u});
             prompt = Prompt::None;
-            refresh();
+            applyChanges({{FsChange::Kind::Created, u.source}});
         } else if (event == Event::Escape) {
             prompt = Prompt::None;
         } else {
@@ -348,44 +1000,28 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
             if (ch.size() == 1) {
                 switch (ch[0]) {
                 case 'c':
-                    termCmd = TermCmds::FzfClipFile;
-                    prompt = Prompt::None;
-                    screen.ExitLoopClosure()();
+                    openFuzzy(FuzzyAction::CopyPath, selEntryPath);
                     break;
                 case 'f':
-                    termCmd = TermCmds::FzfHxFile;
-                    prompt = Prompt::None;
-                    screen.ExitLoopClosure()();
+                    openFuzzy(FuzzyAction::Edit, selEntryPath);
                     break;
                 case 'o':
-                    termCmd = TermCmds::FzfOpenFile;
-                    prompt = Prompt::None;
-                    screen.ExitLoopClosure()();
+                    openFuzzy(FuzzyAction::Open, selEntryPath);
                     break;
                 case 'e':
-                    termCmd = TermCmds::FzfCdFile;
-                    prompt = Prompt::None;
-                    screen.ExitLoopClosure()();
+                    openFuzzy(FuzzyAction::Cd, selEntryPath);
                     break;
                 case 'C':
-                    termCmd = TermCmds::FzfClipCwd;
-                    prompt = Prompt::None;
-                    screen.ExitLoopClosure()();
+                    openFuzzy(FuzzyAction::CopyFile, cwd);
                     break;
                 case 'F':
-                    termCmd = TermCmds::FzfHxCwd;
-                    prompt = Prompt::None;
-                    screen.ExitLoopClosure()();
+                    openFuzzy(FuzzyAction::Edit, cwd);
                     break;
                 case 'O':
-                    termCmd = TermCmds::FzfOpenCwd;
-                    prompt = Prompt::None;
-                    screen.ExitLoopClosure()();
+                    openFuzzy(FuzzyAction::Open, cwd);
                     break;
                 case 'E':
-                    termCmd = TermCmds::FzfCdCwd;
-                    prompt = Prompt::None;
-                    screen.ExitLoopClosure()();
+                    openFuzzy(FuzzyAction::Cd, cwd);
                     break;
                 case '\x1b': // Escape
                     prompt = Prompt::None;
@@ -397,6 +1033,139 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
         }
         break;
 
+    case Prompt::Fuzzy:
+        if (event == Event::Escape) {
+            fuzzy.close();
+            prompt = Prompt::None;
+        } else if (event == Event::Return) {
+            acceptFuzzy(screen);
+        } else if (event == Event::ArrowUp) {
+            if (fuzzyIdx > 0) --fuzzyIdx;
+        } else if (event == Event::ArrowDown) {
+            if (fuzzyIdx + 1 < fuzzyResults.top.size()) ++fuzzyIdx;
+        } else {
+            std::string before = promptInput;
+            promptContainer->OnEvent(event);
+            if (promptInput != before) {
+                fuzzyIdx = 0;
+                fuzzy.setQuery(promptInput);
+            }
+        }
+        break;
+
+    case Prompt::Grep:
+        if (event == Event::Escape) {
+            grep.cancel();
+            prompt = Prompt::None;
+        } else if (event == Event::Return) {
+            acceptGrep(false, screen);
+        } else if (event == Event::Tab) {
+            acceptGrep(true, screen);
+        } else if (event == Event::ArrowUp) {
+            if (grepIdx > 0) --grepIdx;
+        } else if (event == Event::ArrowDown) {
+            if (grepIdx + 1 < grepHits.size()) ++grepIdx;
+        } else {
+            std::string before = promptInput;
+            promptContainer->OnEvent(event);
+            if (promptInput != before) startGrep();
+        }
+        break;
+
+    case Prompt::CompareWith:
+        if (event == Event::Return) {
+            startCompare(promptInput);
+            prompt = Prompt::Compare;
+        } else if (event == Event::Escape) {
+            prompt = Prompt::None;
+        } else {
+            promptContainer->OnEvent(event);
+        }
+        break;
+
+    case Prompt::Compare:
+        if (event == Event::Character("j") || event == Event::ArrowDown) {
+            if (compareIdx + 1 < compareStatus.diffs.size()) ++compareIdx;
+        } else if (event == Event::Character("k") || event == Event::ArrowUp) {
+            if (compareIdx > 0) --compareIdx;
+        } else if (event == Event::Return) {
+            if (compareIdx < compareStatus.diffs.size()) {
+                const DirCompare::Diff &diff = compareStatus.diffs[compareIdx];
+                bool right = diff.kind == DirCompare::Kind::OnlyRight;
+                reveal((right ? compareRight : compareLeft) / diff.rel);
+                prompt = Prompt::None;
+            }
+        } else if (event == Event::Character("s")) {
+            if (!syncItems().empty()) prompt = Prompt::Sync;
+        } else if (event == Event::Character("c")) {
+            clearCompare();
+            prompt = Prompt::None;
+        } else if (event == Event::Escape) {
+            prompt = Prompt::None; // differences stay marked in the tree
+        }
+        break;
+
+    case Prompt::Sync:
+        if (event == Event::Return) {
+            submitCopy(syncItems(), true);
+            clearCompare(); // stale once the copies land
+            prompt = Prompt::None;
+        } else if (event == Event::Escape) {
+            prompt = Prompt::Compare;
+        }
+        break;
+
+    case Prompt::Duplicates:
+        if (event == Event::Character("j") || event == Event::ArrowDown) {
+            moveDupCursor(1);
+        } else if (event == Event::Character("k") || event == Event::ArrowUp) {
+            moveDupCursor(-1);
+        } else if (event == Event::Character(" ")) {
+            if (dupIdx < dupRows.size() && dupRows[dupIdx].file != std::string::npos) {
+                const DupRow &row = dupRows[dupIdx];
+                const fs::path &path = dupStatus.groups[row.group].files[row.file].path;
+                markDuplicate(path, !dupMarked(path));
+                moveDupCursor(1);
+            }
+        } else if (event == Event::Character("a")) {
+            markAllDuplicates();
+        } else if (event == Event::Character("d")) {
+            deleteDuplicates();
+            if (prompt == Prompt::Delete) duplicates.cancel();
+        } else if (event == Event::Character("L")) {
+            duplicates.cancel();
+            linkDuplicates();
+            tree.clearSelection();
+            prompt = Prompt::None;
+        } else if (event == Event::Escape || event == Event::Character("D")) {
+            // Marks stay selected, to act on from select mode.
+            duplicates.cancel();
+            if (tree.selectionCount()) mode = Mode::Select;
+            prompt = Prompt::None;
+        }
+        break;
+
+    case Prompt::Jobs:
+        if (event == Event::Character("k")) {
+            if (selJobIdx > 0) --selJobIdx;
+        } else if (event == Event::Character("j")) {
+            if (selJobIdx + 1 < jobList.size()) ++selJobIdx;
+        } else if (event == Event::Character("x")) {
+            if (selJobIdx < jobList.size()) {
+                if (jobList[selJobIdx].state == JobQueue::State::Failed)
+                    jobList.erase(jobList.begin() + selJobIdx);
+                else
+                    jobs.cancel(jobList[selJobIdx].id);
+            }
+        } else if (event == Event::Character("c")) {
+            std::erase_if(jobList,
+                           [](const auto &job) { return job.state == JobQueue::State::Failed; });
+        } else if (event == Event::Escape || event == Event::Character("b")) {
+            prompt = Prompt::None;
+        }
+        if (!jobList.empty()) selJobIdx = std::min(selJobIdx, jobList.size() - 1);
+        break;
+
     default:
         if (event == Event::Return || event == Event::Escape)
             prompt = Prompt::None;
@@ -407,10 +1176,13 @@ void FileManager::handlePromptEvent(Event event, ScreenInteractive &screen) {
 }
 
 bool FileManager::handleTermCmd(FileManager::TermCmds termCmd) {
+    static const char *names[] = {"none", "cd",   "quit", "quit to last",
+                                  "edit", "open", "copy to system", "run"};
+    TraceSpan span("termCmd", names[static_cast<int>(termCmd)]);
     try {
         switch (termCmd) {
         case FileManager::TermCmds::Edit:
-            return !edit(selEntryPath.string());
+            return !edit(termTarget.value_or(selEntryPath).string(), termLine.value_or(0));
         case FileManager::TermCmds::Open:
             return !start(selEntryPath.string());
         case FileManager::TermCmds::CopyToSys:
@@ -424,43 +1196,6 @@ bool FileManager::handleTermCmd(FileManager::TermCmds termCmd) {
             return true;
         case FileManager::TermCmds::Run:
             return !runFileFromTerm(selEntryPath.string());
-        case FileManager::TermCmds::FzfClipFile:
-            if (std::optional<fs::path> selected = runFzf(selEntryPath)) {
-                copyPathToClip(selected->string());
-            }
-            return false;
-        case FileManager::TermCmds::FzfHxFile:
-            if (std::optional<fs::path> selected = runFzf(selEntryPath)) {
-                return !edit(selected->string());
-            }
-            return false;
-        case FileManager::TermCmds::FzfOpenFile:
-            if (std::optional<fs::path> selected = runFzf(selEntryPath)) {
-                return !start(selected->string());
-            }
-            return false;
-        case FileManager::TermCmds::FzfCdFile:
-            if (std::optional<fs::path> selected = runFzf(selEntryPath)) {
-                return !changeDir(selEntryPath);
-            }
-            return false;
-        case FileManager::TermCmds::FzfClipCwd:
-            if (std::optional<fs::path> selected = runFzf(cwd)) {
-                return !copyFileToClip(selected->string());
-            }
-            return false;
-        case FileManager::TermCmds::FzfHxCwd:
-            if (std::optional<fs::path> selected = runFzf(cwd)) {
-                return !edit(selected->string());
-            }
-            return false;
-        case FileManager::TermCmds::FzfOpenCwd:
-            if (std::optional<fs::path> selected = runFzf(cwd)) {
-                return !start(selected->string());
-            }
-            return false;
-        case FileManager::TermCmds::FzfCdCwd:
-            return changeDir(selEntryPath);
         default:
             return true;
         }
@@ -498,41 +1233,52 @@ void FileManager::moveSelection(int delta, ScreenInteractive &screen) {
 }
 
 void FileManager::goToParent() {
-    if (!parentIdxs.empty()) {
-        selIdx = parentIdxs.back();
+    if (!parentIdxs.empty())
         parentIdxs.pop_back();
-    } else {
-        selIdx = 0;
-        expandedDirs.clear();
-    }
-    updateSelEntryPath();
+    else
+        tree.clearExpanded();
 
-    scrollOffset = 0;
     if (cwd.has_parent_path()) {
+        pendingSelect = cwd;
         cwd = cwd.parent_path();
-        refresh();
+        loadDir();
     }
 }
 
 void FileManager::openDir() {
+    if (entries.empty() || !tree.isDir(entries[selIdx].node)) return;
     parentIdxs.push_back(selIdx);
-
-    if (fs::is_directory(selEntryPath)) {
-        cwd = selEntryPath;
-        refresh();
-    }
-    selIdx = 0;
-    scrollOffset = 0;
-    updateSelEntryPath();
+    cwd = selEntryPath;
+    loadDir();
 }
 
 void FileManager::toggleExpand() {
-    if (!fs::is_directory(selEntryPath)) return;
-    if (expandedDirs.count(selEntryPath))
-        expandedDirs.erase(selEntryPath);
-    else
-        expandedDirs.insert(selEntryPath);
-    refresh();
+    if (entries.empty() || !tree.isDir(entries[selIdx].node)) return;
+    Tree::NodeId node = entries[selIdx].node;
+    int depth = entries[selIdx].depth;
+    tree.setExpanded(node, !tree.expanded(node));
+    if (loading) { // rows are still being merged; restart with the new expansion
+        pendingSelect = selEntryPath;
+        loadDir();
+        return;
+    }
+
+    // Only the toggled subtree changes: splice it in or cut it out below the row, and watch
+    // or stop watching its directories.
+    std::set<fs::path> dirs = expandedPaths(node);
+    dirs.insert(selEntryPath);
+    if (tree.expanded(node)) {
+        std::vector<Entry> rows = scanTree(selEntryPath, depth + 1);
+        size_t count = rows.size();
+        spliceChildren(selIdx, std::move(rows));
+        requestDirSizes(selIdx + 1, selIdx + 1 + count);
+        watcher.addDirs(dirs);
+    } else {
+        size_t end = selIdx + 1;
+        while (end < entries.size() && entries[end].depth > depth) ++end;
+        entries.erase(entries.begin() + selIdx + 1, entries.begin() + end);
+        watcher.removeDirs(dirs);
+    }
 }
 
 void FileManager::changeDrive(ScreenInteractive &) {
@@ -542,21 +1288,261 @@ void FileManager::changeDrive(ScreenInteractive &) {
 }
 
 void FileManager::changeDirFromHistory(ScreenInteractive &) {
-    history = listHistory();
+    jump.load(openHistory().load(), cwd);
+    promptInput.clear();
     selHistIdx = 0;
     prompt = Prompt::History;
 }
 
 void FileManager::toggleSelect() {
-    if (selItems.count(selEntryPath))
-        selItems.erase(selEntryPath);
-    else
-        selItems.insert(selEntryPath);
+    if (entries.empty()) return;
+    Tree::NodeId node = entries[selIdx].node;
+    tree.setSelected(node, !tree.selected(node));
+}
+
+void FileManager::openFuzzy(FuzzyAction action, fs::path root) {
+    if (root.empty()) root = cwd;
+    if (!fs::is_directory(root)) root = root.parent_path();
+    fuzzyAction = action;
+    fuzzyResults = {};
+    fuzzyIdx = 0;
+    promptInput.clear();
+    fuzzy.open(root, action == FuzzyAction::Cd, indexer.covering(root));
+    prompt = Prompt::Fuzzy;
+}
+
+void FileManager::setFuzzyResults(FuzzyFinder::Results results) {
+    if (prompt != Prompt::Fuzzy || results.gen != fuzzy.generation()) return;
+    fuzzyResults = std::move(results);
+    fuzzyIdx = std::min(fuzzyIdx, fuzzyResults.top.empty() ? 0 : fuzzyResults.top.size() - 1);
+}
+
+// Runs the picker's action on the highlighted result. Only editing leaves the TUI.
+void FileManager::acceptFuzzy(ScreenInteractive &screen) {
+    if (fuzzyIdx >= fuzzyResults.top.size()) return;
+    fs::path picked = fuzzy.root() / fuzzy.text(fuzzyResults.top[fuzzyIdx].id);
+    fuzzy.close();
+    prompt = Prompt::None;
+
+    switch (fuzzyAction) {
+    case FuzzyAction::Edit:
+        termCmd = TermCmds::Edit;
+        termTarget = picked;
+        screen.ExitLoopClosure()();
+        break;
+    case FuzzyAction::Open:
+        start(picked.string());
+        break;
+    case FuzzyAction::CopyPath:
+        copyPathToClip(picked.string());
+        break;
+    case FuzzyAction::CopyFile:
+        copyFileToClip(picked.string());
+        break;
+    case FuzzyAction::Cd:
+        changeDir(picked);
+        cwd = picked;
+        parentIdxs.clear();
+        tree.clearExpanded();
+        tree.setExpanded(tree.intern(cwd), true);
+        loadDir();
+        break;
+    }
+}
+
+void FileManager::openGrep(std::vector<fs::path> roots) {
+    grepRoots = std::move(roots);
+    promptInput.clear();
+    startGrep();
+    prompt = Prompt::Grep;
+}
+
+// Restarts the search for the current input; the running one is cancelled.
+void FileManager::startGrep() {
+    grepHits.clear();
+    grepFiles = 0;
+    grepIdx = 0;
+    grepCapped = false;
+    grepDone = promptInput.empty();
+    grep.start(grepRoots, promptInput);
+}
+
+void FileManager::addGrepResults(ContentSearch::Results results) {
+    if (prompt != Prompt::Grep || results.gen != grep.generation()) return;
+    std::move(results.hits.begin(), results.hits.end(), std::back_inserter(grepHits));
+    grepFiles = results.filesSearched;
+    grepDone = results.done;
+    grepCapped = results.capped;
+}
+
+// Opens the highlighted hit in the editor at its line, or with `inTree` shows it in the tree.
+void FileManager::acceptGrep(bool inTree, ScreenInteractive &screen) {
+    if (grepIdx >= grepHits.size()) return;
+    ContentSearch::Hit hit = grepHits[grepIdx];
+    grep.cancel();
+    prompt = Prompt::None;
+
+    if (inTree) {
+        reveal(hit.file);
+        return;
+    }
+    termCmd = TermCmds::Edit;
+    termTarget = hit.file;
+    termLine = hit.line;
+    screen.ExitLoopClosure()();
+}
+
+// Makes the directory of `path` the cwd and selects `path` once it is listed.
+void FileManager::reveal(const fs::path &path) {
+    cwd = path.parent_path();
+    parentIdxs.clear();
+    tree.clearExpanded();
+    tree.setExpanded(tree.intern(cwd), true);
+    loadDir();
+    pendingSelect = path;
+}
+
+void FileManager::startCompare(fs::path right) {
+    compareLeft = cwd;
+    // Relative input is relative to the directory shown, not the one the process started in.
+    compareRight = (cwd / right).lexically_normal();
+    if (!compareRight.has_filename()) compareRight = compareRight.parent_path();
+    compareStatus = {};
+    compareMarks.clear();
+    compareIdx = 0;
+    compare.start(compareLeft, compareRight);
+}
+
+void FileManager::setCompare(DirCompare::Status status) {
+    if (compareLeft.empty() || status.gen != compare.generation()) return;
+    compareStatus = std::move(status);
+    if (!compareStatus.done) return;
+    for (const auto &diff : compareStatus.diffs) {
+        if (diff.kind == DirCompare::Kind::OnlyRight) continue;
+        compareMarks[diff.rel.generic_string()] = diff.kind;
+        for (fs::path dir = diff.rel.parent_path(); !dir.empty(); dir = dir.parent_path())
+            compareMarks.try_emplace(dir.generic_string(), DirCompare::Kind::Changed);
+    }
+}
+
+void FileManager::clearCompare() {
+    compare.cancel();
+    compareLeft.clear();
+    compareStatus = {};
+    compareMarks.clear();
+    compareIdx = 0;
+}
+
+// One-way sync: what is new or changed on the left, to copy over the right.
+FileManager::Transfers FileManager::syncItems() const {
+    Transfers items;
+    for (const auto &diff : compareStatus.diffs)
+        if (diff.kind != DirCompare::Kind::OnlyRight)
+            items.emplace_back(compareLeft / diff.rel, compareRight / diff.rel);
+    return items;
+}
+
+std::optional<DirCompare::Kind> FileManager::compareMark(Tree::NodeId node) const {
+    if (compareMarks.empty()) return std::nullopt;
+    auto it = compareMarks.find(tree.path(node).lexically_relative(compareLeft).generic_string());
+    if (it == compareMarks.end()) return std::nullopt;
+    return it->second;
+}
+
+void FileManager::openDuplicates(fs::path root) {
+    // Marks are the selection; what was selected before must not be acted on with them.
+    tree.clearSelection();
+    mode = Mode::Normal;
+    dupRoot = std::move(root);
+    dupStatus = {};
+    dupRows.clear();
+    dupIdx = 0;
+    duplicates.start(dupRoot);
+    prompt = Prompt::Duplicates;
+}
+
+void FileManager::setDuplicates(DuplicateFinder::Status status) {
+    if (prompt != Prompt::Duplicates || status.gen != duplicates.generation()) return;
+    dupStatus = std::move(status);
+    if (dupStatus.stage != DuplicateFinder::Stage::Done) return;
+    dupRows.clear();
+    for (size_t g = 0; g < dupStatus.groups.size(); ++g) {
+        dupRows.push_back({g, std::string::npos});
+        for (size_t f = 0; f < dupStatus.groups[g].files.size(); ++f) dupRows.push_back({g, f});
+    }
+    dupIdx = 0;
+    moveDupCursor(1); // onto the first file
+}
+
+// Moves between file rows, skipping group headers.
+void FileManager::moveDupCursor(int delta) {
+    size_t idx = dupIdx;
+    while (true) {
+        if (delta < 0 ? idx == 0 : idx + 1 >= dupRows.size()) return;
+        idx += delta;
+        if (dupRows[idx].file != std::string::npos) break;
+    }
+    dupIdx = idx;
+}
+
+void FileManager::markDuplicate(const fs::path &path, bool on) {
+    tree.setSelected(tree.intern(path), on);
+}
+
+bool FileManager::dupMarked(const fs::path &path) const {
+    auto node = tree.find(path);
+    return node && tree.selected(*node);
+}
+
+// Marks every file of every group except the first one and its hard links.
+void FileManager::markAllDuplicates() {
+    for (const auto &group : dupStatus.groups) {
+        uint32_t keep = group.files.front().copy; // with its other links, if any
+        for (const auto &file : group.files) markDuplicate(file.path, file.copy != keep);
+    }
+}
+
+// Replaces each marked file with a hard link to an unmarked copy in its group. Groups whose
+// copies are all marked are left alone.
+void FileManager::linkDuplicates() {
+    Transfers items;
+    for (const auto &group : dupStatus.groups) {
+        auto keep = std::find_if(group.files.begin(), group.files.end(),
+                                 [&](const auto &file) { return !dupMarked(file.path); });
+        if (keep == group.files.end()) continue;
+        for (const auto &file : group.files)
+            if (file.copy != keep->copy && dupMarked(file.path))
+                items.emplace_back(keep->path, file.path);
+    }
+    submitLink(std::move(items));
+}
+
+// Asks to delete the marked files that have an unmarked copy in their group to keep. Each is
+// compared with that copy again before it goes.
+void FileManager::deleteDuplicates() {
+    promptBatch.clear();
+    promptOriginals.clear();
+    for (const auto &group : dupStatus.groups) {
+        auto keep = std::find_if(group.files.begin(), group.files.end(),
+                                 [&](const auto &file) { return !dupMarked(file.path); });
+        if (keep == group.files.end()) continue;
+        for (const auto &file : group.files) {
+            if (!dupMarked(file.path)) continue;
+            promptBatch.push_back(file.path);
+            promptOriginals.push_back(keep->path);
+        }
+    }
+    if (!promptBatch.empty()) prompt = Prompt::Delete;
 }
 
 void FileManager::promptUser(Prompt m) {
+    promptBatch.clear();
+    promptOriginals.clear();
+    bool needsEntry = m == Prompt::Rename || m == Prompt::Move || m == Prompt::Delete;
+    if (needsEntry && selEntryPath.empty()) return;
+
     prompt = m;
-    if (prompt != Prompt::Replace) { promptPath = selEntryPath; }
+    if (prompt != Prompt::Replace) { promptPath = selEntryPath.empty() ? cwd : selEntryPath; }
     if (prompt == Prompt::NewFile || prompt == Prompt::NewDir) {
         if (!fs::is_directory(promptPath)) {
             promptPath = promptPath.parent_path();
@@ -569,79 +1555,384 @@ void FileManager::promptUser(Prompt m) {
     }
 }
 
-std::optional<FileManager::Prompt> FileManager::tryPaste() {
-    if (!copyPath && !cutPath) {
+std::optional<FileManager::Prompt> FileManager::tryPaste(bool replace) {
+    if (clipboard.empty()) return std::nullopt;
+
+    Transfers items;
+    for (const auto &from : clipboard)
+        if (clipCut || fs::exists(from)) items.emplace_back(from, cwd / from.filename());
+    if (clipCut) {
+        submitMove(Prompt::None, std::move(items));
+        clipboard.clear();
         return std::nullopt;
-    } else if (copyPath.has_value()) {
-        if (fs::exists(*copyPath)) {
-            fs::path dest = cwd / copyPath->filename();
-            if (fs::exists(dest)) {
-                promptPath = dest;
-                return Prompt::Replace;
-            } else if (fs::is_directory(*copyPath)) {
-                fs::copy(*copyPath, dest, fs::copy_options::recursive);
-            } else {
-                fs::copy_file(*copyPath, dest);
-                copyPath.reset();
-            }
+    }
+    if (!replace) {
+        for (const auto &item : items) {
+            if (!fs::exists(item.second)) continue;
+            promptPath = item.second;
+            return Prompt::Replace;
         }
-    } else if (cutPath.has_value()) {
-        fs::path dest = cwd / cutPath->filename();
-        fs::rename(*cutPath, dest);
-        cutPath.reset();
     }
-    refresh();
+    // A single yanked file is pasted once; directories and selections stay on the clipboard.
+    if (clipboard.size() == 1 && !fs::is_directory(clipboard.front())) clipboard.clear();
+    submitCopy(std::move(items), replace);
     return std::nullopt;
 }
 
+void FileManager::submitCopy(Transfers items, bool replace) {
+    if (items.empty()) return;
+    jobs.submit(batchTitle("Copy", items), lockPaths(items),
+                [this, items, replace](std::stop_token stop, const JobQueue::Report &report) {
+                    // Existing destinations are only replaced once their copy is complete,
+                    // so a failed or cancelled copy leaves them as they were.
+                    Transfers staged = items;
+                    if (replace)
+                        for (auto &item : staged)
+                            if (fs::exists(fs::symlink_status(item.second)))
+                                item.second = stagingPath(item.second);
+                    CopyEngine engine([&](const CopyEngine::Progress &p) {
+                        report(copyProgress(p));
+                    });
+                    if (!engine.run(staged, stop)) return JobQueue::Completion();
+                    std::vector<FsChange> changes;
+                    std::vector<std::string> errors(items.size());
+                    for (size_t i = 0; i < items.size(); ++i) {
+                        try {
+                            if (staged[i].second != items[i].second)
+                                replaceWith(staged[i].second, items[i].second);
+                            changes.push_back({FsChange::Kind::Created, items[i].second});
+                        } catch (const std::exception &ex) {
+                            errors[i] = ex.what();
+                        }
+                    }
+                    return batchDone(errors, [this, changes] { applyChanges(changes); });
+                });
+}
+
+// Moves every (from, to) pair in the background, in parallel; what moved is recorded as one
+// undo step of type `undoAs` unless that is None.
+void FileManager::submitMove(Prompt undoAs, Transfers items) {
+    if (items.empty()) return;
+    jobs.submit(
+        batchTitle(undoAs == Prompt::Rename ? "Rename" : "Move", items), lockPaths(items),
+        [this, undoAs, items](std::stop_token stop, const JobQueue::Report &report) {
+            std::vector<char> moved(items.size());
+            auto errors = runBatch(items.size(), stop, report,
+                                   [&](size_t i, const JobQueue::Report &itemReport) {
+                                       const auto &[from, to] = items[i];
+                                       moved[i] = movePath(from, to, stop, itemReport);
+                                   });
+            std::vector<Undo> steps;
+            std::vector<FsChange> changes;
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (!moved[i]) continue;
+                const auto &[from, to] = items[i];
+                steps.push_back(Undo{undoAs, from, to});
+                changes.push_back({FsChange::Kind::Removed, from});
+                changes.push_back({FsChange::Kind::Created, to});
+            }
+            return batchDone(errors, [this, undoAs, steps, changes] {
+                if (undoAs != Prompt::None) pushUndo(steps);
+                applyChanges(changes);
+            });
+        });
+}
+
+// Moves targets to the trash in the background, in parallel. An item that cannot be trashed
+// fails; where that is because its file system has no trash at all (say, a mount whose top
+// directory is not writable), deleting it for good is offered once the job is done. With
+// `originals`, each target is a duplicate and only goes if it still matches its original.
+void FileManager::submitDelete(std::vector<fs::path> targets, std::vector<fs::path> originals) {
+    if (targets.empty()) return;
+    jobs.submit(
+        batchTitle("Delete", targets), lockPaths(targets),
+        [this, targets, originals](std::stop_token stop, const JobQueue::Report &report) {
+            std::vector<fs::path> trashed(targets.size());
+            std::vector<char> noTrash(targets.size());
+            auto errors = runBatch(targets.size(), stop, report,
+                                   [&](size_t i, const JobQueue::Report &) {
+                                       if (!originals.empty())
+                                           requireSameContents(originals[i], targets[i]);
+                                       try {
+                                           trashed[i] = Trash::put(targets[i]);
+                                       } catch (const Trash::Unavailable &) {
+                                           noTrash[i] = true;
+                                           throw;
+                                       }
+                                   });
+            std::vector<Undo> steps;
+            std::vector<FsChange> changes;
+            std::vector<fs::path> untrashable;
+            for (size_t i = 0; i < targets.size(); ++i) {
+                if (noTrash[i]) untrashable.push_back(targets[i]);
+                if (trashed[i].empty()) continue;
+                steps.push_back(Undo{Prompt::Delete, targets[i], trashed[i]});
+                changes.push_back({FsChange::Kind::Removed, targets[i]});
+            }
+            return batchDone(errors, [this, steps, changes, untrashable] {
+                pushUndo(steps);
+                applyChanges(changes);
+                // Not while another prompt is up; deleting again asks again.
+                if (untrashable.empty() || prompt != Prompt::None) return;
+                promptBatch = untrashable;
+                prompt = Prompt::DeleteForever;
+            });
+        });
+}
+
+// Deletes targets for good, in parallel; there is no undo.
+void FileManager::submitDeleteForever(std::vector<fs::path> targets) {
+    if (targets.empty()) return;
+    jobs.submit(
+        batchTitle("Delete", targets), lockPaths(targets),
+        [this, targets](std::stop_token stop, const JobQueue::Report &report) {
+            std::vector<char> deleted(targets.size());
+            auto errors = runBatch(targets.size(), stop, report,
+                                   [&](size_t i, const JobQueue::Report &) {
+                                       deleteFilOrDir(targets[i]);
+                                       deleted[i] = true;
+                                   });
+            std::vector<FsChange> changes;
+            for (size_t i = 0; i < targets.size(); ++i)
+                if (deleted[i]) changes.push_back({FsChange::Kind::Removed, targets[i]});
+            return batchDone(errors, [this, changes] { applyChanges(changes); });
+        });
+}
+
+// Replaces every `to` with a hard link to its `from`. Not recorded for undo: the replaced
+// contents live on in `from`.
+void FileManager::submitLink(Transfers items) {
+    if (items.empty()) return;
+    jobs.submit(
+        batchTitle("Link", items), lockPaths(items),
+        [this, items](std::stop_token stop, const JobQueue::Report &report) {
+            std::vector<char> linked(items.size());
+            auto errors = runBatch(items.size(), stop, report,
+                                   [&](size_t i, const JobQueue::Report &) {
+                                       linkOver(items[i].first, items[i].second);
+                                       linked[i] = true;
+                                   });
+            std::vector<FsChange> changes;
+            for (size_t i = 0; i < items.size(); ++i)
+                if (linked[i]) changes.push_back({FsChange::Kind::Modified, items[i].second});
+            return batchDone(errors, [this, changes] { applyChanges(changes); });
+        });
+}
+
+// Leaves select mode once an action has taken the selection.
+void FileManager::endBatch() {
+    promptOriginals.clear();
+    if (promptBatch.empty() && mode != Mode::Select) return;
+    promptBatch.clear();
+    tree.clearSelection();
+    mode = Mode::Normal;
+}
+
+// One undo record for a whole batch; a single step is pushed as is. The oldest record drops
+// off past kMaxUndo, and whatever it had trashed is purged for good.
+void FileManager::pushUndo(std::vector<Undo> steps) {
+    if (steps.empty()) return;
+    if (steps.size() == 1) {
+        undoStack.push_back(std::move(steps.front()));
+    } else {
+        Undo group{steps.front().type, {}, {}};
+        group.batch = std::move(steps);
+        undoStack.push_back(std::move(group));
+    }
+    while (undoStack.size() > kMaxUndo) {
+        const Undo &oldest = undoStack.front();
+        std::vector<fs::path> trashed;
+        for (const Undo &step : oldest.batch.empty() ? std::vector<Undo>{oldest} : oldest.batch)
+            if (step.type == Prompt::Delete) trashed.push_back(step.target);
+        journal.purge(std::move(trashed));
+        undoStack.pop_front();
+    }
+    saveUndo();
+}
+
+namespace {
+const std::pair<FileManager::Prompt, const char *> kUndoTypes[] = {
+    {FileManager::Prompt::Rename, "rename"},   {FileManager::Prompt::Move, "move"},
+    {FileManager::Prompt::Delete, "delete"},   {FileManager::Prompt::NewFile, "newfile"},
+    {FileManager::Prompt::NewDir, "newdir"},
+};
+} // namespace
+
+void FileManager::saveUndo() {
+    std::vector<UndoJournal::Record> records;
+    auto add = [&](const Undo &action) {
+        UndoJournal::Record record;
+        for (const Undo &step : action.batch.empty() ? std::vector<Undo>{action} : action.batch)
+            for (const auto &[type, name] : kUndoTypes)
+                if (type == step.type) record.push_back({name, step.source, step.target});
+        records.push_back(std::move(record));
+    };
+    for (const Undo &action : undoStack) add(action);
+    for (const auto &[job, action] : undoing) add(action); // not undone until their job is
+    journal.save(std::move(records));
+}
+
+void FileManager::loadUndo() {
+    std::string appData = getAppDataDir();
+    if (appData.empty()) return;
+    for (const auto &record : journal.open(fs::path(appData) / "undo.json")) {
+        std::vector<Undo> steps;
+        for (const auto &step : record)
+            for (const auto &[type, name] : kUndoTypes)
+                if (step.type == name) steps.push_back(Undo{type, step.source, step.target});
+        if (steps.empty()) continue;
+        Undo action = steps.size() == 1 ? steps.front() : Undo{steps.front().type, {}, {}};
+        if (steps.size() > 1) action.batch = std::move(steps);
+        undoStack.push_back(std::move(action));
+    }
+}
+
+// Selected paths, minus those inside another selected directory.
+std::vector<fs::path> FileManager::selectionPaths() const {
+    std::vector<fs::path> paths;
+    for (Tree::NodeId id : tree.selection()) paths.push_back(tree.path(id));
+    std::sort(paths.begin(), paths.end());
+    std::vector<fs::path> top;
+    for (auto &p : paths) {
+        bool nested = !top.empty() && std::mismatch(top.back().begin(), top.back().end(),
+                                                    p.begin(), p.end())
+                                              .first == top.back().end();
+        if (!nested) top.push_back(std::move(p));
+    }
+    return top;
+}
+
+// Keeps the UI copy of the job list in sync; finished and cancelled jobs drop out, failed
+// ones stay until cleared from the jobs overlay.
+void FileManager::updateJob(const JobQueue::Status &status) {
+    auto it = std::find_if(jobList.begin(), jobList.end(),
+                           [&](const auto &job) { return job.id == status.id; });
+    bool gone = status.state == JobQueue::State::Done ||
+                status.state == JobQueue::State::Cancelled;
+    if (it == jobList.end()) {
+        if (!gone) jobList.push_back(status);
+    } else if (gone) {
+        jobList.erase(it);
+    } else {
+        *it = status;
+    }
+    if (!jobList.empty()) selJobIdx = std::min(selJobIdx, jobList.size() - 1);
+}
+
 int FileManager::maxExpandedDepth() const {
     int maxDepth = 0;
     for (auto &entry : entries) {
-        if (fs::is_directory(entry.path) && expandedDirs.count(entry.path)) {
+        if (tree.isDir(entry.node) && tree.expanded(entry.node)) {
             maxDepth = std::max(maxDepth, entry.depth);
         }
     }
     return maxDepth;
 }
 
+// Undoes the newest record in the background. The record stays journaled until the job is
+// done; whatever could not be undone then goes back on the stack.
 void FileManager::undo() {
     if (undoStack.empty()) return;
 
-    Undo action = undoStack.top();
-    undoStack.pop();
+    Undo action = std::move(undoStack.back());
+    undoStack.pop_back();
 
-    switch (action.type) {
-    case Prompt::Rename:
-        fs::rename(action.target, action.source);
-        break;
-    case Prompt::Move:
-        fs::rename(action.target, action.source);
-        break;
-    case Prompt::Delete:
-        if (action.contents) {
-            std::ofstream out(action.source, std::ios::binary);
-            out << *action.contents;
-            out.close();
-        }
-        break;
-    case Prompt::NewFile:
-        deleteFilOrDir(action.source);
-        break;
-    case Prompt::NewDir:
-        deleteFilOrDir(action.source);
-        break;
-    // case Prompt::Cut:
-    // case Prompt::Copy:
-    default:
-        break;
+    std::vector<Undo> steps = action.batch.empty() ? std::vector<Undo>{action} : action.batch;
+    std::vector<fs::path> paths;
+    for (const auto &step : steps) paths.insert(paths.end(), {step.source, step.target});
+
+    auto job = std::make_shared<uint64_t>(0);
+    *job = jobs.submit(
+        batchTitle("Undo", paths), lockPaths(paths),
+        [this, steps, job](std::stop_token stop, const JobQueue::Report &report) {
+            std::vector<std::vector<FsChange>> changes(steps.size());
+            std::vector<char> undone(steps.size());
+            auto errors = runBatch(
+                steps.size(), stop, report, [&](size_t i, const JobQueue::Report &itemReport) {
+                    const Undo &step = steps[i];
+                    switch (step.type) {
+                    case Prompt::Rename:
+                    case Prompt::Move:
+                        if (!movePath(step.target, step.source, stop, itemReport)) return;
+                        changes[i] = {{FsChange::Kind::Removed, step.target},
+                                      {FsChange::Kind::Created, step.source}};
+                        break;
+                    case Prompt::Delete:
+                        Trash::restore(step.target, step.source);
+                        changes[i] = {{FsChange::Kind::Created, step.source}};
+                        break;
+                    case Prompt::NewFile:
+                    case Prompt::NewDir:
+                        deleteFilOrDir(step.source);
+                        changes[i] = {{FsChange::Kind::Removed, step.source}};
+                        break;
+                    // case Prompt::Cut:
+                    // case Prompt::Copy:
+                    default:
+                        break;
+                    }
+                    undone[i] = true;
+                });
+            std::vector<FsChange> all;
+            std::vector<Undo> left;
+            for (size_t i = 0; i < steps.size(); ++i) {
+                all.insert(all.end(), changes[i].begin(), changes[i].end());
+                if (!undone[i]) left.push_back(steps[i]);
+            }
+            return batchDone(errors, [this, job, all, left] {
+                finishUndo(*job, left);
+                applyChanges(all);
+            });
+        });
+    undoing.emplace(*job, std::move(action));
+}
+
+// Settles the record of an undo job: the steps `left` over go back on the stack, or the whole
+// record if the job never got to run.
+void FileManager::finishUndo(uint64_t job, std::optional<std::vector<Undo>> left) {
+    auto it = undoing.find(job);
+    if (it == undoing.end()) return;
+    Undo action = std::move(it->second);
+    undoing.erase(it);
+    if (!left) {
+        undoStack.push_back(std::move(action));
+        saveUndo();
+    } else if (!left->empty()) {
+        pushUndo(std::move(*left));
+    } else {
+        saveUndo();
     }
-    refresh();
 }
 
 std::vector<fs::path> FileManager::entriesPaths() const {
     std::vector<fs::path> paths;
-    for (auto &e : entries) paths.push_back(e.path);
+    for (auto &e : entries) paths.push_back(tree.path(e.node));
     return paths;
 }
 
-void FileManager::updateSelEntryPath() { selEntryPath = entries[selIdx].path; }
+void FileManager::updateSelEntryPath() {
+    selEntryPath = entryPath(selIdx);
+    requestPreview();
+}
+
+void FileManager::togglePreview() {
+    showPreview = !showPreview;
+    preview.reset();
+    if (showPreview)
+        requestPreview();
+    else
+        previewer.cancel();
+}
+
+// Shows the cached preview of the selection at once, or has one built in the background;
+// either way a preview still being built for an earlier selection is abandoned.
+void FileManager::requestPreview() {
+    if (!showPreview) return;
+    if (preview && preview->path == selEntryPath) return;
+    if (entries.empty() || selEntryPath.empty()) {
+        preview.reset();
+        previewer.cancel();
+        return;
+    }
+    preview = previewer.request(selEntryPath, tree.meta(entries[selIdx].node));
+}
@@ -0,0 +1,482 @@
+#include "Fuzzy.hpp"
+#include "DirScanner.hpp"
+#include "PathIndex.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FUZZY_SSE2 1
+#endif
+
+namespace {
+constexpr char kSep = static_cast<char>(fs::path::preferred_separator);
+constexpr auto kRematchInterval = std::chrono::milliseconds(50);
+constexpr size_t kIndexBatch = 4096;
+
+// Scoring, loosely after fzf: every matched char scores, gaps cost, and matches at word
+// boundaries, in runs, or inside the file name earn bonuses.
+constexpr int kMatch = 16;
+constexpr int kGapStart = 3;
+constexpr int kGapExtend = 1;
+constexpr int kBonusSeparator = 10;
+constexpr int kBonusDelimiter = 8;
+constexpr int kBonusCamel = 7;
+constexpr int kBonusConsecutive = 4;
+constexpr int kBonusName = 2;
+
+inline char fold(char c) { return c >= 'A' && c <= 'Z' ? c | 0x20 : c; }
+
+// One bit per letter/digit, a few shared bits for everything else; a candidate can only
+// match when its mask covers the query's.
+inline uint64_t charBit(char c) {
+    c = fold(c);
+    if (c >= 'a' && c <= 'z') return 1ull << (c - 'a');
+    if (c >= '0' && c <= '9') return 1ull << (26 + c - '0');
+    if (static_cast<unsigned char>(c) >= 0x80) return 1ull << 63;
+    return 1ull << (36 + c % 27);
+}
+
+uint64_t maskOf(std::string_view s) {
+    uint64_t m = 0;
+    for (char c : s)
+        if (c != ' ') m |= charBit(c);
+    return m;
+}
+
+// Index of the first char at or after `from` that case-folds to `c` (already folded).
+size_t findFolded(std::string_view s, size_t from, char c) {
+#ifdef FUZZY_SSE2
+    const __m128i needle = _mm_set1_epi8(c);
+    const __m128i belowA = _mm_set1_epi8('A' - 1);
+    const __m128i aboveZ = _mm_set1_epi8('Z' + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    for (; from + 16 <= s.size(); from += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s.data() + from));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x, belowA), _mm_cmplt_epi8(x, aboveZ));
+        x = _mm_or_si128(x, _mm_and_si128(upper, caseBit));
+        unsigned hits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, needle)));
+        if (hits) return from + std::countr_zero(hits);
+    }
+#endif
+    for (; from < s.size(); ++from)
+        if (fold(s[from]) == c) return from;
+    return std::string_view::npos;
+}
+
+int boundaryBonus(std::string_view s, size_t i) {
+    if (i == 0) return kBonusSeparator;
+    char prev = s[i - 1], cur = s[i];
+    if (prev == '/' || prev == '\\') return kBonusSeparator;
+    if (prev == '_' || prev == '-' || prev == '.' || prev == ' ') return kBonusDelimiter;
+    if (prev >= 'a' && prev <= 'z' && cur >= 'A' && cur <= 'Z') return kBonusCamel;
+    return 0;
+}
+
+// `term` is folded and non-empty.
+int scoreTerm(std::string_view s, size_t nameStart, std::string_view term,
+              std::vector<uint16_t> *positions) {
+    // Forward: the earliest end of any match.
+    size_t end = 0;
+    for (char c : term) {
+        end = findFolded(s, end, c);
+        if (end == std::string_view::npos) return 0;
+        ++end;
+    }
+    // Backward: the latest start that still matches, giving the tightest window.
+    size_t start = end;
+    for (size_t k = term.size(); k > 0;)
+        if (fold(s[--start]) == term[k - 1]) --k;
+
+    int score = 0;
+    bool inGap = false, prevMatched = false;
+    size_t t = 0;
+    for (size_t i = start; i < end && t < term.size(); ++i) {
+        if (fold(s[i]) != term[t]) {
+            score -= inGap ? kGapExtend : kGapStart;
+            inGap = true;
+            prevMatched = false;
+            continue;
+        }
+        int bonus = std::max(boundaryBonus(s, i), prevMatched ? kBonusConsecutive : 0);
+        score += kMatch + bonus + (i >= nameStart ? kBonusName : 0);
+        if (positions) positions->push_back(static_cast<uint16_t>(i));
+        inGap = false;
+        prevMatched = true;
+        ++t;
+    }
+    return std::max(score, 1);
+}
+
+std::vector<std::string> splitQuery(std::string_view query) {
+    std::vector<std::string> terms;
+    size_t i = 0;
+    while (i < query.size()) {
+        size_t j = query.find(' ', i);
+        if (j == std::string_view::npos) j = query.size();
+        if (j > i) {
+            std::string term(query.substr(i, j - i));
+            std::transform(term.begin(), term.end(), term.begin(), fold);
+            terms.push_back(std::move(term));
+        }
+        i = j + 1;
+    }
+    return terms;
+}
+
+int scoreTerms(std::string_view s, size_t nameStart, const std::vector<std::string> &terms,
+               std::vector<uint16_t> *positions) {
+    int total = 0;
+    for (const auto &term : terms) {
+        int sc = scoreTerm(s, nameStart, term, positions);
+        if (sc == 0) return 0;
+        total += sc;
+    }
+    return total;
+}
+
+bool better(const FuzzyFinder::Match &a, const FuzzyFinder::Match &b) {
+    if (a.score != b.score) return a.score > b.score;
+    if (a.len != b.len) return a.len < b.len;
+    return a.id < b.id;
+}
+
+void keepBest(std::vector<FuzzyFinder::Match> &v, size_t n) {
+    if (v.size() <= n) return;
+    std::nth_element(v.begin(), v.begin() + n, v.end(), better);
+    v.resize(n);
+}
+} // namespace
+
+// --- Candidate store ---
+struct FuzzyFinder::Chunk {
+    static constexpr uint32_t kItems = 4096;
+    static constexpr uint32_t kBytes = 256 << 10;
+
+    std::unique_ptr<char[]> bytes{new char[kBytes]};
+    uint32_t used = 0;
+    uint32_t count = 0;
+    uint32_t off[kItems];
+    uint16_t len[kItems];
+    uint16_t nameStart[kItems];
+    uint64_t mask[kItems];
+
+    std::string_view text(uint32_t i) const { return {bytes.get() + off[i], len[i]}; }
+};
+
+// Appended to by the walker, read by the matcher and the UI. Items below a chunk's count
+// are immutable once published, so readers only hold the mutex to snapshot counts.
+struct FuzzyFinder::Store {
+    fs::path root;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    bool done = false;
+
+    void append(const std::vector<std::string> &paths) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &p : paths) {
+            if (p.size() > UINT16_MAX) continue;
+            if (chunks.empty() || chunks.back()->count == Chunk::kItems ||
+                chunks.back()->used + p.size() > Chunk::kBytes)
+                chunks.push_back(std::make_unique<Chunk>());
+            Chunk &c = *chunks.back();
+            uint32_t i = c.count++;
+            std::copy(p.begin(), p.end(), c.bytes.get() + c.used);
+            c.off[i] = c.used;
+            c.len[i] = static_cast<uint16_t>(p.size());
+            size_t sep = p.rfind(kSep);
+            c.nameStart[i] = static_cast<uint16_t>(sep == std::string::npos ? 0 : sep + 1);
+            c.mask[i] = maskOf(p);
+            c.used += static_cast<uint32_t>(p.size());
+        }
+    }
+};
+
+// What the matcher remembers between passes so that typing more characters only re-tests
+// the previous hits and new candidates only get scored once.
+struct FuzzyFinder::MatchState {
+    // Held, not just pointed at, so a new store can never reuse the address of this one.
+    std::shared_ptr<const Store> store;
+    std::string query;
+    std::vector<uint32_t> scanned;           // per chunk: items tested so far
+    std::vector<std::vector<uint16_t>> hits; // per chunk: matching items
+    std::vector<std::vector<Match>> best;    // per chunk: top kMaxResults
+};
+
+// --- FuzzyFinder ---
+FuzzyFinder::FuzzyFinder(Callback callback) : _callback(std::move(callback)) {
+    _matcher = std::jthread([this](std::stop_token stop) { matchLoop(stop); });
+}
+
+FuzzyFinder::~FuzzyFinder() { _walker = std::jthread(); }
+
+void FuzzyFinder::open(const fs::path &root, bool dirsOnly,
+                       std::shared_ptr<const PathIndex> index) {
+    close();
+    auto store = std::make_shared<Store>();
+    store->root = root;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _store = store;
+        _query.clear();
+        ++_gen;
+    }
+    _cv.notify_one();
+    _walker = std::jthread([this, store, dirsOnly, index](std::stop_token stop) {
+        if (index)
+            readIndex(stop, store, dirsOnly, *index);
+        else
+            walk(stop, store, dirsOnly);
+    });
+}
+
+void FuzzyFinder::close() {
+    _walker = std::jthread(); // requests stop and joins
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _store.reset();
+        _query.clear();
+        ++_gen;
+    }
+    _cv.notify_one();
+}
+
+void FuzzyFinder::setQuery(std::string query) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _query = std::move(query);
+        ++_gen;
+    }
+    _cv.notify_one();
+}
+
+fs::path FuzzyFinder::root() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _store ? _store->root : fs::path();
+}
+
+std::string FuzzyFinder::text(uint32_t id) const {
+    std::shared_ptr<Store> store;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        store = _store;
+    }
+    if (!store) return {};
+    std::lock_guard<std::mutex> lock(store->mutex);
+    size_t c = id / Chunk::kItems;
+    uint32_t i = id % Chunk::kItems;
+    if (c >= store->chunks.size() || i >= store->chunks[c]->count) return {};
+    return std::string(store->chunks[c]->text(i));
+}
+
+int FuzzyFinder::score(std::string_view text, size_t nameStart, std::string_view query,
+                       std::vector<uint16_t> *positions) {
+    return scoreTerms(text, nameStart, splitQuery(query), positions);
+}
+
+std::vector<uint16_t> FuzzyFinder::highlight(std::string_view text, std::string_view query) {
+    std::vector<uint16_t> positions;
+    size_t sep = text.rfind(kSep);
+    score(text, sep == std::string_view::npos ? 0 : sep + 1, query, &positions);
+    std::sort(positions.begin(), positions.end());
+    return positions;
+}
+
+void FuzzyFinder::notifyData() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_dataVersion;
+    }
+    _cv.notify_one();
+}
+
+// Recursive walk, one pool task per directory. Symlinked directories are listed but not
+// followed, and VCS/dependency directories are skipped.
+void FuzzyFinder::walk(std::stop_token stop, std::shared_ptr<Store> store, bool dirsOnly) {
+    TaskGroup group;
+    std::function<void(const fs::path &, const std::string &)> visit =
+        [&](const fs::path &dir, const std::string &rel) {
+            std::vector<std::string> found;
+            std::error_code ec;
+            DirScanner scanner(dir, 0, ec);
+            for (DirScanner::Entry e; scanner.next(e);) {
+                if (stop.stop_requested()) return;
+                std::string name(e.name);
+                std::string childRel = rel.empty() ? name : rel + kSep + name;
+                bool isDir = e.meta.isDir;
+                if (isDir && e.meta.type != fs::file_type::symlink && !PathIndex::skipped(name))
+                    group.run([&visit, p = dir / name, childRel] { visit(p, childRel); });
+                if (isDir == dirsOnly) found.push_back(std::move(childRel));
+            }
+            if (found.empty()) return;
+            store->append(found);
+            notifyData();
+        };
+
+    group.run([&] { visit(store->root, ""); });
+    try {
+        group.wait();
+    } catch (const std::exception &) {} // unreadable entries are skipped, not fatal
+    if (stop.stop_requested()) return;
+    {
+        std::lock_guard<std::mutex> lock(store->mutex);
+        store->done = true;
+    }
+    notifyData();
+}
+
+// Same candidates as walk(), but read from a prebuilt index without touching the disk.
+void FuzzyFinder::readIndex(std::stop_token stop, std::shared_ptr<Store> store, bool dirsOnly,
+                            const PathIndex &index) {
+    auto node = index.find(store->root.lexically_relative(index.root()));
+    std::vector<std::string> batch;
+    auto flush = [&] {
+        store->append(batch);
+        batch.clear();
+        notifyData();
+    };
+    if (node) {
+        index.forEach(*node, dirsOnly, [&](const std::string &rel) {
+            batch.push_back(rel);
+            if (batch.size() >= kIndexBatch) flush();
+            return !stop.stop_requested();
+        });
+    }
+    if (stop.stop_requested()) return;
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(store->mutex);
+        store->done = true;
+    }
+    notifyData();
+}
+
+void FuzzyFinder::matchLoop(std::stop_token stop) {
+    MatchState state;
+    uint64_t seenGen = 0, seenData = 0;
+    while (true) {
+        std::shared_ptr<Store> store;
+        std::string query;
+        uint64_t gen;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto changed = [&] { return _gen.load() != seenGen || _dataVersion != seenData; };
+            if (!_cv.wait(lock, stop, changed)) return;
+            // Only new candidates: let a few more batches pile up before re-ranking.
+            if (_gen.load() == seenGen)
+                _cv.wait_for(lock, stop, kRematchInterval, [&] { return _gen.load() != seenGen; });
+            if (stop.stop_requested()) return;
+            store = _store;
+            query = _query;
+            gen = seenGen = _gen.load();
+            seenData = _dataVersion;
+        }
+        if (!store) {
+            state = MatchState();
+            continue;
+        }
+
+        Results results;
+        if (!match(store, query, gen, state, results)) {
+            state = MatchState(); // interrupted mid-pass; start over on the next one
+            continue;
+        }
+        _callback(std::move(results));
+    }
+}
+
+// One ranking pass. Returns false if a newer query arrived before it finished.
+bool FuzzyFinder::match(const std::shared_ptr<Store> &storePtr, const std::string &query,
+                        uint64_t gen, MatchState &state, Results &out) {
+    Store &store = *storePtr;
+    std::vector<Chunk *> chunks;
+    std::vector<uint32_t> counts;
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(store.mutex);
+        for (auto &c : store.chunks) {
+            chunks.push_back(c.get());
+            counts.push_back(c->count);
+        }
+        done = store.done;
+    }
+
+    bool sameStore = state.store == storePtr;
+    bool same = sameStore && query == state.query;
+    bool narrowing = sameStore && !state.query.empty() && query.starts_with(state.query);
+    if (!same && !narrowing) {
+        state.scanned.clear();
+        state.hits.clear();
+        state.best.clear();
+    }
+    state.store = storePtr;
+    state.query = query;
+    state.scanned.resize(chunks.size());
+    state.hits.resize(chunks.size());
+    state.best.resize(chunks.size());
+
+    std::vector<std::string> terms = splitQuery(query);
+    uint64_t qmask = maskOf(query);
+    bool all = terms.empty();
+    std::atomic<bool> interrupted{false};
+
+    TaskGroup group;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        if (same && state.scanned[c] == counts[c]) continue;
+        group.run([&, c] {
+            const Chunk &chunk = *chunks[c];
+            std::vector<uint16_t> &hits = state.hits[c];
+            std::vector<Match> &best = state.best[c];
+            auto test = [&](uint32_t i) {
+                int sc = 0;
+                if (!all) {
+                    if ((chunk.mask[i] & qmask) != qmask) return;
+                    sc = scoreTerms(chunk.text(i), chunk.nameStart[i], terms, nullptr);
+                    if (sc == 0) return;
+                    hits.push_back(static_cast<uint16_t>(i));
+                } else if (best.size() >= kMaxResults) {
+                    return; // empty query: keep walk order
+                }
+                best.push_back({static_cast<uint32_t>(c * Chunk::kItems + i), sc, chunk.len[i]});
+                if (best.size() >= 2 * kMaxResults) keepBest(best, kMaxResults);
+            };
+
+            if (!same) { // narrowing: only the previous hits can still match
+                std::vector<uint16_t> previous;
+                previous.swap(hits);
+                best.clear();
+                for (uint16_t i : previous) test(i);
+            }
+            for (uint32_t i = state.scanned[c]; i < counts[c]; ++i) {
+                if ((i & 1023) == 0 && _gen.load() != gen) {
+                    interrupted = true;
+                    return;
+                }
+                test(i);
+            }
+            state.scanned[c] = counts[c];
+            keepBest(best, kMaxResults);
+        });
+    }
+    group.wait();
+    if (interrupted) return false;
+
+    out.gen = gen;
+    out.done = done;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        out.total += counts[c];
+        out.matched += all ? counts[c] : state.hits[c].size();
+        out.top.insert(out.top.end(), state.best[c].begin(), state.best[c].end());
+    }
+    if (all) {
+        out.top.resize(std::min(out.top.size(), kMaxResults));
+    } else {
+        size_t n = std::min(out.top.size(), kMaxResults);
+        std::partial_sort(out.top.begin(), out.top.begin() + n, out.top.end(), better);
+        out.top.resize(n);
+    }
+    return true;
+}
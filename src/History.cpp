@@ -0,0 +1,167 @@
+#include "History.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr size_t kSlackLines = 256;
+
+int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Advisory lock on a file of its own, held for the object's lifetime: shared by appenders,
+// exclusive for compaction. False if the lock file cannot be opened.
+class FileLock {
+  public:
+    FileLock(const fs::path &path, bool exclusive) {
+#ifdef _WIN32
+        _handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (_handle == INVALID_HANDLE_VALUE) return;
+        OVERLAPPED at = {};
+        if (!LockFileEx(_handle, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, MAXDWORD,
+                        MAXDWORD, &at)) {
+            CloseHandle(_handle);
+            _handle = INVALID_HANDLE_VALUE;
+        }
+#else
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (_fd >= 0 && ::flock(_fd, exclusive ? LOCK_EX : LOCK_SH) != 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+#endif
+    }
+    ~FileLock() {
+#ifdef _WIN32
+        if (_handle != INVALID_HANDLE_VALUE) CloseHandle(_handle); // releases the lock
+#else
+        if (_fd >= 0) ::close(_fd);
+#endif
+    }
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+
+#ifdef _WIN32
+    explicit operator bool() const { return _handle != INVALID_HANDLE_VALUE; }
+#else
+    explicit operator bool() const { return _fd >= 0; }
+#endif
+
+  private:
+#ifdef _WIN32
+    HANDLE _handle = INVALID_HANDLE_VALUE;
+#else
+    int _fd = -1;
+#endif
+};
+} // namespace
+
+fs::path History::lockFile() const {
+    fs::path lock = _file;
+    lock += ".lock";
+    return lock;
+}
+
+// Opened in append mode, so a visit is a single write at the end whatever the log's size. The
+// shared lock only waits out a compaction; visits do not wait for each other.
+void History::visit(const fs::path &dir, double weight) const {
+    std::string path = dir.string();
+    if (path.empty() || path.find('\n') != std::string::npos) return;
+    char prefix[64];
+    int len = std::snprintf(prefix, sizeof(prefix), "%lld\t%.6g\t",
+                            static_cast<long long>(unixNow()), weight);
+    std::string line = std::string(prefix, len) + path + "\n";
+    FileLock lock(lockFile(), false);
+    if (FILE *f = std::fopen(_file.string().c_str(), "ab")) {
+        std::fwrite(line.data(), 1, line.size(), f);
+        std::fclose(f);
+    }
+}
+
+std::vector<History::Entry> History::load() const {
+    int64_t now = unixNow();
+    size_t lines = 0;
+    std::vector<Entry> entries = read(now, lines);
+    if (lines > 2 * entries.size() + kSlackLines) compact(now);
+    return entries;
+}
+
+// Every directory by descending score as of `now`; `lines` is set to the log's line count.
+std::vector<History::Entry> History::read(int64_t now, size_t &lines) const {
+    std::vector<Entry> entries;
+    lines = 0;
+    {
+        MappedFile file(_file);
+        if (!file) return entries;
+
+        const double halfLife = kHalfLifeDays * 86400;
+        std::unordered_map<std::string_view, double> scores;
+        const char *p = file.data(), *end = p + file.size();
+        while (p < end) {
+            const char *eol = std::find(p, end, '\n');
+            std::string_view line(p, eol - p);
+            p = eol + (eol < end);
+            ++lines;
+
+            size_t tab1 = line.find('\t'), tab2 = line.find('\t', tab1 + 1);
+            if (tab2 == std::string_view::npos || tab2 + 1 >= line.size()) continue;
+            long long time = 0;
+            double weight = 0;
+            if (std::from_chars(line.data(), line.data() + tab1, time).ec != std::errc() ||
+                std::from_chars(line.data() + tab1 + 1, line.data() + tab2, weight).ec !=
+                    std::errc())
+                continue;
+            double age = static_cast<double>(std::max<int64_t>(now - time, 0));
+            scores[line.substr(tab2 + 1)] += weight * std::exp2(-age / halfLife);
+        }
+
+        entries.reserve(scores.size());
+        for (const auto &[dir, score] : scores) entries.push_back({fs::path(dir), score});
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.score != b.score ? a.score > b.score : a.dir < b.dir;
+    });
+    return entries;
+}
+
+// Re-reads the log under the exclusive lock, so visits appended since load() read it are kept,
+// then writes it next to the log and renames it over, so readers never see a partial file.
+void History::compact(int64_t now) const {
+    FileLock lock(lockFile(), true);
+    if (!lock) return;
+    size_t lines = 0;
+    std::vector<Entry> entries = read(now, lines);
+    std::erase_if(entries, [](const Entry &e) { return e.score < kMinScore; });
+
+    fs::path tmp = _file;
+    tmp += ".tmp";
+    FILE *f = std::fopen(tmp.string().c_str(), "wb");
+    if (!f) return;
+    for (const auto &e : entries)
+        std::fprintf(f, "%lld\t%.6g\t%s\n", static_cast<long long>(now), e.score,
+                     e.dir.string().c_str());
+    bool ok = std::fclose(f) == 0;
+    std::error_code ec;
+    if (ok) fs::rename(tmp, _file, ec);
+    if (!ok || ec) fs::remove(tmp, ec);
+}
@@ -0,0 +1,125 @@
+#include "JobQueue.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+
+JobQueue::JobQueue(Callback callback, unsigned workers) : _callback(std::move(callback)) {
+    for (unsigned i = 0; i < std::max(1u, workers); ++i)
+        _workers.emplace_back([this](std::stop_token stop) { workerLoop(stop); });
+}
+
+JobQueue::~JobQueue() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queued.clear();
+        for (auto &job : _running) job->stop.request_stop();
+    }
+    _workers.clear(); // joins
+}
+
+uint64_t JobQueue::submit(std::string title, std::vector<fs::path> paths, Work work) {
+    auto job = std::make_shared<Job>();
+    job->title = std::move(title);
+    std::erase_if(paths, [](const fs::path &p) { return p.empty(); });
+    // A trailing separator leaves an empty last element that no descendant would share.
+    for (auto &p : paths)
+        if (!p.has_filename() && p.has_relative_path()) p = p.parent_path();
+    job->paths = std::move(paths);
+    job->work = std::move(work);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        job->id = _nextId++;
+        _queued.push_back(job);
+    }
+    _callback({job->id, job->title, State::Queued, {}, {}}, nullptr);
+    _cv.notify_all();
+    return job->id;
+}
+
+void JobQueue::cancel(uint64_t id) {
+    std::shared_ptr<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = std::find_if(_queued.begin(), _queued.end(),
+                               [&](const auto &job) { return job->id == id; });
+        if (it != _queued.end()) {
+            dropped = *it;
+            _queued.erase(it);
+        }
+        for (auto &job : _running)
+            if (job->id == id) job->stop.request_stop();
+    }
+    if (dropped) {
+        _callback({dropped->id, dropped->title, State::Cancelled, {}, {}}, nullptr);
+        _cv.notify_all(); // jobs waiting on it may start now
+    }
+}
+
+bool JobQueue::overlaps(const Job &a, const Job &b) {
+    for (const auto &p : a.paths)
+        for (const auto &q : b.paths) {
+            auto [pi, qi] = std::mismatch(p.begin(), p.end(), q.begin(), q.end());
+            if (pi == p.end() || qi == q.end()) return true;
+        }
+    return false;
+}
+
+// First queued job that conflicts with neither a running job nor an earlier queued one.
+// Called with _mutex held.
+std::shared_ptr<JobQueue::Job> JobQueue::takeRunnable() {
+    for (auto it = _queued.begin(); it != _queued.end(); ++it) {
+        auto conflicts = [&](const std::shared_ptr<Job> &other) { return overlaps(**it, *other); };
+        if (std::any_of(_running.begin(), _running.end(), conflicts) ||
+            std::any_of(_queued.begin(), it, conflicts))
+            continue;
+        std::shared_ptr<Job> job = *it;
+        _queued.erase(it);
+        _running.push_back(job);
+        return job;
+    }
+    return nullptr;
+}
+
+void JobQueue::workerLoop(std::stop_token stop) {
+    Trace::setThreadName("job worker");
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_cv.wait(lock, stop, [&] { return (job = takeRunnable()) != nullptr; })) return;
+        }
+
+        Status status{job->id, job->title, State::Running, {}, {}};
+        _callback(status, nullptr);
+
+        auto lastReport = std::chrono::steady_clock::now();
+        Report report = [&](Progress progress) {
+            status.progress = std::move(progress);
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastReport < kReportInterval) return;
+            lastReport = now;
+            _callback(status, nullptr);
+        };
+
+        Completion done;
+        TraceSpan span("job", job->title);
+        try {
+            done = job->work(job->stop.get_token(), report);
+            status.state = job->stop.stop_requested() ? State::Cancelled : State::Done;
+        } catch (const PartialFailure &ex) {
+            status.state = State::Failed;
+            status.error = ex.what();
+            done = ex.done;
+        } catch (const std::exception &ex) {
+            status.state = State::Failed;
+            status.error = ex.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::erase(_running, job);
+        }
+        _cv.notify_all();
+        _callback(status, std::move(done));
+    }
+}
@@ -0,0 +1,169 @@
+#include "Jump.hpp"
+#include "Fuzzy.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <numeric>
+#include <optional>
+
+namespace {
+char fold(char c) { return c >= 'A' && c <= 'Z' ? c | 0x20 : c; }
+
+// One bit per character modulo 64: a text can only contain a query whose bits it has.
+uint64_t charMask(std::string_view s) {
+    uint64_t mask = 0;
+    for (char c : s)
+        if (c != ' ') mask |= uint64_t(1) << (static_cast<unsigned char>(c) & 63);
+    return mask;
+}
+
+std::vector<std::string> keywords(std::string_view query) {
+    std::vector<std::string> out;
+    size_t i = 0;
+    while (i < query.size()) {
+        size_t end = query.find(' ', i);
+        if (end == std::string_view::npos) end = query.size();
+        if (end > i) {
+            std::string k(query.substr(i, end - i));
+            std::transform(k.begin(), k.end(), k.begin(), fold);
+            out.push_back(std::move(k));
+        }
+        i = end + 1;
+    }
+    return out;
+}
+
+bool matchesInOrder(std::string_view text, const std::vector<std::string> &keys) {
+    size_t pos = 0;
+    for (const auto &k : keys) {
+        size_t at = text.find(k, pos);
+        if (at == std::string_view::npos) return false;
+        pos = at + k.size();
+    }
+    return true;
+}
+
+// `dir` relative to cwd when below it, else relative to the home directory ("~/..."),
+// else absolute. Purely lexical, so it costs no system calls.
+std::string displayPath(const fs::path &dir, const fs::path &cwd, const fs::path &home) {
+    auto under = [](const fs::path &p, const fs::path &base) {
+        auto [pi, bi] = std::mismatch(p.begin(), p.end(), base.begin(), base.end());
+        return bi == base.end() && pi != p.end() ? std::optional(p.lexically_relative(base))
+                                                 : std::nullopt;
+    };
+    if (auto rel = under(dir, cwd)) return rel->string();
+    if (!home.empty())
+        if (auto rel = under(dir, home)) return (fs::path("~") / *rel).string();
+    return dir.string();
+}
+} // namespace
+
+void JumpList::load(std::vector<History::Entry> entries, const fs::path &cwd) {
+#ifdef _WIN32
+    const char *homeEnv = std::getenv("USERPROFILE");
+#else
+    const char *homeEnv = std::getenv("HOME");
+#endif
+    fs::path home = homeEnv ? fs::path(homeEnv) : fs::path();
+
+    _dirs.clear();
+    _display.clear();
+    _text.clear();
+    _offset.assign(1, 0);
+    _nameStart.clear();
+    _mask.clear();
+    _score.clear();
+    for (auto &e : entries) {
+        std::string lower = e.dir.string();
+        std::transform(lower.begin(), lower.end(), lower.begin(), fold);
+        size_t sep = lower.find_last_of("/\\", lower.size() > 1 ? lower.size() - 2 : 0);
+        _nameStart.push_back(sep == std::string::npos ? 0 : static_cast<uint32_t>(sep + 1));
+        _mask.push_back(charMask(lower));
+        _display.push_back(displayPath(e.dir, cwd, home));
+        _text += lower;
+        _offset.push_back(static_cast<uint32_t>(_text.size()));
+        _score.push_back(e.score);
+        _dirs.push_back(std::move(e.dir));
+    }
+
+    _query.clear();
+    _hits.resize(_dirs.size());
+    std::iota(_hits.begin(), _hits.end(), 0);
+    _results.assign(_hits.begin(), _hits.begin() + std::min(_hits.size(), kMaxResults));
+    _matched = _hits.size();
+}
+
+// Ids of every path containing `key`, from one search over the concatenated paths rather
+// than one per path.
+std::vector<uint32_t> JumpList::containing(std::string_view key) const {
+    std::vector<uint32_t> ids;
+    if (key.empty()) {
+        ids.resize(_dirs.size());
+        std::iota(ids.begin(), ids.end(), 0);
+        return ids;
+    }
+    std::boyer_moore_horspool_searcher searcher(key.begin(), key.end());
+    auto it = _text.begin();
+    uint32_t id = 0;
+    while (true) {
+        it = std::search(it, _text.end(), searcher);
+        if (it == _text.end()) break;
+        size_t at = it - _text.begin();
+        while (_offset[id + 1] <= at) ++id;
+        if (at + key.size() <= _offset[id + 1]) { // not straddling two paths
+            ids.push_back(id);
+            it = _text.begin() + _offset[++id];
+        } else {
+            ++it;
+        }
+    }
+    return ids;
+}
+
+void JumpList::setQuery(std::string_view query) {
+    bool narrowing = query.size() >= _query.size() && query.substr(0, _query.size()) == _query;
+    _query = query;
+    std::vector<std::string> keys = keywords(query);
+    uint64_t mask = 0;
+    for (const auto &k : keys) mask |= charMask(k);
+
+    std::vector<uint32_t> all;
+    if (!narrowing) all = containing(keys.empty() ? std::string_view() : keys.front());
+    const std::vector<uint32_t> &candidates = narrowing ? _hits : all;
+
+    // Ids stay in load() order, which is by frecency, so a stable partition by tier keeps
+    // each tier ranked.
+    std::vector<uint32_t> hits, strong, weak;
+    for (uint32_t id : candidates) {
+        if ((_mask[id] & mask) != mask) continue;
+        std::string_view path = folded(id);
+        if (!matchesInOrder(path, keys)) continue;
+        hits.push_back(id);
+        if (strong.size() == kMaxResults) continue; // weak results can no longer show
+        bool inName = keys.empty() ||
+                      path.substr(_nameStart[id]).find(keys.back()) != std::string_view::npos;
+        auto &tier = inName ? strong : weak;
+        if (tier.size() < kMaxResults) tier.push_back(id);
+    }
+    _hits = std::move(hits);
+    _matched = _hits.size();
+
+    _results = std::move(strong);
+    _results.insert(_results.end(), weak.begin(), weak.end());
+    if (_results.empty() && !keys.empty()) {
+        // Fuzzy fallback: match quality weighted by frecency.
+        std::vector<std::pair<double, uint32_t>> ranked;
+        for (uint32_t id = 0; id < _dirs.size(); ++id) {
+            if ((_mask[id] & mask) != mask) continue;
+            int s = FuzzyFinder::score(folded(id), _nameStart[id], _query);
+            if (s > 0) ranked.emplace_back(s * (1 + _score[id]), id);
+        }
+        _matched = ranked.size();
+        size_t n = std::min(ranked.size(), kMaxResults);
+        std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end(),
+                          [](const auto &a, const auto &b) { return a.first > b.first; });
+        for (size_t i = 0; i < n; ++i) _results.push_back(ranked[i].second);
+    }
+    if (_results.size() > kMaxResults) _results.resize(kMaxResults);
+}
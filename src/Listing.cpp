@@ -0,0 +1,309 @@
+#include "Listing.hpp"
+#include "Format.hpp"
+#include "Stats.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <string>
+
+namespace {
+constexpr size_t kOutputBuffer = 1 << 16;
+#ifdef _WIN32
+constexpr char kSep = '\\';
+#else
+constexpr char kSep = '/';
+#endif
+
+// Case-folded comparison where digit runs compare by numeric value ("file2" < "file10").
+int naturalCompare(std::string_view a, std::string_view b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (std::isdigit((unsigned char)a[i]) && std::isdigit((unsigned char)b[j])) {
+            while (i < a.size() && a[i] == '0') ++i;
+            while (j < b.size() && b[j] == '0') ++j;
+            size_t ei = i, ej = j;
+            while (ei < a.size() && std::isdigit((unsigned char)a[ei])) ++ei;
+            while (ej < b.size() && std::isdigit((unsigned char)b[ej])) ++ej;
+            if (ei - i != ej - j) return ei - i < ej - j ? -1 : 1;
+            if (int c = a.substr(i, ei - i).compare(b.substr(j, ej - j))) return c;
+            i = ei;
+            j = ej;
+        } else {
+            if (a[i] != b[j]) return (unsigned char)a[i] < (unsigned char)b[j] ? -1 : 1;
+            ++i;
+            ++j;
+        }
+    }
+    return (a.size() - i > 0) - (b.size() - j > 0);
+}
+
+// Reaches the stream in kOutputBuffer-sized writes, never once per entry.
+class Output {
+  public:
+    explicit Output(std::FILE *file) : _file(file) { _buf.reserve(kOutputBuffer); }
+    ~Output() { flush(); }
+
+    void put(std::string_view s) {
+        _buf.append(s);
+        if (_buf.size() >= kOutputBuffer) write();
+    }
+    void put(char c) {
+        _buf.push_back(c);
+        if (_buf.size() >= kOutputBuffer) write();
+    }
+    void putNumber(long long n) {
+        char digits[24];
+        char *end = std::to_chars(digits, digits + sizeof(digits), n).ptr;
+        put(std::string_view(digits, end - digits));
+    }
+    void putJsonString(std::string_view s) {
+        put('"');
+        for (unsigned char c : s) {
+            if (c == '"' || c == '\\') {
+                put('\\');
+                put(static_cast<char>(c));
+            } else if (c < 0x20) {
+                char esc[8];
+                std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+                put(esc);
+            } else {
+                put(static_cast<char>(c));
+            }
+        }
+        put('"');
+    }
+
+    // Hands everything buffered to the stream and flushes it. False once a write failed.
+    bool flush() {
+        write();
+        return !_failed && std::fflush(_file) == 0;
+    }
+    bool failed() const { return _failed; }
+
+  private:
+    std::FILE *_file;
+    std::string _buf;
+    bool _failed = false;
+
+    void write() {
+        if (!_buf.empty() && std::fwrite(_buf.data(), 1, _buf.size(), _file) != _buf.size())
+            _failed = true;
+        _buf.clear();
+    }
+};
+
+class Lister {
+  public:
+    Lister(const ListOptions &options, std::FILE *out) : _options(options), _out(out) {
+        bool json = options.format == ListFormat::Json || options.format == ListFormat::Ndjson;
+        if (json || options.order.mode == SortMode::Mtime) _fields |= DirScanner::Mtime;
+    }
+
+    bool run(const fs::path &root) {
+        std::vector<Tree::Item> items = scanDir(root, _options.order, _fields); // throws
+        if (_options.format == ListFormat::Json) _out.put('[');
+        list(root, "", 1, items);
+        if (_options.format == ListFormat::Json) _out.put(_first ? "]\n" : "\n]\n");
+        return _out.flush() && _ok;
+    }
+
+  private:
+    const ListOptions &_options;
+    Output _out;
+    unsigned _fields = DirScanner::Size;
+    bool _first = true;
+    bool _ok = true;
+
+    void list(const fs::path &dir, const std::string &rel, int depth,
+              const std::vector<Tree::Item> &items) {
+        for (const auto &item : items) {
+            if (_out.failed()) return;
+            std::string path = rel.empty() ? item.name : rel + kSep + item.name;
+            write(item, path, depth);
+
+            bool descend = item.meta.isDir && item.meta.type != fs::file_type::symlink &&
+                           (_options.depth == 0 || depth < _options.depth);
+            if (!descend) continue;
+            std::vector<Tree::Item> children;
+            try {
+                children = scanDir(dir / item.name, _options.order, _fields);
+            } catch (const std::exception &ex) {
+                _out.flush(); // keeps the message next to the entries before it
+                std::fprintf(stderr, "%s\n", ex.what());
+                _ok = false;
+                continue;
+            }
+            list(dir / item.name, path, depth + 1, children);
+        }
+    }
+
+    void write(const Tree::Item &item, const std::string &path, int depth) {
+        const Tree::Meta &m = item.meta;
+        std::string_view ext = item.extPos == std::string::npos
+                                   ? std::string_view()
+                                   : std::string_view(item.name).substr(item.extPos);
+        std::string type = getFileTypeString(ext, m);
+        bool hasSize = !m.brokenLink && !m.isDir &&
+                       (m.type == fs::file_type::regular || m.type == fs::file_type::symlink);
+
+        switch (_options.format) {
+        case ListFormat::Text:
+            _out.put(type);
+            _out.put('\t');
+            if (hasSize) _out.putNumber(static_cast<long long>(m.size));
+            _out.put('\t');
+            _out.put(path);
+            _out.put('\n');
+            break;
+        case ListFormat::Null:
+            _out.put(path);
+            _out.put('\0');
+            break;
+        case ListFormat::Json:
+            _out.put(_first ? "\n" : ",\n");
+            [[fallthrough]];
+        case ListFormat::Ndjson:
+            _out.put("{\"path\":");
+            _out.putJsonString(path);
+            _out.put(",\"name\":");
+            _out.putJsonString(item.name);
+            _out.put(",\"depth\":");
+            _out.putNumber(depth);
+            _out.put(",\"type\":");
+            _out.putJsonString(type);
+            _out.put(m.isDir ? ",\"dir\":true,\"size\":" : ",\"dir\":false,\"size\":");
+            if (hasSize)
+                _out.putNumber(static_cast<long long>(m.size));
+            else
+                _out.put("null");
+            _out.put(",\"mtime\":");
+            if (m.brokenLink) {
+                _out.put("null");
+            } else {
+                auto sys = std::chrono::file_clock::to_sys(m.mtime);
+                _out.putNumber(
+                    std::chrono::duration_cast<std::chrono::seconds>(sys.time_since_epoch())
+                        .count());
+            }
+            _out.put(_options.format == ListFormat::Ndjson ? "}\n" : "}");
+            break;
+        }
+        _first = false;
+    }
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: FileManager --list [dir] [--depth N] [--json | --ndjson | -0]\n"
+                 "                          [--sort name|natural|size|mtime|ext] [--reverse]\n"
+                 "  --depth N  levels to list (default 1, 0 = unlimited)\n"
+                 "  text output: <type> TAB <size> TAB <path>, paths relative to dir\n");
+}
+} // namespace
+
+std::vector<Tree::Item> scanDir(const fs::path &path, const EntryOrder &order, unsigned fields) {
+    std::vector<Tree::Item> children;
+    {
+        ScopedTimer timer(Stats::Scan, path);
+        DirScanner scanner(path, fields);
+        for (DirScanner::Entry e; scanner.next(e);)
+            children.push_back(Tree::Item::make(std::string(e.name), e.meta));
+    }
+
+    ScopedTimer timer(Stats::Sort);
+    parallelSort(children.begin(), children.end(), order);
+    return children;
+}
+
+bool EntryOrder::less(const Tree::SortKey &a, const Tree::SortKey &b) const {
+    if (a.isDir != b.isDir) return a.isDir > b.isDir;
+
+    int c = 0;
+    switch (mode) {
+    case SortMode::Name:
+        break;
+    case SortMode::Natural:
+        c = naturalCompare(a.sortName, b.sortName);
+        break;
+    case SortMode::Size: // largest first
+        if (a.size != b.size) c = a.size > b.size ? -1 : 1;
+        break;
+    case SortMode::Mtime: // newest first
+        if (a.mtime != b.mtime) c = a.mtime > b.mtime ? -1 : 1;
+        break;
+    case SortMode::Extension:
+        c = a.ext.compare(b.ext);
+        break;
+    }
+    if (c == 0) c = a.sortName.compare(b.sortName);
+    return reversed ? c > 0 : c < 0;
+}
+
+bool EntryOrder::operator()(const Tree::Item &a, const Tree::Item &b) const {
+    auto key = [](const Tree::Item &i) {
+        std::string_view folded = i.sortName;
+        std::string_view ext = i.extPos == std::string::npos ? std::string_view{}
+                                                             : folded.substr(i.extPos);
+        return Tree::SortKey{i.meta.isDir, folded, ext, i.meta.size, i.meta.mtime};
+    };
+    return less(key(a), key(b));
+}
+
+bool writeListing(const fs::path &root, const ListOptions &options, std::FILE *out) {
+    return Lister(options, out).run(root);
+}
+
+int listCommand(const std::vector<std::string_view> &args) {
+    static const std::pair<std::string_view, SortMode> sortModes[] = {
+        {"name", SortMode::Name},   {"natural", SortMode::Natural}, {"size", SortMode::Size},
+        {"mtime", SortMode::Mtime}, {"ext", SortMode::Extension},
+    };
+    ListOptions options;
+    fs::path root = ".";
+    bool haveRoot = false;
+    for (size_t i = 0; i < args.size(); ++i) {
+        std::string_view arg = args[i];
+        bool hasValue = i + 1 < args.size();
+        if (arg == "--json") {
+            options.format = ListFormat::Json;
+        } else if (arg == "--ndjson") {
+            options.format = ListFormat::Ndjson;
+        } else if (arg == "-0") {
+            options.format = ListFormat::Null;
+        } else if (arg == "--reverse") {
+            options.order.reversed = true;
+        } else if (arg == "--depth" && hasValue) {
+            std::string_view v = args[++i];
+            auto [end, ec] = std::from_chars(v.data(), v.data() + v.size(), options.depth);
+            if (ec != std::errc() || end != v.data() + v.size() || options.depth < 0) {
+                usage();
+                return 2;
+            }
+        } else if (arg == "--sort" && hasValue) {
+            std::string_view v = args[++i];
+            auto it = std::find_if(std::begin(sortModes), std::end(sortModes),
+                                   [&](const auto &m) { return m.first == v; });
+            if (it == std::end(sortModes)) {
+                usage();
+                return 2;
+            }
+            options.order.mode = it->second;
+        } else if (!arg.starts_with("-") && !haveRoot) {
+            root = fs::path(arg);
+            haveRoot = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    try {
+        return writeListing(root, options, stdout) ? 0 : 1;
+    } catch (const std::exception &ex) {
+        std::fprintf(stderr, "%s\n", ex.what());
+        return 1;
+    }
+}
@@ -0,0 +1,96 @@
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const fs::path &path, size_t limit) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) ||
+        size.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+    }
+    size_t length = static_cast<size_t>(std::min<uint64_t>(size.QuadPart, limit));
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, length) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return;
+    }
+    _file = file;
+    _mapping = mapping;
+    _data = static_cast<const char *>(view);
+    _size = length;
+    _fileSize = static_cast<std::uintmax_t>(size.QuadPart);
+}
+
+void MappedFile::reset() {
+    if (_data) UnmapViewOfFile(_data);
+    if (_mapping) CloseHandle(_mapping);
+    if (_file) CloseHandle(_file);
+    _data = nullptr;
+    _size = 0;
+    _fileSize = 0;
+    _file = _mapping = nullptr;
+}
+
+#else
+
+// O_NONBLOCK so that a fifo (or a symlink to one) fails the S_ISREG check instead of
+// blocking open() until a writer turns up; mmap does not care about the flag.
+MappedFile::MappedFile(const fs::path &path, size_t limit) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t length = static_cast<size_t>(std::min<uintmax_t>(st.st_size, limit));
+        void *view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            _data = static_cast<const char *>(view);
+            _size = length;
+            _fileSize = static_cast<std::uintmax_t>(st.st_size);
+        }
+    }
+    ::close(fd); // the mapping keeps the file alive
+}
+
+void MappedFile::reset() {
+    if (_data) munmap(const_cast<char *>(_data), _size);
+    _data = nullptr;
+    _size = 0;
+    _fileSize = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() { reset(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this == &other) return *this;
+    reset();
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    std::swap(_fileSize, other._fileSize);
+#ifdef _WIN32
+    std::swap(_file, other._file);
+    std::swap(_mapping, other._mapping);
+#endif
+    return *this;
+}
@@ -0,0 +1,365 @@
+#include "PathIndex.hpp"
+#include "DirScanner.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <unordered_map>
+
+namespace {
+constexpr char kMagic[8] = {'F', 'M', 'I', 'N', 'D', 'E', 'X', '\0'};
+constexpr uint32_t kVersion = 2; // 1 had trigram postings
+constexpr uint32_t kMaxNodes = 1u << 22;
+constexpr uint32_t kTruncated = 1; // header flag
+constexpr char kSep = static_cast<char>(fs::path::preferred_separator);
+
+inline char fold(char c) { return c >= 'A' && c <= 'Z' ? c | 0x20 : c; }
+
+int compareFolded(std::string_view a, std::string_view b) {
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char x = fold(a[i]), y = fold(b[i]);
+        if (x != y) return x < y ? -1 : 1;
+    }
+    return a.size() == b.size() ? 0 : a.size() < b.size() ? -1 : 1;
+}
+
+// Case-folded order, ties broken by the raw bytes, so names differing only in case are
+// neighbours.
+bool lessName(std::string_view a, std::string_view b) {
+    int c = compareFolded(a, b);
+    return c != 0 ? c < 0 : a < b;
+}
+
+int64_t mtimeOf(const fs::path &p) {
+    std::error_code ec;
+    fs::file_time_type t = fs::last_write_time(p, ec);
+    return ec ? 0 : static_cast<int64_t>(t.time_since_epoch().count());
+}
+} // namespace
+
+// --- File layout ---
+// Header, then 8-byte aligned sections: nodes, name offsets, name bytes, root path.
+struct PathIndex::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t nodeCount;
+    uint32_t nameCount;
+    uint64_t nodesOff;
+    uint64_t nameOffsOff;
+    uint64_t namesOff;
+    uint64_t rootOff;
+    uint64_t namesSize;
+    uint64_t rootLen;
+};
+
+struct PathIndex::Node {
+    enum : uint32_t {
+        Dir = 1,
+        Listed = 2, // children were read (not skipped or cut off by kMaxNodes)
+    };
+    uint32_t parent;
+    uint32_t name;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t flags;
+    uint32_t reserved;
+    int64_t mtime; // directories only
+};
+
+bool PathIndex::skipped(std::string_view name) {
+    return name == ".git" || name == ".hg" || name == ".svn" || name == "node_modules";
+}
+
+// --- Building ---
+bool PathIndex::build(const fs::path &root, const fs::path &file, const PathIndex *previous,
+                      std::stop_token stop) {
+    struct BuildNode {
+        uint32_t parent;
+        std::string name;
+        uint32_t flags;
+        int64_t mtime = 0;
+        uint32_t firstChild = 0, childCount = 0;
+        NodeId prev = npos; // same directory in `previous`
+    };
+    if (previous && previous->root() != root) previous = nullptr;
+
+    // Breadth-first, so every directory's children end up contiguous.
+    std::vector<BuildNode> nodes{{npos, "", Node::Dir}};
+    nodes[0].prev = previous ? 0 : npos;
+    std::deque<std::pair<uint32_t, fs::path>> pending{{0, root}};
+    bool truncated = false;
+
+    while (!pending.empty()) {
+        if (stop.stop_requested()) return false;
+        auto [id, path] = std::move(pending.front());
+        pending.pop_front();
+
+        int64_t mtime = mtimeOf(path);
+        NodeId prev = nodes[id].prev;
+        std::vector<std::pair<std::string, uint32_t>> children;
+        const Node *pn = prev != npos ? &previous->_nodes[prev] : nullptr;
+        if (pn && (pn->flags & Node::Listed) && pn->mtime == mtime) {
+            // Unchanged since the last build: reuse the listing (already sorted).
+            for (uint32_t c = pn->firstChild; c < pn->firstChild + pn->childCount; ++c)
+                children.emplace_back(previous->name(previous->_nodes[c].name),
+                                      previous->_nodes[c].flags & Node::Dir);
+        } else {
+            std::error_code ec;
+            DirScanner scanner(path, 0, ec);
+            for (DirScanner::Entry e; scanner.next(e);) {
+                bool isDir = e.meta.type == fs::file_type::directory;
+                children.emplace_back(std::string(e.name), isDir ? Node::Dir : 0u);
+            }
+            std::sort(children.begin(), children.end(),
+                      [](const auto &a, const auto &b) { return lessName(a.first, b.first); });
+        }
+
+        nodes[id].mtime = mtime;
+        if (nodes.size() + children.size() > kMaxNodes) {
+            truncated = true;
+            continue;
+        }
+        nodes[id].flags |= Node::Listed;
+        nodes[id].firstChild = static_cast<uint32_t>(nodes.size());
+        nodes[id].childCount = static_cast<uint32_t>(children.size());
+        for (auto &[name, flags] : children) {
+            NodeId prevChild = pn && (flags & Node::Dir) ? previous->child(prev, name) : npos;
+            bool descend = (flags & Node::Dir) && !skipped(name);
+            nodes.push_back({id, std::move(name), flags});
+            nodes.back().prev = prevChild;
+            if (descend) pending.emplace_back(nodes.size() - 1, path / nodes.back().name);
+        }
+    }
+
+    // Deduplicated, sorted name table.
+    std::vector<std::string_view> names;
+    names.reserve(nodes.size());
+    for (const auto &n : nodes) names.push_back(n.name);
+    std::sort(names.begin(), names.end(), lessName);
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    std::unordered_map<std::string_view, uint32_t> nameIds;
+    for (uint32_t i = 0; i < names.size(); ++i) nameIds.emplace(names[i], i);
+
+    std::vector<uint32_t> nameOffs{0};
+    std::string nameBytes;
+    for (auto n : names) {
+        nameBytes += n;
+        nameOffs.push_back(static_cast<uint32_t>(nameBytes.size()));
+    }
+
+    std::vector<Node> out(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const BuildNode &b = nodes[i];
+        out[i] = {b.parent, nameIds[b.name], b.firstChild, b.childCount, b.flags, 0, b.mtime};
+    }
+
+    std::ofstream os(file, std::ios::binary | std::ios::trunc);
+    if (!os) return false;
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.flags = truncated ? kTruncated : 0;
+    h.nodeCount = static_cast<uint32_t>(out.size());
+    h.nameCount = static_cast<uint32_t>(names.size());
+
+    uint64_t pos = sizeof(Header);
+    auto place = [&](uint64_t bytes) {
+        uint64_t off = pos;
+        pos = (pos + bytes + 7) & ~uint64_t(7);
+        return off;
+    };
+    std::string rootStr = root.string();
+    h.nodesOff = place(out.size() * sizeof(Node));
+    h.nameOffsOff = place(nameOffs.size() * sizeof(uint32_t));
+    h.namesOff = place(nameBytes.size());
+    h.rootOff = place(rootStr.size());
+    h.namesSize = nameBytes.size();
+    h.rootLen = rootStr.size();
+
+    uint64_t written = 0;
+    auto put = [&](uint64_t off, const void *data, uint64_t bytes) {
+        static const char zeros[8] = {};
+        os.write(zeros, static_cast<std::streamsize>(off - written));
+        os.write(static_cast<const char *>(data), static_cast<std::streamsize>(bytes));
+        written = off + bytes;
+    };
+    put(0, &h, sizeof(h));
+    put(h.nodesOff, out.data(), out.size() * sizeof(Node));
+    put(h.nameOffsOff, nameOffs.data(), nameOffs.size() * sizeof(uint32_t));
+    put(h.namesOff, nameBytes.data(), nameBytes.size());
+    put(h.rootOff, rootStr.data(), rootStr.size());
+    return static_cast<bool>(os.flush());
+}
+
+// --- Reading ---
+std::shared_ptr<const PathIndex> PathIndex::open(const fs::path &file) {
+    auto index = std::make_shared<PathIndex>();
+    index->_file = MappedFile(file);
+    const MappedFile &f = index->_file;
+    if (!f || f.size() < sizeof(Header)) return nullptr;
+
+    const auto *h = reinterpret_cast<const Header *>(f.data());
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kVersion)
+        return nullptr;
+    auto fits = [&](uint64_t off, uint64_t bytes) {
+        return off % 8 == 0 && off <= f.size() && bytes <= f.size() - off;
+    };
+    if (h->nodeCount == 0 || !fits(h->nodesOff, uint64_t(h->nodeCount) * sizeof(Node)) ||
+        !fits(h->nameOffsOff, (uint64_t(h->nameCount) + 1) * sizeof(uint32_t)) ||
+        !fits(h->namesOff, h->namesSize) || !fits(h->rootOff, h->rootLen))
+        return nullptr;
+
+    index->_header = h;
+    index->_nodes = reinterpret_cast<const Node *>(f.data() + h->nodesOff);
+    index->_nameOffs = reinterpret_cast<const uint32_t *>(f.data() + h->nameOffsOff);
+    index->_names = f.data() + h->namesOff;
+    index->_root = fs::path(std::string(f.data() + h->rootOff, h->rootLen));
+    if (index->_nameOffs[h->nameCount] != h->namesSize) return nullptr;
+    return index;
+}
+
+bool PathIndex::complete() const { return !(_header->flags & kTruncated); }
+
+size_t PathIndex::size() const { return _header->nodeCount; }
+
+bool PathIndex::isDir(NodeId id) const { return _nodes[id].flags & Node::Dir; }
+
+bool PathIndex::listed(NodeId id) const { return _nodes[id].flags & Node::Listed; }
+
+PathIndex::NodeId PathIndex::child(NodeId dir, std::string_view name) const {
+    const Node &n = _nodes[dir];
+    const Node *first = _nodes + n.firstChild, *last = first + n.childCount;
+    const Node *it = std::partition_point(first, last, [&](const Node &c) {
+        return compareFolded(this->name(c.name), name) < 0;
+    });
+    for (; it != last && compareFolded(this->name(it->name), name) == 0; ++it) {
+#ifdef _WIN32
+        return static_cast<NodeId>(it - _nodes); // case-insensitive file system
+#else
+        if (this->name(it->name) == name) return static_cast<NodeId>(it - _nodes);
+#endif
+    }
+    return npos;
+}
+
+std::optional<PathIndex::NodeId> PathIndex::find(const fs::path &rel) const {
+    NodeId id = 0;
+    for (const auto &part : rel) {
+        std::string s = part.string();
+        if (s.empty() || s == ".") continue;
+        id = child(id, s);
+        if (id == npos) return std::nullopt;
+    }
+    return id;
+}
+
+std::string PathIndex::relPath(NodeId id) const {
+    std::vector<NodeId> chain;
+    for (NodeId n = id; n != 0 && n != npos; n = _nodes[n].parent) chain.push_back(n);
+    std::string out;
+    for (size_t i = chain.size(); i-- > 0;) {
+        if (!out.empty()) out += kSep;
+        out += name(_nodes[chain[i]].name);
+    }
+    return out;
+}
+
+void PathIndex::forEach(NodeId node, bool dirsOnly,
+                        const std::function<bool(const std::string &)> &fn) const {
+    std::vector<std::pair<NodeId, std::string>> stack{{node, ""}};
+    while (!stack.empty()) {
+        auto [id, prefix] = std::move(stack.back());
+        stack.pop_back();
+        const Node &n = _nodes[id];
+        for (uint32_t c = n.firstChild; c < n.firstChild + n.childCount; ++c) {
+            std::string rel(name(_nodes[c].name));
+            if (!prefix.empty()) rel = prefix + kSep + rel;
+            if (isDir(c) == dirsOnly && !fn(rel)) return;
+            if (isDir(c)) stack.emplace_back(c, std::move(rel));
+        }
+    }
+}
+
+// --- Indexer ---
+fs::path Indexer::fileFor(const fs::path &root) const {
+    uint64_t h = 1469598103934665603ull;
+    for (char c : root.generic_string())
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.idx", static_cast<unsigned long long>(h));
+    return _dir / name;
+}
+
+void Indexer::start(const fs::path &dir, std::vector<fs::path> roots) {
+    _builder = std::jthread(); // stops and joins a previous refresh
+    _dir = dir;
+    std::error_code ec;
+    fs::create_directories(_dir, ec);
+
+    // Nested roots would index the same files twice; keep the outermost.
+    for (auto &r : roots) r = fs::path(r).lexically_normal();
+    std::sort(roots.begin(), roots.end());
+    roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+    std::vector<fs::path> outer;
+    for (const auto &r : roots) {
+        bool nested = std::any_of(outer.begin(), outer.end(), [&](const fs::path &o) {
+            fs::path rel = r.lexically_relative(o);
+            return !rel.empty() && *rel.begin() != "..";
+        });
+        if (!nested && fs::is_directory(r, ec)) outer.push_back(r);
+    }
+
+    struct Job {
+        fs::path root, file;
+        std::shared_ptr<const PathIndex> previous;
+    };
+    std::vector<Job> jobs;
+    _entries.clear();
+    for (const auto &root : outer) {
+        auto index = PathIndex::open(fileFor(root));
+        if (index && index->root() != root) index.reset(); // hash collision
+        _entries.push_back({root, index});
+        jobs.push_back({root, fileFor(root), index});
+    }
+
+    _builder = std::jthread([this, jobs = std::move(jobs)](std::stop_token stop) mutable {
+        for (auto &job : jobs) {
+            fs::path tmp = job.file;
+            tmp += ".tmp";
+            bool built = false;
+            try {
+                built = PathIndex::build(job.root, tmp, job.previous.get(), stop);
+            } catch (const std::exception &) {}
+            job.previous.reset(); // the old mapping must be gone before install() replaces it
+            if (stop.stop_requested()) return;
+            if (built) _onBuilt(job.root);
+        }
+    });
+}
+
+void Indexer::install(const fs::path &root) {
+    for (auto &e : _entries) {
+        if (e.root != root) continue;
+        fs::path file = fileFor(root), tmp = file;
+        tmp += ".tmp";
+        e.index.reset();
+        std::error_code ec;
+        fs::rename(tmp, file, ec); // fails on Windows while a reader still maps the old file
+        e.index = PathIndex::open(file);
+    }
+}
+
+std::shared_ptr<const PathIndex> Indexer::covering(const fs::path &dir) const {
+    fs::path d = fs::path(dir).lexically_normal();
+    for (const auto &e : _entries) {
+        if (!e.index || !e.index->complete()) continue;
+        fs::path rel = d.lexically_relative(e.root);
+        if (rel.empty() || *rel.begin() == "..") continue;
+        if (auto node = e.index->find(rel); node && e.index->listed(*node)) return e.index;
+    }
+    return nullptr;
+}
@@ -0,0 +1,184 @@
+#include "Preview.hpp"
+#include "DirScanner.hpp"
+#include "Format.hpp"
+#include "Listing.hpp"
+#include "MappedFile.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr size_t kCancelCheck = 256; // entries between cancellation checks
+
+// "00000000  7f 45 4c 46 02 01 01 00  00 00 00 00 00 00 00 00  |.ELF............|"
+std::string hexLine(size_t offset, const unsigned char *p, size_t n) {
+    char buf[96];
+    int len = std::snprintf(buf, sizeof(buf), "%08zx ", offset);
+    for (size_t i = 0; i < 16; ++i) {
+        if (i == 8) buf[len++] = ' ';
+        if (i < n)
+            len += std::snprintf(buf + len, sizeof(buf) - len, " %02x", p[i]);
+        else
+            len += std::snprintf(buf + len, sizeof(buf) - len, "   ");
+    }
+    std::string line(buf, len);
+    line += "  |";
+    for (size_t i = 0; i < n; ++i) line += p[i] >= 0x20 && p[i] < 0x7f ? char(p[i]) : '.';
+    line += '|';
+    return line;
+}
+} // namespace
+
+Previewer::Previewer(Callback callback) : _callback(std::move(callback)) {
+    _thread = std::jthread([this](std::stop_token stop) { loop(stop); });
+}
+
+Previewer::~Previewer() { cancel(); }
+
+Previewer::Key Previewer::keyOf(const fs::path &path, const Tree::Meta &meta) {
+    return {path.string(), meta.size, meta.mtime.time_since_epoch().count()};
+}
+
+Previewer::Result Previewer::request(const fs::path &path, const Tree::Meta &meta) {
+    Key key = keyOf(path, meta);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (auto it = _cache.find(key); it != _cache.end()) {
+            _lru.splice(_lru.begin(), _lru, it->second);
+            _pending.reset();
+            ++_gen;
+            return it->second->second;
+        }
+        if (_current == key && _currentGen == _gen) return nullptr; // already being built
+        _pending = Request{key, path, meta};
+        ++_gen;
+    }
+    _cv.notify_one();
+    return nullptr;
+}
+
+void Previewer::cancel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending.reset();
+    ++_gen;
+}
+
+void Previewer::loop(std::stop_token stop) {
+    Trace::setThreadName("preview");
+    while (true) {
+        Request req;
+        uint64_t gen;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_cv.wait(lock, stop, [&] { return _pending.has_value(); })) return;
+            req = std::move(*_pending);
+            _pending.reset();
+            gen = _currentGen = _gen.load();
+            _current = req.key;
+        }
+
+        Result result = build(req, gen, stop);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _current.reset();
+            if (!result) continue;
+            if (result->kind != Preview::Kind::Error && !_cache.count(req.key)) {
+                _lru.emplace_front(req.key, result);
+                _cache[req.key] = _lru.begin();
+                if (_lru.size() > kCacheSize) {
+                    _cache.erase(_lru.back().first);
+                    _lru.pop_back();
+                }
+            }
+            if (_gen.load() != gen) continue;
+        }
+        _callback(result);
+    }
+}
+
+// Null if cancelled part way.
+Previewer::Result Previewer::build(const Request &req, uint64_t gen, std::stop_token stop) {
+    TraceSpan span("preview", req.path);
+    auto cancelled = [&] { return stop.stop_requested() || _gen.load() != gen; };
+    auto p = std::make_shared<Preview>();
+    p->path = req.path;
+    const Tree::Meta &meta = req.meta;
+
+    if (meta.brokenLink) {
+        p->error = "broken link";
+        return p;
+    }
+
+    if (meta.isDir) {
+        std::error_code ec;
+        DirScanner scanner(req.path, 0, ec);
+        for (DirScanner::Entry e; scanner.next(e);) {
+            if (p->entries.size() % kCancelCheck == 0 && cancelled()) return nullptr;
+            if (p->entries.size() == kMaxEntries) {
+                p->truncated = true;
+                break;
+            }
+            p->entries.push_back(Tree::Item::make(std::string(e.name), e.meta));
+        }
+        if (ec) {
+            p->error = ec.message();
+            return p;
+        }
+        std::sort(p->entries.begin(), p->entries.end(), EntryOrder{});
+        p->kind = Preview::Kind::Directory;
+        p->size = p->entries.size();
+        return p;
+    }
+
+    // A symlink is only read if it leads to a regular file; opening a fifo would block.
+    std::error_code typeEc;
+    if (meta.type != fs::file_type::regular &&
+        (meta.type != fs::file_type::symlink ||
+         fs::status(req.path, typeEc).type() != fs::file_type::regular)) {
+        p->kind = Preview::Kind::Other;
+        return p;
+    }
+
+    p->size = meta.size;
+    MappedFile file(req.path, kWindow);
+    if (!file) {
+        std::error_code ec;
+        if (fs::file_size(req.path, ec) == 0 && !ec) {
+            p->kind = Preview::Kind::Text; // empty
+            return p;
+        }
+        p->error = ec ? ec.message() : "cannot read file";
+        return p;
+    }
+    p->size = file.fileSize();
+    const char *data = file.data();
+    size_t size = file.size();
+
+    if (looksBinary(data, size)) {
+        p->kind = Preview::Kind::Binary;
+        size_t shown = std::min(size, kHexBytes);
+        for (size_t off = 0; off < shown; off += 16) {
+            if (off % kCancelCheck == 0 && cancelled()) return nullptr;
+            p->lines.push_back(hexLine(off, reinterpret_cast<const unsigned char *>(data) + off,
+                                       std::min<size_t>(16, shown - off)));
+        }
+        p->truncated = p->size > shown;
+        return p;
+    }
+
+    p->kind = Preview::Kind::Text;
+    size_t pos = 0;
+    while (pos < size && p->lines.size() < kMaxLines) {
+        if (cancelled()) return nullptr;
+        const char *nl = static_cast<const char *>(std::memchr(data + pos, '\n', size - pos));
+        size_t end = nl ? static_cast<size_t>(nl - data) : size;
+        std::string_view line(data + pos, end - pos);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        p->lines.push_back(displayLine(line, kMaxColumns));
+        pos = end + 1;
+    }
+    p->truncated = pos < size || p->size > size;
+    return p;
+}
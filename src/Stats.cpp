@@ -0,0 +1,104 @@
+#include "Stats.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+namespace {
+struct TimerSlot {
+    std::atomic<uint64_t> count{0};
+    std::atomic<int64_t> total{0};
+    std::array<std::atomic<int64_t>, Stats::kSamples> samples{}; // ring of the latest, in ns
+};
+
+std::array<TimerSlot, Stats::kTimers> gTimers;
+std::array<std::atomic<uint64_t>, Stats::kCounters> gCounters{};
+std::atomic<int64_t> gFrameStart{0}; // steady_clock ticks, 0 when no frame is pending
+
+int64_t steadyNow() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+
+double toMs(std::chrono::nanoseconds ns) { return ns.count() / 1e6; }
+} // namespace
+
+void Stats::record(Timer timer, std::chrono::nanoseconds duration) {
+    TimerSlot &slot = gTimers[timer];
+    uint64_t n = slot.count.fetch_add(1, std::memory_order_relaxed);
+    slot.samples[n % kSamples].store(duration.count(), std::memory_order_relaxed);
+    slot.total.fetch_add(duration.count(), std::memory_order_relaxed);
+}
+
+void Stats::add(Counter counter, uint64_t n) {
+    gCounters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+// Percentiles over the retained samples; a sample written concurrently may be the newer one.
+Stats::Summary Stats::summary(Timer timer) {
+    const TimerSlot &slot = gTimers[timer];
+    Summary s;
+    s.count = slot.count.load(std::memory_order_relaxed);
+    s.total = std::chrono::nanoseconds(slot.total.load(std::memory_order_relaxed));
+    if (s.count == 0) return s;
+
+    size_t n = std::min<uint64_t>(s.count, kSamples);
+    std::vector<int64_t> samples(n);
+    for (size_t i = 0; i < n; ++i) samples[i] = slot.samples[i].load(std::memory_order_relaxed);
+    s.last = std::chrono::nanoseconds(samples[(s.count - 1) % kSamples]);
+    auto at = [&](size_t rank) {
+        std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+        return std::chrono::nanoseconds(samples[rank]);
+    };
+    s.p50 = at(n / 2);
+    s.p99 = at(std::min(n - 1, n * 99 / 100));
+    return s;
+}
+
+uint64_t Stats::counter(Counter counter) {
+    return gCounters[counter].load(std::memory_order_relaxed);
+}
+
+const char *Stats::name(Timer timer) {
+    static const char *names[] = {"frame", "event",   "render", "paint",
+                                  "refresh", "load", "scan",   "sort"};
+    static_assert(std::size(names) == kTimers);
+    return names[timer];
+}
+
+const char *Stats::name(Counter counter) {
+    static const char *names[] = {"entries scanned", "stat calls"};
+    static_assert(std::size(names) == kCounters);
+    return names[counter];
+}
+
+void Stats::beginFrame() {
+    int64_t none = 0;
+    gFrameStart.compare_exchange_strong(none, steadyNow(), std::memory_order_relaxed);
+}
+
+void Stats::endFrame() {
+    int64_t start = gFrameStart.exchange(0, std::memory_order_relaxed);
+    if (start == 0) return;
+    record(Frame, std::chrono::steady_clock::duration(steadyNow() - start));
+}
+
+void Stats::write(std::ostream &out) {
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-10s %10s %10s %10s %10s %12s\n", "timer", "count",
+                  "last ms", "p50 ms", "p99 ms", "total ms");
+    out << line;
+    for (unsigned t = 0; t < kTimers; ++t) {
+        Summary s = summary(static_cast<Timer>(t));
+        std::snprintf(line, sizeof(line), "%-10s %10llu %10.3f %10.3f %10.3f %12.3f\n",
+                      name(static_cast<Timer>(t)), static_cast<unsigned long long>(s.count),
+                      toMs(s.last), toMs(s.p50), toMs(s.p99), toMs(s.total));
+        out << line;
+    }
+    out << '\n';
+    for (unsigned c = 0; c < kCounters; ++c) {
+        std::snprintf(line, sizeof(line), "%-16s %llu\n", name(static_cast<Counter>(c)),
+                      static_cast<unsigned long long>(counter(static_cast<Counter>(c))));
+        out << line;
+    }
+}
@@ -0,0 +1,157 @@
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+#include <iterator>
+
+namespace {
+thread_local ThreadPool *t_pool = nullptr;
+thread_local size_t t_index = 0;
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads) {
+    for (unsigned i = 0; i < threads; ++i) _queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < threads; ++i) _workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_all();
+    for (auto &w : _workers) w.join();
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::submit(Task task, const TaskGroup *group) {
+    size_t idx = t_pool == this ? t_index : _nextQueue++ % _queues.size();
+    {
+        std::lock_guard<std::mutex> lock(_queues[idx]->mutex);
+        _queues[idx]->tasks.push_back({std::move(task), group});
+    }
+    _queued++;
+    { std::lock_guard<std::mutex> lock(_mutex); }
+    _cv.notify_one();
+}
+
+bool ThreadPool::tryPop(size_t self, Task &task) {
+    if (_queued.load() == 0) return false;
+
+    if (self < _queues.size()) {
+        Queue &own = *_queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back().task);
+            own.tasks.pop_back();
+            _queued--;
+            return true;
+        }
+    }
+
+    size_t n = _queues.size();
+    size_t start = self < n ? self + 1 : 0;
+    for (size_t i = 0; i < n; ++i) {
+        Queue &victim = *_queues[(start + i) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front().task);
+            victim.tasks.pop_front();
+            _queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The newest queued task of `group`, from any queue. Groups are short-lived and their
+// tasks few per queue, so a linear scan is fine.
+bool ThreadPool::tryPopFrom(const TaskGroup *group, Task &task) {
+    if (_queued.load() == 0) return false;
+    for (auto &queue : _queues) {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        auto &tasks = queue->tasks;
+        auto it = std::find_if(tasks.rbegin(), tasks.rend(),
+                               [group](const Queued &q) { return q.group == group; });
+        if (it == tasks.rend()) continue;
+        task = std::move(it->task);
+        tasks.erase(std::next(it).base());
+        _queued--;
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask(const TaskGroup *group) {
+    Task task;
+    if (!tryPopFrom(group, task)) return false;
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    t_pool = this;
+    t_index = index;
+    Trace::setThreadName("pool " + std::to_string(index));
+    while (true) {
+        Task task;
+        if (tryPop(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return _stop || _queued.load() > 0; });
+        if (_stop && _queued.load() == 0) return;
+    }
+}
+
+// --- TaskGroup ---
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {}
+}
+
+void TaskGroup::run(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_pending;
+        ++_queued;
+    }
+    _pool.submit(
+        [this, fn = std::move(fn)] {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_queued;
+            }
+            std::exception_ptr error;
+            try {
+                fn();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // Notified under the lock: once wait() sees zero the group may be destroyed.
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (error && !_error) _error = error;
+            if (--_pending == 0) _cv.notify_all();
+        },
+        this);
+    _cv.notify_all(); // a waiter can run it
+}
+
+void TaskGroup::wait() {
+    std::exception_ptr error;
+    while (true) {
+        if (_pool.runPendingTask(this)) continue;
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_pending == 0) {
+            std::swap(error, _error);
+            break;
+        }
+        _cv.wait(lock, [this] { return _pending == 0 || _queued > 0; });
+    }
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,167 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+struct Event {
+    const char *name;
+    int64_t begin, end; // steady_clock ticks
+    char arg[Trace::kArgSize];
+};
+
+// A seqlock per slot lets stop() copy out spans while their threads keep recording: the
+// sequence is odd while the owner writes the slot and 2 * (index + 1) once it is complete.
+struct Slot {
+    std::atomic<uint64_t> seq{0};
+    Event event;
+};
+
+// Written only by its own thread; read by stop().
+struct Ring {
+    uint32_t tid = 0;
+    std::string threadName;
+    std::atomic<uint64_t> head{0};
+    std::unique_ptr<Slot[]> slots{new Slot[Trace::kRingSize]};
+};
+
+std::mutex gMutex; // guards gRings, gFile and thread names
+std::vector<std::unique_ptr<Ring>> gRings;
+fs::path gFile;
+thread_local Ring *t_ring = nullptr;
+
+Ring &ring() {
+    if (!t_ring) {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gRings.push_back(std::make_unique<Ring>());
+        gRings.back()->tid = static_cast<uint32_t>(gRings.size());
+        t_ring = gRings.back().get();
+    }
+    return *t_ring;
+}
+
+void appendJsonString(std::string &out, std::string_view s) {
+    out += '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char esc[8];
+            std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+// Chrome trace timestamps are microseconds.
+double micros(int64_t ticks) {
+    using namespace std::chrono;
+    return duration<double, std::micro>(Trace::Clock::duration(ticks)).count();
+}
+} // namespace
+
+void Trace::start(fs::path file) {
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gFile = std::move(file);
+    }
+    _enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(std::string_view name) {
+    if (!enabled()) return;
+    Ring &r = ring();
+    std::lock_guard<std::mutex> lock(gMutex);
+    r.threadName = name;
+}
+
+void Trace::record(const char *name, std::string_view arg, Clock::time_point begin,
+                   Clock::time_point end) {
+    if (!enabled()) return;
+    Ring &r = ring();
+    uint64_t idx = r.head.load(std::memory_order_relaxed);
+    Slot &slot = r.slots[idx % kRingSize];
+    slot.seq.store(2 * idx + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Event &e = slot.event;
+    e.name = name;
+    e.begin = begin.time_since_epoch().count();
+    e.end = end.time_since_epoch().count();
+    size_t n = std::min(arg.size(), kArgSize - 1);
+    std::memcpy(e.arg, arg.data(), n);
+    e.arg[n] = '\0';
+
+    slot.seq.store(2 * idx + 2, std::memory_order_release);
+    r.head.store(idx + 1, std::memory_order_release);
+}
+
+bool Trace::stop() {
+    if (!_enabled.exchange(false)) return true;
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    std::vector<std::pair<uint32_t, Event>> events;
+    int64_t origin = INT64_MAX;
+    for (const auto &r : gRings) {
+        uint64_t head = r->head.load(std::memory_order_acquire);
+        for (uint64_t idx = head > kRingSize ? head - kRingSize : 0; idx < head; ++idx) {
+            const Slot &slot = r->slots[idx % kRingSize];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != 2 * idx + 2) continue; // being overwritten by a late span
+            Event e;
+            std::memcpy(&e, &slot.event, sizeof(Event));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+            origin = std::min(origin, e.begin);
+            events.emplace_back(r->tid, e);
+        }
+    }
+    std::sort(events.begin(), events.end(),
+              [](const auto &a, const auto &b) { return a.second.begin < b.second.begin; });
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char num[96];
+    for (const auto &r : gRings) {
+        if (r->threadName.empty()) continue;
+        std::snprintf(num, sizeof(num),
+                      "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,",
+                      first ? "" : ",\n", r->tid);
+        out += num;
+        out += "\"args\":{\"name\":";
+        appendJsonString(out, r->threadName);
+        out += "}}";
+        first = false;
+    }
+    for (const auto &[tid, e] : events) {
+        out += first ? "" : ",\n";
+        first = false;
+        out += "{\"name\":";
+        appendJsonString(out, e.name);
+        std::snprintf(num, sizeof(num),
+                      ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", tid,
+                      micros(e.begin - origin), micros(e.end - e.begin));
+        out += num;
+        if (e.arg[0]) {
+            out += ",\"args\":{\"detail\":";
+            appendJsonString(out, e.arg);
+            out += '}';
+        }
+        out += '}';
+    }
+    out += "\n]}\n";
+
+    std::ofstream file(gFile, std::ios::binary);
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    return static_cast<bool>(file.flush());
+}
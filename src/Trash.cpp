@@ -0,0 +1,172 @@
+#include "Trash.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Path= value of a .trashinfo file: the absolute path, URL-encoded.
+std::string encodePath(const std::string &path) {
+    static const char *hex = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : path) {
+        if (std::isalnum(c) || c == '/' || c == '-' || c == '_' || c == '.' || c == '~') {
+            out += static_cast<char>(c);
+        } else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+    }
+    return out;
+}
+
+std::string deletionDate() {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &local);
+    return buf;
+}
+
+// Creates `file` only if it does not exist yet; this is how a trash name is claimed.
+bool createExclusive(const fs::path &file) {
+#ifdef _WIN32
+    HANDLE h = CreateFileW(file.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    CloseHandle(h);
+#else
+    int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    ::close(fd);
+#endif
+    return true;
+}
+} // namespace
+
+#ifdef _WIN32
+
+fs::path Trash::dirFor(const fs::path &path) {
+    fs::path dir = fs::absolute(path).root_path() / ".FileManagerTrash";
+    if (!fs::exists(dir)) {
+        std::error_code ec;
+        fs::create_directory(dir, ec);
+        if (ec == std::errc::permission_denied || ec == std::errc::read_only_file_system)
+            throw Unavailable("no trash on this volume", path, ec);
+        if (ec) throw fs::filesystem_error("trash", dir, ec);
+        SetFileAttributesW(dir.c_str(), FILE_ATTRIBUTE_HIDDEN);
+    }
+    return dir;
+}
+
+#else
+
+fs::path Trash::dirFor(const fs::path &path) {
+    struct stat st, other;
+    if (::lstat(path.c_str(), &st) != 0)
+        throw fs::filesystem_error("trash", path, std::error_code(errno, std::system_category()));
+
+    // The home trash, if it lives on the same file system.
+    fs::path dataHome;
+    if (const char *xdg = std::getenv("XDG_DATA_HOME"); xdg && *xdg) {
+        dataHome = xdg;
+    } else if (const char *home = std::getenv("HOME"); home && *home) {
+        dataHome = fs::path(home) / ".local" / "share";
+    }
+    if (!dataHome.empty()) {
+        // The trash may not exist yet: compare against its nearest existing ancestor.
+        fs::path existing = dataHome;
+        bool found;
+        while (!(found = ::stat(existing.c_str(), &other) == 0) && existing.has_parent_path() &&
+               existing != existing.parent_path())
+            existing = existing.parent_path();
+        if (found && other.st_dev == st.st_dev) return dataHome / "Trash";
+    }
+
+    // Otherwise the top directory of the mount holding `path`.
+    fs::path top = fs::absolute(path).parent_path();
+    while (top.has_parent_path() && top != top.parent_path()) {
+        if (::stat(top.parent_path().c_str(), &other) != 0 || other.st_dev != st.st_dev) break;
+        top = top.parent_path();
+    }
+    fs::path dir = top / (".Trash-" + std::to_string(::getuid()));
+    if (fs::exists(dir)) return dir;
+    // A mount we cannot write to at the top has no trash of ours and cannot get one.
+    if (::access(top.c_str(), W_OK) != 0)
+        throw Unavailable("no trash on this file system", path,
+                          std::error_code(errno, std::system_category()));
+    if (::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+        throw fs::filesystem_error("trash", dir, std::error_code(errno, std::system_category()));
+    return dir;
+}
+
+#endif
+
+fs::path Trash::infoFor(const fs::path &trashed) {
+    return trashed.parent_path().parent_path() / "info" /
+           (trashed.filename().string() + ".trashinfo");
+}
+
+fs::path Trash::put(const fs::path &path) {
+    fs::path dir = dirFor(path);
+    fs::create_directories(dir / "files");
+    fs::create_directories(dir / "info");
+
+    std::string stem = path.stem().string(), ext = path.extension().string();
+    fs::path trashed, info;
+    for (int n = 0;; ++n) {
+        if (n > 10000)
+            throw fs::filesystem_error("trash", path, std::make_error_code(std::errc::file_exists));
+        std::string name = n ? stem + "." + std::to_string(n) + ext : path.filename().string();
+        trashed = dir / "files" / name;
+        info = dir / "info" / (name + ".trashinfo");
+        if (fs::exists(fs::symlink_status(trashed))) continue;
+        if (createExclusive(info)) break;
+    }
+
+    {
+        std::ofstream out(info, std::ios::trunc);
+        out << "[Trash Info]\nPath=" << encodePath(fs::absolute(path).generic_string())
+            << "\nDeletionDate=" << deletionDate() << "\n";
+    }
+    std::error_code ec;
+    fs::rename(path, trashed, ec);
+    if (ec) {
+        fs::remove(info);
+        throw fs::filesystem_error("trash", path, trashed, ec);
+    }
+    return trashed;
+}
+
+void Trash::restore(const fs::path &trashed, const fs::path &original) {
+    if (fs::exists(fs::symlink_status(original)))
+        throw fs::filesystem_error("restore", trashed, original,
+                                   std::make_error_code(std::errc::file_exists));
+    fs::rename(trashed, original);
+    std::error_code ec;
+    fs::remove(infoFor(trashed), ec);
+}
+
+void Trash::purge(const fs::path &trashed) {
+    std::error_code ec;
+    fs::remove_all(trashed, ec);
+    fs::remove(infoFor(trashed), ec);
+}
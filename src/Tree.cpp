@@ -0,0 +1,288 @@
+#include "Tree.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+Tree::Tree() { rehash(1024); }
+
+// --- Scan records ---
+Tree::Meta Tree::Meta::read(const fs::directory_entry &e) {
+    std::error_code ec;
+    Meta m;
+    m.type = e.symlink_status(ec).type();
+
+    fs::file_status target = m.type == fs::file_type::symlink ? e.status(ec) : e.symlink_status(ec);
+    m.brokenLink = m.type == fs::file_type::symlink && !fs::exists(target);
+    m.isDir = fs::is_directory(target);
+
+    if (fs::is_regular_file(target)) {
+        std::uintmax_t size = e.file_size(ec);
+        m.size = ec ? 0 : size;
+    }
+    if (!m.brokenLink) {
+        fs::file_time_type mtime = e.last_write_time(ec);
+        if (!ec) m.mtime = mtime;
+    }
+    return m;
+}
+
+Tree::Meta Tree::Meta::read(const fs::path &p) {
+    std::error_code ec;
+    fs::directory_entry e(p, ec);
+    return read(e);
+}
+
+Tree::Item Tree::Item::make(std::string name, const Meta &meta) {
+    std::string folded = name;
+    std::transform(folded.begin(), folded.end(), folded.begin(), ::tolower);
+    size_t dot = folded.rfind('.');
+    size_t extPos = dot == 0 || dot == std::string::npos ? std::string::npos : dot;
+    return Item{std::move(name), std::move(folded), extPos, meta};
+}
+
+// --- Nodes ---
+uint32_t Tree::hashOf(NodeId parent, std::string_view name) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : name) h = (h ^ c) * 16777619u;
+    h ^= parent * 0x9E3779B1u;
+    h ^= h >> 15;
+    return h * 0x2C1B3C6Du;
+}
+
+uint32_t Tree::store(std::string_view name) {
+    const uint32_t chunkSize = 1u << kChunkBits;
+    uint32_t need = static_cast<uint32_t>(name.size() * 2);
+    if (_chunks.empty() || _chunkUsed + need > chunkSize) {
+        _chunks.push_back(std::make_unique<char[]>(chunkSize));
+        _chunkUsed = 0;
+    }
+
+    uint32_t off = static_cast<uint32_t>(_chunks.size() - 1) << kChunkBits | _chunkUsed;
+    char *dst = _chunks.back().get() + _chunkUsed;
+    std::memcpy(dst, name.data(), name.size());
+    std::transform(name.begin(), name.end(), dst + name.size(), ::tolower);
+    _chunkUsed += need;
+    return off;
+}
+
+Tree::NodeId Tree::append(NodeId parent, std::string_view name, uint32_t hash) {
+    NodeId id = static_cast<NodeId>(_parent.size());
+    size_t dot = name.rfind('.');
+
+    _parent.push_back(parent);
+    _nameOff.push_back(store(name));
+    _nameLen.push_back(static_cast<uint16_t>(name.size()));
+    _extPos.push_back(dot == 0 || dot == std::string_view::npos ? kNoExt
+                                                                 : static_cast<uint16_t>(dot));
+    _type.push_back(static_cast<uint8_t>(fs::file_type::none));
+    _flags.push_back(0);
+    _size.push_back(0);
+    _mtime.push_back(0);
+    _hash.push_back(hash);
+
+    if (_parent.size() * 2 > _slots.size()) {
+        rehash(_slots.size() * 2);
+    } else {
+        size_t mask = _slots.size() - 1;
+        size_t i = hash & mask;
+        while (_slots[i] != npos) i = (i + 1) & mask;
+        _slots[i] = id;
+    }
+    return id;
+}
+
+void Tree::rehash(size_t capacity) {
+    _slots.assign(capacity, npos);
+    size_t mask = capacity - 1;
+    for (NodeId id = 0; id < _parent.size(); ++id) {
+        size_t i = _hash[id] & mask;
+        while (_slots[i] != npos) i = (i + 1) & mask;
+        _slots[i] = id;
+    }
+}
+
+Tree::NodeId Tree::findChild(NodeId parent, std::string_view name) const {
+    uint32_t hash = hashOf(parent, name);
+    size_t mask = _slots.size() - 1;
+    for (size_t i = hash & mask; _slots[i] != npos; i = (i + 1) & mask) {
+        NodeId id = _slots[i];
+        if (_hash[id] == hash && _parent[id] == parent && this->name(id) == name) return id;
+    }
+    return npos;
+}
+
+Tree::NodeId Tree::child(NodeId parent, std::string_view name) {
+    NodeId id = findChild(parent, name);
+    return id != npos ? id : append(parent, name, hashOf(parent, name));
+}
+
+Tree::NodeId Tree::add(NodeId parent, const Item &item) {
+    NodeId id = child(parent, item.name);
+    setMeta(id, item.meta);
+    return id;
+}
+
+Tree::NodeId Tree::intern(const fs::path &path) {
+    fs::path p = (path.is_absolute() ? path : fs::absolute(path)).lexically_normal();
+    NodeId id = child(npos, p.root_path().string());
+    for (const auto &part : p.relative_path()) {
+        std::string s = part.string();
+        if (s.empty() || s == ".") continue;
+        if (s == "..") {
+            if (_parent[id] != npos) id = _parent[id];
+            continue;
+        }
+        id = child(id, s);
+    }
+    return id;
+}
+
+std::optional<Tree::NodeId> Tree::find(const fs::path &path) const {
+    fs::path p = (path.is_absolute() ? path : fs::absolute(path)).lexically_normal();
+    NodeId id = findChild(npos, p.root_path().string());
+    for (const auto &part : p.relative_path()) {
+        if (id == npos) return std::nullopt;
+        std::string s = part.string();
+        if (s.empty() || s == ".") continue;
+        if (s == "..") {
+            if (_parent[id] != npos) id = _parent[id];
+            continue;
+        }
+        id = findChild(id, s);
+    }
+    if (id == npos) return std::nullopt;
+    return id;
+}
+
+fs::path Tree::path(NodeId id) const {
+    std::vector<NodeId> chain;
+    for (NodeId n = id; n != npos; n = _parent[n]) chain.push_back(n);
+
+    fs::path p(std::string(name(chain.back())));
+    for (size_t i = chain.size() - 1; i-- > 0;) p /= std::string(name(chain[i]));
+    return p;
+}
+
+std::string_view Tree::extension(NodeId id) const {
+    if (_extPos[id] == kNoExt) return {};
+    return name(id).substr(_extPos[id]);
+}
+
+bool Tree::isAncestor(NodeId ancestor, NodeId id) const {
+    for (NodeId n = _parent[id]; n != npos; n = _parent[n])
+        if (n == ancestor) return true;
+    return false;
+}
+
+// --- Metadata ---
+Tree::Meta Tree::meta(NodeId id) const {
+    Meta m;
+    m.type = static_cast<fs::file_type>(_type[id]);
+    m.isDir = _flags[id] & IsDir;
+    m.brokenLink = _flags[id] & BrokenLink;
+    m.size = _size[id];
+    m.sizeKnown = _flags[id] & SizeKnown;
+    m.mtime = fs::file_time_type(fs::file_time_type::duration(_mtime[id]));
+    return m;
+}
+
+void Tree::setMeta(NodeId id, const Meta &m) {
+    _type[id] = static_cast<uint8_t>(m.type);
+    // A rescan knows nothing about directory totals; keep the last one until it is replaced.
+    bool keepSize = m.isDir && isDir(id) && (_flags[id] & SizeKnown);
+    setFlag(id, IsDir, m.isDir);
+    setFlag(id, BrokenLink, m.brokenLink);
+    if (!keepSize) {
+        _size[id] = m.size;
+        setFlag(id, SizeKnown, m.sizeKnown);
+    }
+    _mtime[id] = m.mtime.time_since_epoch().count();
+}
+
+void Tree::setDirSize(NodeId id, std::uintmax_t size) {
+    _size[id] = size;
+    setFlag(id, SizeKnown, true);
+}
+
+Tree::SortKey Tree::sortKey(NodeId id) const {
+    std::string_view folded = sortName(id);
+    std::string_view ext = _extPos[id] == kNoExt ? std::string_view{} : folded.substr(_extPos[id]);
+    return {isDir(id), folded, ext, _size[id],
+            fs::file_time_type(fs::file_time_type::duration(_mtime[id]))};
+}
+
+// --- Expanded / selected state ---
+void Tree::setExpanded(NodeId id, bool on) {
+    if (expanded(id) == on) return;
+    setFlag(id, Expanded, on);
+    if (on)
+        _expanded.push_back(id);
+    else
+        std::erase(_expanded, id);
+}
+
+void Tree::setSelected(NodeId id, bool on) {
+    if (selected(id) == on) return;
+    setFlag(id, Selected, on);
+    on ? ++_selectedCount : --_selectedCount;
+}
+
+std::vector<Tree::NodeId> Tree::expandedBelow(NodeId under) const {
+    std::vector<NodeId> out;
+    for (NodeId id : _expanded) {
+        NodeId n = _parent[id];
+        while (n != npos && n != under && expanded(n)) n = _parent[n];
+        if (n == under && id != under) out.push_back(id);
+    }
+    return out;
+}
+
+std::vector<Tree::NodeId> Tree::selection() const {
+    std::vector<NodeId> out;
+    if (_selectedCount == 0) return out;
+    for (NodeId id = 0; id < _flags.size(); ++id)
+        if (_flags[id] & Selected) out.push_back(id);
+    return out;
+}
+
+void Tree::clearExpanded() {
+    for (NodeId id : _expanded) _flags[id] &= ~Expanded;
+    _expanded.clear();
+}
+
+void Tree::clearSelection() {
+    if (_selectedCount == 0) return;
+    for (auto &f : _flags) f &= ~Selected;
+    _selectedCount = 0;
+}
+
+std::vector<Tree::NodeId> Tree::compact(const std::vector<NodeId> &keep) {
+    std::vector<uint8_t> mark(size(), 0);
+    auto markUp = [&](NodeId n) {
+        for (; n != npos && !mark[n]; n = _parent[n]) mark[n] = 1;
+    };
+    for (NodeId id : keep) markUp(id);
+    for (NodeId id : _expanded) markUp(id);
+    if (_selectedCount)
+        for (NodeId id = 0; id < size(); ++id)
+            if (_flags[id] & Selected) markUp(id);
+
+    // Parents always precede their children, so one forward pass rebuilds the tree.
+    Tree out;
+    std::vector<NodeId> remap(size(), npos);
+    for (NodeId id = 0; id < size(); ++id) {
+        if (!mark[id]) continue;
+        NodeId parent = _parent[id] == npos ? npos : remap[_parent[id]];
+        NodeId n = out.append(parent, name(id), hashOf(parent, name(id)));
+        out._type[n] = _type[id];
+        out._flags[n] = _flags[id];
+        out._size[n] = _size[id];
+        out._mtime[n] = _mtime[id];
+        remap[id] = n;
+    }
+    for (NodeId id : _expanded) out._expanded.push_back(remap[id]);
+    out._selectedCount = _selectedCount;
+    *this = std::move(out);
+    return remap;
+}
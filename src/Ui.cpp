@@ -1,12 +1,52 @@
 #include "Ui.hpp"
+#include "Stats.hpp"
 #include "Utils.hpp"
 
+#include <cstdio>
+
 using namespace ftxui;
 
+namespace {
+// Wraps the whole frame to time FTXUI's layout passes and drawing into its screen buffer,
+// then closes the frame timer.
+class PaintTimer : public Node {
+  public:
+    explicit PaintTimer(Element child) : Node({std::move(child)}) {}
+
+    void ComputeRequirement() override {
+        if (!_started) {
+            _start = std::chrono::steady_clock::now();
+            _started = true;
+        }
+        Node::ComputeRequirement();
+        requirement_ = children_[0]->requirement();
+    }
+    void SetBox(Box box) override {
+        Node::SetBox(box);
+        children_[0]->SetBox(box);
+    }
+    void Render(Screen &screen) override {
+        Node::Render(screen);
+        auto end = std::chrono::steady_clock::now();
+        Stats::record(Stats::Paint, end - _start);
+        Trace::record("paint", {}, _start, end);
+        Stats::endFrame();
+    }
+
+  private:
+    std::chrono::steady_clock::time_point _start;
+    bool _started = false;
+};
+} // namespace
+
 // --- UI ---
 Element UI::render(ScreenInteractive &screen) {
+    Stats::beginFrame(); // redraws without an event (resize, posted updates) start one here
+    ScopedTimer timer(Stats::Render);
     Elements rows;
-    Layout layout = Layout::compute(screen.dimx(), _fm.maxExpandedDepth());
+    bool preview = _fm.showPreview && screen.dimx() >= 60;
+    int previewWidth = preview ? screen.dimx() * 2 / 5 : 0;
+    Layout layout = Layout::compute(screen.dimx() - previewWidth, _fm.maxExpandedDepth());
 
     // Header row
     rows.push_back(hbox({
@@ -26,18 +66,27 @@ Element UI::render(ScreenInteractive &screen) {
     size_t end = std::min(_fm.scrollOffset + max_height, _fm.entries.size());
 
     for (size_t i = start; i < end; ++i) {
-        auto [p, depth] = _fm.entries[i];
-        bool isDir = fs::is_directory(p);
-        Element fileElem = UI::fileElement(p, isDir, _fm.expandedDirs);
+        const auto &entry = _fm.entries[i];
+        std::string_view name = _fm.tree.name(entry.node);
+        std::string_view ext = _fm.tree.extension(entry.node);
+        FileManager::Meta meta = _fm.tree.meta(entry.node);
+        int depth = entry.depth;
+        Element fileElem = UI::fileElement(name, ext, meta.isDir, _fm.tree.expanded(entry.node));
 
         // Highlight selected items
-        if (_fm.selItems.count(p)) { fileElem = fileElem | bgcolor(Color::BlueLight); }
-        std::string typeStr = getFileTypeString(p);
-        std::string sizeStr = getFileSizeString(p);
+        if (_fm.tree.selected(entry.node)) { fileElem = fileElem | bgcolor(Color::BlueLight); }
+        std::string typeStr = getFileTypeString(ext, meta);
+        std::string sizeStr = getFileSizeString(meta);
+        Decorator typeStyle = dim;
+        if (auto mark = _fm.compareMark(entry.node)) {
+            bool added = *mark == DirCompare::Kind::OnlyLeft;
+            typeStr = added ? "+new" : "~diff";
+            typeStyle = color(added ? Color::Green : Color::Yellow);
+        }
 
         int indent_spaces = std::min(depth * layout.indent_per_level, layout.max_indent_width);
         int icon_and_indent_width = indent_spaces + layout.icon_width;
-        int actual_name_len = std::min((int)p.filename().string().length(), layout.max_name_width);
+        int actual_name_len = std::min((int)name.length(), layout.max_name_width);
         int name_block_width = icon_and_indent_width + actual_name_len;
         int spacer_width = std::max(layout.type_column - name_block_width, 1);
 
@@ -45,7 +94,7 @@ Element UI::render(ScreenInteractive &screen) {
             text(std::string(indent_spaces, ' ')),
             fileElem | size(WIDTH, LESS_THAN, layout.max_name_width),
             text(std::string(spacer_width, ' ')),
-            text(typeStr) | dim | size(WIDTH, EQUAL, layout.type_col_width),
+            text(typeStr) | typeStyle | size(WIDTH, EQUAL, layout.type_col_width),
             text(std::string(layout.spacing, ' ')),
             text(sizeStr) | dim | size(WIDTH, EQUAL, layout.size_col_width),
         });
@@ -55,15 +104,34 @@ Element UI::render(ScreenInteractive &screen) {
         rows.push_back(line);
     }
 
+    std::string header = "Current Directory: " + _fm.cwd.string();
+    if (_fm.loading) header += "  (loading " + std::to_string(_fm.entries.size()) + ")";
+    if (!_fm.compareMarks.empty()) header += "  (compared with " + _fm.compareRight.string() + ")";
+
     Element fileList = vbox({
-        text("Current Directory: " + _fm.cwd.string()) | bold | color(Color::Yellow),
+        text(header) | bold | color(Color::Yellow),
         separator(),
         vbox(rows) | flex | frame | borderRounded | bgcolor(Color::Black),
     });
+    if (preview)
+        fileList = hbox({
+            fileList | flex,
+            createPreviewPane(screen.dimy() - 3) | size(WIDTH, EQUAL, previewWidth),
+        });
 
+    static const char *sortNames[] = {"name", "natural", "size", "mtime", "ext"};
+    std::string modeStr = _fm.mode == FileManager::Mode::Select ? "SELECT" : "NORMAL";
+    std::string sortStr = std::string("sort: ") + sortNames[static_cast<int>(_fm.sortMode)] +
+                          (_fm.sortReversed ? " (rev)" : "");
+    size_t failed = std::count_if(_fm.jobList.begin(), _fm.jobList.end(), [](const auto &job) {
+        return job.state == JobQueue::State::Failed;
+    });
+    std::string failedStr = failed ? std::to_string(failed) + " failed (b)  " : "";
     Element modeLine = hbox({
-                           text(_fm.modeStr) | bold | color(Color::Green),
+                           text(modeStr) | bold | color(Color::Green),
                            filler(),
+                           text(failedStr) | color(Color::RedLight),
+                           text(sortStr + " ") | dim,
                        }) |
                        size(HEIGHT, EQUAL, 1) | bgcolor(Color::Black);
 
@@ -72,7 +140,9 @@ Element UI::render(ScreenInteractive &screen) {
                             modeLine,
                         }) |
                         size(HEIGHT, EQUAL, screen.dimy());
-    return createOverlay(main_view);
+    main_view = dbox({main_view, createJobStatus()});
+    if (_fm.showStats) main_view = dbox({main_view, createStatsOverlay()});
+    return std::make_shared<PaintTimer>(createOverlay(main_view));
 }
 
 Element UI::createOverlay(const Element &main_view) {
@@ -86,13 +156,26 @@ Element UI::createOverlay(const Element &main_view) {
     case FileManager::Prompt::Rename:
         return promptBox("Rename to:");
     case FileManager::Prompt::Move:
+        if (!_fm.promptBatch.empty())
+            return promptBox("Move " + std::to_string(_fm.promptBatch.size()) +
+                             " items to folder:");
         return promptBox("Move to folder:");
     case FileManager::Prompt::NewFile:
         return promptBox("New file name:");
     case FileManager::Prompt::NewDir:
         return promptBox("New directory name:");
     case FileManager::Prompt::Delete:
-        return promptBox("Delete?", hbox({text(_fm.promptPath.filename().string()) | bold}));
+        return promptBox("Delete?", hbox({text(_fm.promptBatch.empty()
+                                                    ? _fm.promptPath.filename().string()
+                                                    : std::to_string(_fm.promptBatch.size()) +
+                                                          " selected items") |
+                                          bold}));
+    case FileManager::Prompt::DeleteForever:
+        return promptBox("No trash here. Delete for good?",
+                         hbox({text(_fm.promptBatch.size() == 1
+                                        ? _fm.promptBatch.front().filename().string()
+                                        : std::to_string(_fm.promptBatch.size()) + " items") |
+                               bold}));
     case FileManager::Prompt::Replace:
         return promptBox("Replace Existing File/Dir?",
                          hbox({text(_fm.promptPath.filename().string()) | bold}));
@@ -106,6 +189,24 @@ Element UI::createOverlay(const Element &main_view) {
         return createHelpOverlay(backdrop);
     case FileManager::Prompt::FzfMenu:
         return createFzfMenuOverlay(main_view);
+    case FileManager::Prompt::Fuzzy:
+        return createFuzzyOverlay(main_view);
+    case FileManager::Prompt::Grep:
+        return createGrepOverlay(main_view);
+    case FileManager::Prompt::Duplicates:
+        return createDuplicatesOverlay(main_view);
+    case FileManager::Prompt::CompareWith:
+        return promptBox("Compare current dir with:");
+    case FileManager::Prompt::Compare:
+        return createCompareOverlay(main_view);
+    case FileManager::Prompt::Sync: {
+        size_t n = _fm.syncItems().size();
+        return promptBox("Sync to " + _fm.compareRight.string() + "?",
+                         hbox({text("copy " + std::to_string(n) + " new or changed items") |
+                               bold}));
+    }
+    case FileManager::Prompt::Jobs:
+        return createJobsOverlay(main_view);
     case FileManager::Prompt::None:
     default:
         return main_view;
@@ -152,23 +253,30 @@ Element UI::createDriveSelectOverlay(const Element &main_view) {
 }
 
 Element UI::createHistoryOverlay(const Element &main_view) {
-    Element backdrop = main_view | dim;
+    constexpr size_t kVisibleRows = 20;
+    const JumpList &jump = _fm.jump;
+    const auto &results = jump.results();
 
+    size_t first = _fm.selHistIdx >= kVisibleRows ? _fm.selHistIdx - kVisibleRows + 1 : 0;
     Elements history_rows;
-    for (size_t i = 0; i < _fm.history.size(); ++i) {
-        fs::path absPath = _fm.history[i];
-        std::string display = formatHistoryPath(absPath, _fm.cwd);
-
-        auto h = text(" " + display + " ");
-        if (i == _fm.selHistIdx) { h = h | bgcolor(Color::BlueLight) | color(Color::Black) | bold; }
+    for (size_t i = first; i < results.size() && i < first + kVisibleRows; ++i) {
+        auto h = text(" " + jump.display(results[i]) + " ");
+        if (i == _fm.selHistIdx) h = h | bgcolor(Color::BlueLight) | color(Color::Black) | bold;
         history_rows.push_back(h);
     }
 
+    std::string status = " " + std::to_string(jump.matched()) + "/" + std::to_string(jump.size());
     auto history_window =
-        window(text(" History ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
-               vbox(history_rows));
-
-    return dbox({backdrop, center(history_window)});
+        window(text(" Jump ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
+               vbox({
+                   hbox({text("> ") | color(Color::Cyan), _fm.inputBox->Render()}),
+                   text(status) | dim,
+                   separator(),
+                   vbox(history_rows) | size(HEIGHT, EQUAL, kVisibleRows),
+               })) |
+        bgcolor(Color::Black) | size(WIDTH, EQUAL, 80);
+
+    return dbox({main_view | dim, center(history_window)});
 }
 
 Element UI::createErrorOverlay(const Element &main_view) {
@@ -228,13 +336,23 @@ Element UI::createHelpOverlay(const Element &main_view) {
         {"Y", "copy to system"},
         {"x", "cut"},
         {"p", "paste"},
+        {"b", "jobs"},
+        {"v", "select mode"},
+        {"d/m/y/x (select)", "act on selection"},
+        {"s", "cycle sort mode"},
+        {"S", "reverse sort"},
+        {"i", "timing stats"},
+        {"P", "preview pane"},
+        {"g", "search contents"},
+        {"D", "find duplicates"},
+        {"=", "compare with dir"},
         {"c", "change dir"},
         {"C", "change drive"},
         {"space", "file/dir-picker"},
         {"Return", "expand/collapse"},
         {"Esc", "collapse all"},
         {"q", "quit to last"},
-        {"^", "history"},
+        {"^", "jump to dir"},
         {"Ctrl+c", "quit"},
         {"?", "show help"},
     };
@@ -270,14 +388,375 @@ Element UI::createFzfMenuOverlay(const Element &main_view) {
     }
 
     auto fzf_window =
-        window(text(" FZF Menu ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
+        window(text(" Find Menu ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
                vbox(fzf_rows)) |
         bgcolor(Color::Black) | size(WIDTH, EQUAL, 50);
 
     return dbox({main_view | dim, center(fzf_window)});
 }
 
-Element UI::fileElement(const fs::path &p, bool isDir, const std::set<fs::path> &expandedDirs) {
+Element UI::createFuzzyOverlay(const Element &main_view) {
+    static const char *titles[] = {" Find (edit) ", " Find (open) ", " Find dir (cd) ",
+                                   " Find (copy path) ", " Find (copy file) "};
+    constexpr size_t kVisibleRows = 20;
+    const FuzzyFinder::Results &res = _fm.fuzzyResults;
+
+    size_t first = _fm.fuzzyIdx >= kVisibleRows ? _fm.fuzzyIdx - kVisibleRows + 1 : 0;
+    Elements result_rows;
+    for (size_t i = first; i < res.top.size() && i < first + kVisibleRows; ++i) {
+        std::string path = _fm.fuzzy.text(res.top[i].id);
+        std::vector<uint16_t> hl = FuzzyFinder::highlight(path, _fm.promptInput);
+
+        // Alternate plain and highlighted runs of the path
+        Elements parts;
+        size_t pos = 0, h = 0;
+        while (pos < path.size()) {
+            bool matched = h < hl.size() && hl[h] == pos;
+            size_t end = pos;
+            while (end < path.size() && (h < hl.size() && hl[h] == end) == matched) {
+                if (matched) ++h;
+                ++end;
+            }
+            Element part = text(path.substr(pos, end - pos));
+            parts.push_back(matched ? part | bold | color(Color::Yellow) : part);
+            pos = end;
+        }
+
+        Element row = hbox(std::move(parts));
+        if (i == _fm.fuzzyIdx) row = row | bgcolor(Color::BlueLight) | color(Color::Black);
+        result_rows.push_back(row);
+    }
+
+    std::string status = " " + std::to_string(res.matched) + "/" + std::to_string(res.total);
+    if (!res.done) status += " (scanning)";
+
+    auto fuzzy_window =
+        window(text(titles[static_cast<int>(_fm.fuzzyAction)]) | bold |
+                   bgcolor(Color::DarkGreen) | color(Color::White),
+               vbox({
+                   hbox({text("> ") | color(Color::Cyan), _fm.inputBox->Render()}),
+                   text(status) | dim,
+                   separator(),
+                   vbox(result_rows) | size(HEIGHT, EQUAL, kVisibleRows),
+               })) |
+        bgcolor(Color::Black) | size(WIDTH, EQUAL, 80);
+
+    return dbox({main_view | dim, center(fuzzy_window)});
+}
+
+Element UI::createGrepOverlay(const Element &main_view) {
+    constexpr size_t kVisibleRows = 20;
+    const auto &hits = _fm.grepHits;
+    const fs::path &base = _fm.grepRoots.size() == 1 ? _fm.grepRoots[0] : _fm.cwd;
+
+    size_t first = _fm.grepIdx >= kVisibleRows ? _fm.grepIdx - kVisibleRows + 1 : 0;
+    Elements result_rows;
+    for (size_t i = first; i < hits.size() && i < first + kVisibleRows; ++i) {
+        const ContentSearch::Hit &hit = hits[i];
+        std::string where = hit.file.lexically_relative(base).string();
+        if (where == ".") // the root is the file itself
+            where = hit.file.filename().string();
+        else if (where.empty() || where.starts_with(".."))
+            where = hit.file.string();
+        where += ":" + std::to_string(hit.line) + ": ";
+
+        const std::string &line = hit.text;
+        Element row = hbox({
+            text(where) | color(Color::Cyan),
+            text(line.substr(0, hit.matchAt)),
+            text(line.substr(hit.matchAt, hit.matchLen)) | bold | color(Color::Yellow),
+            text(line.substr(hit.matchAt + hit.matchLen)),
+        });
+        if (i == _fm.grepIdx) row = row | bgcolor(Color::BlueLight) | color(Color::Black);
+        result_rows.push_back(row);
+    }
+
+    std::string status = " " + std::to_string(hits.size()) + " hits, " +
+                         std::to_string(_fm.grepFiles) + " files searched";
+    if (_fm.grepCapped)
+        status += " (limit reached)";
+    else if (!_fm.grepDone)
+        status += " (searching)";
+
+    auto grep_window =
+        window(text(" Search contents ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
+               vbox({
+                   hbox({text("> ") | color(Color::Cyan), _fm.inputBox->Render()}),
+                   text(status) | dim,
+                   separator(),
+                   vbox(result_rows) | size(HEIGHT, EQUAL, kVisibleRows),
+                   separator(),
+                   text(" Return edit at line, Tab show in tree, Esc close") | dim,
+               })) |
+        bgcolor(Color::Black) | size(WIDTH, EQUAL, 100);
+
+    return dbox({main_view | dim, center(grep_window)});
+}
+
+Element UI::createDuplicatesOverlay(const Element &main_view) {
+    using Stage = DuplicateFinder::Stage;
+    constexpr size_t kVisibleRows = 20;
+    const DuplicateFinder::Status &st = _fm.dupStatus;
+
+    std::string status;
+    if (!st.error.empty()) {
+        status = " " + st.error;
+    } else if (st.stage == Stage::Scanning) {
+        status = " scanning: " + std::to_string(st.files) + " files";
+    } else if (st.stage != Stage::Done) {
+        status = st.stage == Stage::Edges ? " comparing file ends: " : " hashing: ";
+        status += formatSize(st.hashed) + " / " + formatSize(st.toHash);
+    } else {
+        std::uintmax_t reclaimable = 0;
+        for (const auto &g : st.groups) reclaimable += g.size * (g.copies - 1);
+        status = " " + std::to_string(st.groups.size()) + " groups in " +
+                 std::to_string(st.files) + " files, " + formatSize(reclaimable) +
+                 " reclaimable";
+    }
+    Element progress = text("");
+    if (st.stage == Stage::Edges || st.stage == Stage::Contents)
+        progress = gauge(st.toHash ? float(st.hashed) / float(st.toHash) : 0.f);
+
+    size_t first = _fm.dupIdx >= kVisibleRows ? _fm.dupIdx - kVisibleRows + 1 : 0;
+    Elements rows;
+    for (size_t i = first; i < _fm.dupRows.size() && i < first + kVisibleRows; ++i) {
+        const auto &[g, f] = _fm.dupRows[i];
+        const DuplicateFinder::Group &group = st.groups[g];
+        if (f == std::string::npos) {
+            rows.push_back(text(std::to_string(group.files.size()) + " x " +
+                                formatSize(group.size)) |
+                           bold | color(Color::Cyan));
+            continue;
+        }
+        const DuplicateFinder::File &file = group.files[f];
+        std::string where = file.path.lexically_relative(_fm.dupRoot).string();
+        if (where.empty() || where.starts_with("..")) where = file.path.string();
+        bool linked = std::count_if(group.files.begin(), group.files.end(), [&](const auto &o) {
+                          return o.copy == file.copy;
+                      }) > 1;
+        Element row = hbox({
+            text(_fm.dupMarked(file.path) ? " [x] " : " [ ] "),
+            text(where),
+            linked ? text(" (hard link)") | dim : text(""),
+        });
+        if (i == _fm.dupIdx) row = row | bgcolor(Color::BlueLight) | color(Color::Black);
+        rows.push_back(row);
+    }
+
+    auto dup_window =
+        window(text(" Duplicates ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
+               vbox({
+                   text(status) | dim,
+                   progress,
+                   separator(),
+                   vbox(std::move(rows)) | size(HEIGHT, EQUAL, kVisibleRows),
+                   separator(),
+                   text(" space mark  a mark all but one  d delete  L hard-link  Esc close") |
+                       dim,
+               })) |
+        bgcolor(Color::Black) | size(WIDTH, EQUAL, 90);
+
+    return dbox({main_view | dim, center(dup_window)});
+}
+
+Element UI::createCompareOverlay(const Element &main_view) {
+    using Kind = DirCompare::Kind;
+    constexpr size_t kVisibleRows = 20;
+    const DirCompare::Status &st = _fm.compareStatus;
+
+    std::string status;
+    if (!st.error.empty()) {
+        status = " " + st.error;
+    } else if (!st.done) {
+        status = " comparing: " + std::to_string(st.compared) + " entries";
+        if (st.bytesRead) status += ", " + formatSize(st.bytesRead) + " read";
+    } else {
+        size_t counts[3] = {};
+        for (const auto &diff : st.diffs) ++counts[static_cast<int>(diff.kind)];
+        status = " " + std::to_string(counts[0]) + " only here, " + std::to_string(counts[1]) +
+                 " only there, " + std::to_string(counts[2]) + " changed, " +
+                 std::to_string(st.same) + " same";
+    }
+
+    size_t first = _fm.compareIdx >= kVisibleRows ? _fm.compareIdx - kVisibleRows + 1 : 0;
+    Elements rows;
+    for (size_t i = first; i < st.diffs.size() && i < first + kVisibleRows; ++i) {
+        const DirCompare::Diff &diff = st.diffs[i];
+        static const std::pair<const char *, Color> marks[] = {
+            {"+ ", Color::Green}, {"- ", Color::RedLight}, {"~ ", Color::Yellow}};
+        const auto &[mark, markColor] = marks[static_cast<int>(diff.kind)];
+        Element row = hbox({
+            text(mark) | color(markColor),
+            text(diff.rel.string() + (diff.isDir ? "/" : "")),
+            filler(),
+            text(diff.isDir || diff.kind == Kind::OnlyRight ? "" : formatSize(diff.size)) | dim,
+        });
+        if (i == _fm.compareIdx) row = row | bgcolor(Color::BlueLight) | color(Color::Black);
+        rows.push_back(row);
+    }
+    if (st.done && st.error.empty() && st.diffs.empty())
+        rows.push_back(text(" no differences ") | dim | center);
+
+    auto compare_window =
+        window(text(" Compare ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
+               vbox({
+                   text(" " + _fm.compareLeft.string() + "  ->  " + _fm.compareRight.string()),
+                   text(status) | dim,
+                   separator(),
+                   vbox(std::move(rows)) | size(HEIGHT, EQUAL, kVisibleRows),
+                   separator(),
+                   text(" Return show  s sync to right  c clear  Esc close") | dim,
+               })) |
+        bgcolor(Color::Black) | size(WIDTH, EQUAL, 90);
+
+    return dbox({main_view | dim, center(compare_window)});
+}
+
+// One job: title and state, then a progress bar and detail line while it runs.
+Element UI::jobElement(const JobQueue::Status &job) {
+    static const char *states[] = {"queued", "running", "done", "failed", "cancelled"};
+    Elements lines;
+    lines.push_back(hbox({text(job.title), filler(),
+                          text(states[static_cast<int>(job.state)]) | dim}));
+    if (job.state == JobQueue::State::Running) {
+        const JobQueue::Progress &p = job.progress;
+        if (p.total)
+            lines.push_back(gauge(static_cast<float>(p.done) / p.total) | color(Color::Green));
+        if (!p.detail.empty()) lines.push_back(text(p.detail) | dim);
+    } else if (job.state == JobQueue::State::Failed) {
+        lines.push_back(text(job.error) | color(Color::RedLight));
+    }
+    return vbox(std::move(lines));
+}
+
+// Non-modal box in the bottom right corner listing the jobs in progress.
+Element UI::createJobStatus() {
+    constexpr size_t kShown = 3;
+    Elements rows;
+    size_t running = 0, queued = 0;
+    for (const auto &job : _fm.jobList) {
+        if (job.state == JobQueue::State::Running && running++ < kShown)
+            rows.push_back(jobElement(job));
+        if (job.state == JobQueue::State::Queued) ++queued;
+    }
+    if (running == 0 && queued == 0) return emptyElement();
+
+    std::string more;
+    if (running > kShown) more += std::to_string(running - kShown) + " more running  ";
+    if (queued) more += std::to_string(queued) + " queued  ";
+    rows.push_back(text(more + "b for jobs") | dim);
+
+    auto status_window =
+        window(text(" Jobs ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
+               vbox(std::move(rows))) |
+        bgcolor(Color::Black) | size(WIDTH, EQUAL, 50);
+
+    return vbox({filler(), hbox({filler(), status_window})});
+}
+
+// Head of the selected file or listing of the selected directory, as built by the Previewer.
+Element UI::createPreviewPane(int height) {
+    using Kind = Previewer::Preview::Kind;
+    const Previewer::Result &p = _fm.preview;
+    std::string title = " " + _fm.selEntryPath.filename().string() + " ";
+    size_t maxRows = static_cast<size_t>(std::max(height - 3, 1));
+
+    Elements rows;
+    std::string status;
+    if (!p) {
+        status = _fm.selEntryPath.empty() ? "" : "loading...";
+    } else {
+        switch (p->kind) {
+        case Kind::Text:
+            status = formatSize(p->size);
+            break;
+        case Kind::Binary:
+            status = formatSize(p->size) + ", binary";
+            break;
+        case Kind::Directory:
+            status = std::to_string(p->size) + (p->truncated ? "+" : "") + " entries";
+            break;
+        case Kind::Other:
+            status = "no preview";
+            break;
+        case Kind::Error:
+            status = p->error;
+            break;
+        }
+        for (size_t i = 0; i < p->lines.size() && rows.size() < maxRows; ++i)
+            rows.push_back(p->kind == Kind::Binary ? text(p->lines[i]) | dim : text(p->lines[i]));
+        for (size_t i = 0; i < p->entries.size() && rows.size() < maxRows; ++i) {
+            const Tree::Item &item = p->entries[i];
+            std::string_view ext = item.extPos == std::string::npos
+                                       ? std::string_view()
+                                       : std::string_view(item.name).substr(item.extPos);
+            rows.push_back(fileElement(item.name, ext, item.meta.isDir, false));
+        }
+        if (p->truncated && p->kind != Kind::Directory) status += " (head)";
+    }
+
+    return window(text(title) | bold | color(Color::Yellow),
+                  vbox({
+                      text(status) | dim,
+                      separator(),
+                      vbox(std::move(rows)) | flex,
+                  })) |
+           bgcolor(Color::Black);
+}
+
+// Non-modal box in the top right corner with the latest and p50/p99 timings of each hot path.
+Element UI::createStatsOverlay() {
+    auto ms = [](std::chrono::nanoseconds ns) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%8.2f", ns.count() / 1e6);
+        return text(buf);
+    };
+    Elements rows;
+    rows.push_back(hbox({text("ms") | size(WIDTH, EQUAL, 8), text("    last") | bold,
+                         text("     p50") | bold, text("     p99") | bold, filler(),
+                         text("count") | bold}));
+    for (unsigned t = 0; t < Stats::kTimers; ++t) {
+        Stats::Summary s = Stats::summary(static_cast<Stats::Timer>(t));
+        rows.push_back(hbox({text(Stats::name(static_cast<Stats::Timer>(t))) |
+                                 size(WIDTH, EQUAL, 8),
+                             ms(s.last), ms(s.p50) | dim, ms(s.p99), filler(),
+                             text(std::to_string(s.count)) | dim}));
+    }
+    rows.push_back(separator());
+    for (unsigned c = 0; c < Stats::kCounters; ++c) {
+        auto counter = static_cast<Stats::Counter>(c);
+        rows.push_back(hbox({text(Stats::name(counter)), filler(),
+                             text(std::to_string(Stats::counter(counter)))}));
+    }
+
+    auto stats_window =
+        window(text(" Stats ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
+               vbox(std::move(rows))) |
+        bgcolor(Color::Black) | size(WIDTH, EQUAL, 44);
+
+    return vbox({hbox({filler(), stats_window}), filler()});
+}
+
+Element UI::createJobsOverlay(const Element &main_view) {
+    Elements job_rows;
+    for (size_t i = 0; i < _fm.jobList.size(); ++i) {
+        Element row = jobElement(_fm.jobList[i]);
+        if (i == _fm.selJobIdx) row = row | bgcolor(Color::BlueLight) | color(Color::Black);
+        job_rows.push_back(row);
+    }
+    if (job_rows.empty()) job_rows.push_back(text(" no jobs ") | dim | center);
+    job_rows.push_back(separator());
+    job_rows.push_back(text("x cancel/dismiss  c clear failed  Esc close") | dim);
+
+    auto jobs_window =
+        window(text(" Jobs ") | bold | bgcolor(Color::DarkGreen) | color(Color::White),
+               vbox(std::move(job_rows))) |
+        bgcolor(Color::Black) | size(WIDTH, EQUAL, 70);
+
+    return dbox({main_view | dim, center(jobs_window)});
+}
+
+Element UI::fileElement(std::string_view name, std::string_view ext, bool isDir, bool expanded) {
     // Combined icon + color map
     static const std::unordered_map<std::string, std::pair<std::string, Color>> fileMap = {
         // C / C++ / C# / Obj-C
@@ -357,11 +836,10 @@ Element UI::fileElement(const fs::path &p, bool isDir, const std::set<fs::path>
     Color col;
 
     if (isDir) {
-        iconStr = expandedDirs.count(p) ? "📂 " : "📁 "; // open/closed folder
-        return text(iconStr + p.filename().string());
+        iconStr = expanded ? "📂 " : "📁 "; // open/closed folder
+        return text(iconStr + std::string(name));
     } else {
-        std::string ext = p.has_extension() ? p.extension().string() : "";
-        auto it = fileMap.find(ext);
+        auto it = fileMap.find(std::string(ext));
         if (it != fileMap.end()) {
             iconStr = it->second.first;
             col = it->second.second;
@@ -370,7 +848,7 @@ Element UI::fileElement(const fs::path &p, bool isDir, const std::set<fs::path>
             col = Color::White;
         }
     }
-    return text(iconStr + p.filename().string()) | color(col);
+    return text(iconStr + std::string(name)) | color(col);
 }
 UI::Layout UI::Layout::compute(int screen_width, int max_expanded_depth) {
     Layout layout;
@@ -0,0 +1,99 @@
+#include "UndoJournal.hpp"
+#include "Trash.hpp"
+
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+UndoJournal::UndoJournal() {
+    _thread = std::jthread([this](std::stop_token stop) { loop(stop); });
+}
+
+// Stopping still writes the last pending snapshot: loop() only exits once nothing is left.
+UndoJournal::~UndoJournal() {
+    _thread.request_stop();
+    _thread.join();
+}
+
+std::vector<UndoJournal::Record> UndoJournal::open(const fs::path &file) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _file = file;
+    }
+    std::vector<Record> records;
+    std::ifstream in(file);
+    if (!in) return records;
+    try {
+        json j;
+        in >> j;
+        for (const auto &r : j) {
+            Record record;
+            for (const auto &s : r)
+                record.push_back({s.at("type").get<std::string>(),
+                                  fs::path(s.at("source").get<std::string>()),
+                                  fs::path(s.at("target").get<std::string>())});
+            if (!record.empty()) records.push_back(std::move(record));
+        }
+    } catch (...) {
+        records.clear(); // unreadable: start with an empty history
+    }
+    return records;
+}
+
+void UndoJournal::save(std::vector<Record> records) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending = std::move(records);
+    }
+    _cv.notify_one();
+}
+
+void UndoJournal::purge(std::vector<fs::path> trashed) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _purge.insert(_purge.end(), trashed.begin(), trashed.end());
+    }
+    _cv.notify_one();
+}
+
+void UndoJournal::loop(std::stop_token stop) {
+    while (true) {
+        fs::path file;
+        std::optional<std::vector<Record>> records;
+        std::vector<fs::path> purge;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_cv.wait(lock, stop, [&] { return _pending || !_purge.empty(); })) return;
+            file = _file;
+            records.swap(_pending);
+            purge.swap(_purge);
+        }
+        if (records && !file.empty()) {
+            try {
+                write(file, *records);
+            } catch (const std::exception &) {} // the history is only a convenience
+        }
+        for (const auto &p : purge) Trash::purge(p);
+    }
+}
+
+// Written next to the target and renamed over it, so a crash never leaves half a journal.
+void UndoJournal::write(const fs::path &file, const std::vector<Record> &records) const {
+    json j = json::array();
+    for (const auto &record : records) {
+        json r = json::array();
+        for (const auto &s : record)
+            r.push_back({{"type", s.type}, {"source", s.source.string()},
+                         {"target", s.target.string()}});
+        j.push_back(std::move(r));
+    }
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << j.dump();
+        if (!out) throw std::runtime_error("cannot write " + tmp.string());
+    }
+    fs::rename(tmp, file);
+}
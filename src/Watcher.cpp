@@ -0,0 +1,151 @@
+#include "Watcher.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                                IN_CLOSE_WRITE | IN_MODIFY | IN_DELETE_SELF | IN_ONLYDIR |
+                                IN_EXCL_UNLINK;
+// Events arriving within this window of each other are delivered as one batch.
+constexpr int kCoalesceMs = 30;
+constexpr int kMaxBatchMs = 150;
+} // namespace
+
+Watcher::Watcher(Callback callback) : _callback(std::move(callback)) {
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    _wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_fd < 0 || _wakeFd < 0) return;
+    _thread = std::thread([this] { loop(); });
+}
+
+Watcher::~Watcher() {
+    if (_thread.joinable()) {
+        uint64_t one = 1;
+        (void)!write(_wakeFd, &one, sizeof(one));
+        _thread.join();
+    }
+    if (_fd >= 0) close(_fd);
+    if (_wakeFd >= 0) close(_wakeFd);
+}
+
+bool Watcher::active() const { return _thread.joinable(); }
+
+void Watcher::setDirs(const std::set<fs::path> &dirs) {
+    if (!active()) return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _watches.begin(); it != _watches.end();) {
+        auto next = std::next(it);
+        if (!dirs.count(it->first)) remove(it);
+        it = next;
+    }
+    for (const auto &dir : dirs) add(dir);
+}
+
+void Watcher::addDirs(const std::set<fs::path> &dirs) {
+    if (!active()) return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &dir : dirs) add(dir);
+}
+
+void Watcher::removeDirs(const std::set<fs::path> &dirs) {
+    if (!active()) return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &dir : dirs)
+        if (auto it = _watches.find(dir); it != _watches.end()) remove(it);
+}
+
+void Watcher::add(const fs::path &dir) {
+    if (_watches.count(dir)) return;
+    int wd = inotify_add_watch(_fd, dir.c_str(), kWatchMask);
+    if (wd < 0) return;
+    _watches[dir] = wd;
+    _paths[wd] = dir;
+}
+
+void Watcher::remove(std::map<fs::path, int>::iterator it) {
+    inotify_rm_watch(_fd, it->second);
+    _paths.erase(it->second);
+    _watches.erase(it);
+}
+
+void Watcher::loop() {
+    alignas(inotify_event) char buf[64 * 1024];
+    pollfd fds[2] = {{_fd, POLLIN, 0}, {_wakeFd, POLLIN, 0}};
+
+    while (true) {
+        std::vector<FsChange> batch;
+        int timeout = -1, waited = 0;
+
+        while (true) {
+            int ready = poll(fds, 2, timeout);
+            if (ready < 0) continue;
+            if (fds[1].revents & POLLIN) return;
+            if (ready == 0) break; // quiet for kCoalesceMs: deliver what we have
+
+            ssize_t len;
+            while ((len = read(_fd, buf, sizeof(buf))) > 0) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (char *p = buf; p < buf + len;) {
+                    auto *ev = reinterpret_cast<inotify_event *>(p);
+                    p += sizeof(inotify_event) + ev->len;
+
+                    if (ev->mask & IN_Q_OVERFLOW) {
+                        batch.push_back({FsChange::Kind::Overflow, {}});
+                        continue;
+                    }
+                    auto it = _paths.find(ev->wd);
+                    if (it == _paths.end()) continue;
+                    if (ev->mask & IN_IGNORED) {
+                        _watches.erase(it->second);
+                        _paths.erase(it);
+                        continue;
+                    }
+                    if (ev->mask & IN_DELETE_SELF) {
+                        batch.push_back({FsChange::Kind::Removed, it->second});
+                        continue;
+                    }
+
+                    fs::path path = it->second / ev->name;
+                    if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+                        batch.push_back({FsChange::Kind::Created, path});
+                    else if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+                        batch.push_back({FsChange::Kind::Removed, path});
+                    else
+                        batch.push_back({FsChange::Kind::Modified, path});
+                }
+            }
+
+            waited += timeout < 0 ? 0 : timeout;
+            if (waited >= kMaxBatchMs) break;
+            timeout = kCoalesceMs;
+        }
+
+        // Collapse repeated notifications for the same path (e.g. a burst of IN_MODIFY).
+        std::vector<FsChange> changes;
+        for (auto &c : batch) {
+            bool dup = !changes.empty() && changes.back().kind == c.kind &&
+                       changes.back().path == c.path;
+            if (!dup) changes.push_back(std::move(c));
+        }
+        if (!changes.empty()) _callback(std::move(changes));
+    }
+}
+
+#else
+
+Watcher::Watcher(Callback callback) : _callback(std::move(callback)) {}
+Watcher::~Watcher() = default;
+bool Watcher::active() const { return false; }
+void Watcher::setDirs(const std::set<fs::path> &) {}
+void Watcher::addDirs(const std::set<fs::path> &) {}
+void Watcher::removeDirs(const std::set<fs::path> &) {}
+void Watcher::loop() {}
+
+#endif
@@ -0,0 +1,127 @@
+#include "ContentSearch.hpp"
+#include "Test.hpp"
+
+#include <mutex>
+#include <tuple>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace {
+std::vector<ContentSearch::Hit> search(std::vector<fs::path> roots, std::string query) {
+    std::mutex mutex;
+    std::vector<ContentSearch::Hit> hits;
+    bool done = false;
+    ContentSearch grep([&](ContentSearch::Results results) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &hit : results.hits) hits.push_back(std::move(hit));
+        done = results.done;
+    });
+    grep.start(std::move(roots), std::move(query));
+    CHECK(waitFor([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return done;
+    }));
+    std::lock_guard<std::mutex> lock(mutex);
+    std::sort(hits.begin(), hits.end(), [](const auto &a, const auto &b) {
+        return std::tie(a.file, a.line) < std::tie(b.file, b.line);
+    });
+    return hits;
+}
+
+struct Expected {
+    uint32_t line;
+    std::string text;
+};
+
+// Each line holding `needle`, as the search should report it (short lines only).
+std::vector<Expected> linesWith(const std::string &text, const std::string &needle) {
+    std::vector<Expected> out;
+    uint32_t line = 1;
+    for (size_t start = 0; start < text.size();) {
+        size_t end = std::min(text.find('\n', start), text.size());
+        std::string_view l(text.data() + start, end - start);
+        if (l.find(needle) != std::string_view::npos) out.push_back({line, std::string(l)});
+        start = end + 1;
+        ++line;
+    }
+    return out;
+}
+
+void checkHits(const std::vector<ContentSearch::Hit> &hits, const std::vector<Expected> &expected,
+               const std::string &needle) {
+    CHECK(hits.size() == expected.size());
+    size_t wrong = 0;
+    for (size_t i = 0; i < std::min(hits.size(), expected.size()); ++i) {
+        const ContentSearch::Hit &h = hits[i];
+        if (h.line != expected[i].line || h.text != expected[i].text ||
+            h.text.compare(h.matchAt, h.matchLen, needle) != 0)
+            ++wrong;
+    }
+    CHECK(wrong == 0);
+}
+} // namespace
+
+// Files over the 4 MiB window are read in several; matches on and next to each window edge
+// must be found once, on the right line.
+TEST(contentSearchWindowEdges) {
+    Scratch scratch("grep-edges");
+    const std::string needle = "needle-0123456789-0123456789";
+    const size_t mib = 1 << 20;
+    std::string text;
+    text.reserve(9 * mib);
+    auto filler = [&](size_t upTo) {
+        while (text.size() < upTo) text += "the quick brown fox jumps over the lazy dog\n";
+    };
+    // Around each edge, short lines of varying width that are mostly needle, so some match
+    // ends up straddling the edge wherever exactly it falls.
+    for (size_t edge : {4 * mib, 8 * mib}) {
+        filler(edge - 700);
+        for (int i = 0; text.size() < edge + 700; ++i)
+            text += std::string(static_cast<size_t>(i % 5), '.') + needle + "\n";
+    }
+    filler(9 * mib);
+    writeFile(scratch.dir / "big.txt", text);
+
+    checkHits(search({scratch.dir}, needle), linesWith(text, needle), needle);
+}
+
+// A hit ends the search of its line, also when the line runs on past the window.
+TEST(contentSearchLongLines) {
+    Scratch scratch("grep-long");
+    const size_t mib = 1 << 20;
+    std::string text = "first match here\n";
+    text += "start " + std::string(3 * mib, 'a') + " match " + std::string(3 * mib, 'b') +
+            " match again, same line\n";
+    text += "x\nmatch after the long line\n";
+    writeFile(scratch.dir / "long.txt", text);
+
+    std::vector<ContentSearch::Hit> hits = search({scratch.dir / "long.txt"}, "match");
+    CHECK(hits.size() == 3);
+    if (hits.size() != 3) return;
+    CHECK(hits[0].line == 1 && hits[0].text == "first match here");
+    CHECK(hits[1].line == 2);
+    CHECK(hits[1].text.compare(hits[1].matchAt, hits[1].matchLen, "match") == 0);
+    CHECK(hits[1].text.rfind("…" + std::string(39, 'a') + " match ", 0) == 0); // some context
+    CHECK(hits[2].line == 4 && hits[2].text == "match after the long line");
+}
+
+TEST(contentSearchSkips) {
+    Scratch scratch("grep-skips");
+    writeFile(scratch.dir / "text.txt", "a needle\r\nnone\nneedle again");
+    writeFile(scratch.dir / "binary.bin", std::string("needle\0", 7) + "needle\n");
+    writeFile(scratch.dir / "node_modules" / "dep.js", "needle");
+    writeFile(scratch.dir / "empty", "");
+#ifndef _WIN32
+    // Opening a fifo for reading would wait for a writer that never comes.
+    ::mkfifo((scratch.dir / "fifo").c_str(), 0600);
+    fs::create_symlink("fifo", scratch.dir / "to-fifo");
+#endif
+    std::vector<ContentSearch::Hit> hits = search({scratch.dir}, "needle");
+    CHECK(hits.size() == 2);
+    for (const auto &h : hits) CHECK(h.file == scratch.dir / "text.txt");
+    if (hits.size() != 2) return;
+    CHECK(hits[0].line == 1 && hits[0].text == "a needle"); // without the \r
+    CHECK(hits[1].line == 3 && hits[1].text == "needle again");
+}
@@ -0,0 +1,123 @@
+#include "CopyEngine.hpp"
+#include "Test.hpp"
+
+#include <map>
+
+namespace {
+using Items = std::vector<std::pair<fs::path, fs::path>>;
+
+// Regular files of sizes around the read/write buffer and the kernel chunk, a symlink and
+// an empty directory.
+void makeTree(const fs::path &root) {
+    writeFile(root / "empty", "");
+    writeFile(root / "small", "x");
+    writeFile(root / "a" / "mib", bytes((1 << 20) + 123));
+    writeFile(root / "a" / "b" / "big", bytes((9 << 20) + 7));
+    fs::create_directories(root / "a" / "hollow");
+    fs::create_symlink(fs::path("a") / "mib", root / "link");
+    fs::permissions(root / "small", fs::perms::owner_exec, fs::perm_options::add);
+}
+
+// Relative path to contents (or the target, for symlinks).
+std::map<fs::path, std::string> snapshot(const fs::path &root) {
+    std::map<fs::path, std::string> out;
+    for (const auto &e : fs::recursive_directory_iterator(root)) {
+        fs::path rel = e.path().lexically_relative(root);
+        if (e.is_symlink())
+            out[rel] = "-> " + fs::read_symlink(e.path()).string();
+        else if (e.is_directory())
+            out[rel] = "dir";
+        else
+            out[rel] = readFile(e.path());
+    }
+    return out;
+}
+
+void checkCopy(const fs::path &scratch, const fs::path &to) {
+    fs::path from = scratch / "from";
+    makeTree(from);
+    CopyEngine::Progress last;
+    CopyEngine engine([&](const CopyEngine::Progress &p) { last = p; }, 2);
+    CHECK(engine.run(from, to, {}));
+    CHECK(snapshot(to) == snapshot(from));
+    CHECK(fs::is_symlink(to / "link"));
+    CHECK(fs::status(to / "small").permissions() == fs::status(from / "small").permissions());
+    CHECK(!last.planning);
+    CHECK(last.filesTotal == 5 && last.filesDone == 5);
+    CHECK(last.bytesDone == last.bytesTotal);
+    CHECK(last.bytesTotal == fs::file_size(from / "small") + fs::file_size(from / "a" / "mib") +
+                                 fs::file_size(from / "a" / "b" / "big"));
+}
+} // namespace
+
+TEST(copyTree) {
+    Scratch scratch("copy");
+    checkCopy(scratch.dir, scratch.dir / "to");
+}
+
+// Across filesystems reflinks and, on older kernels, copy_file_range fail and the copy falls
+// back to the next mechanism. Skipped when there is no second filesystem to copy to.
+TEST(copyTreeAcrossDevices) {
+    Scratch scratch("copy-devices");
+    fs::path other = "/dev/shm";
+    std::error_code ec;
+    if (!fs::is_directory(other, ec)) return;
+    fs::path to = other / "FileManagerTests-copy-devices";
+    fs::remove_all(to, ec);
+    checkCopy(scratch.dir, to);
+    fs::remove_all(to, ec);
+}
+
+TEST(copyRefusesExisting) {
+    Scratch scratch("copy-exists");
+    writeFile(scratch.dir / "a", "a");
+    writeFile(scratch.dir / "b", "b");
+    writeFile(scratch.dir / "taken", "keep");
+    CopyEngine engine([](const CopyEngine::Progress &) {});
+    bool threw = false;
+    try {
+        engine.run(Items{{scratch.dir / "a", scratch.dir / "a2"},
+                         {scratch.dir / "b", scratch.dir / "taken"}},
+                   {});
+    } catch (const fs::filesystem_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(!fs::exists(scratch.dir / "a2")); // checked before anything is copied
+    CHECK(readFile(scratch.dir / "taken") == "keep");
+}
+
+TEST(copyRollsBackWhenStopped) {
+    Scratch scratch("copy-stop");
+    makeTree(scratch.dir / "from");
+    writeFile(scratch.dir / "file", "f");
+    std::stop_source stop;
+    CopyEngine engine([&](const CopyEngine::Progress &p) {
+        if (!p.planning) stop.request_stop();
+    });
+    CHECK(!engine.run(Items{{scratch.dir / "from", scratch.dir / "to"},
+                            {scratch.dir / "file", scratch.dir / "file2"}},
+                      stop.get_token()));
+    CHECK(!fs::exists(scratch.dir / "to"));
+    CHECK(!fs::exists(scratch.dir / "file2"));
+    CHECK(fs::exists(scratch.dir / "from" / "a" / "b" / "big"));
+}
+
+TEST(copyRollsBackOnFailure) {
+    Scratch scratch("copy-fail");
+    fs::path from = scratch.dir / "from";
+    makeTree(from);
+    // The source loses a file between planning and copying.
+    CopyEngine engine([&](const CopyEngine::Progress &p) {
+        if (!p.planning) fs::remove(from / "a" / "b" / "big");
+    });
+    bool threw = false;
+    try {
+        engine.run(from, scratch.dir / "to", {});
+    } catch (const fs::filesystem_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(!fs::exists(scratch.dir / "to"));
+    CHECK(fs::exists(from / "a" / "mib"));
+}
@@ -0,0 +1,94 @@
+#include "DirCompare.hpp"
+#include "Test.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace {
+std::optional<DirCompare::Status> compare(const fs::path &left, const fs::path &right) {
+    std::mutex mutex;
+    std::optional<DirCompare::Status> done;
+    DirCompare diff([&](DirCompare::Status status) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (status.done) done = std::move(status);
+    });
+    diff.start(left, right);
+    CHECK(waitFor([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return done.has_value();
+    }));
+    std::lock_guard<std::mutex> lock(mutex);
+    return done;
+}
+
+// Writes the same name on both sides, the right one a minute newer unless `sameTime`.
+void writeBoth(const fs::path &left, const fs::path &right, const fs::path &rel,
+               const std::string &a, const std::string &b, bool sameTime = false) {
+    writeFile(left / rel, a);
+    writeFile(right / rel, b);
+    auto t = fs::last_write_time(left / rel);
+    fs::last_write_time(right / rel, sameTime ? t : t + std::chrono::minutes(1));
+}
+} // namespace
+
+TEST(dirCompareKinds) {
+    Scratch scratch("compare");
+    fs::path l = scratch.dir / "left", r = scratch.dir / "right";
+    std::string big = bytes(DirCompare::kBlock + 100), bigChanged = big;
+    bigChanged[DirCompare::kBlock + 50] ^= 1;
+
+    writeFile(l / "only-left", "l");
+    writeFile(r / "only-right", "r");
+    writeFile(l / "left-dir" / "a", "a");
+    writeFile(l / "left-dir" / "b" / "c", "c");
+    fs::create_directories(r / "right-dir");
+    writeBoth(l, r, "size", "12", "123");
+    writeBoth(l, r, "content", "abc", "abd");
+    writeBoth(l, r, "touched", "abc", "abc");
+    writeBoth(l, r, "quick-check", "abc", "abd", true); // equal size and mtime: not read
+    writeBoth(l, r, fs::path("sub") / "big", big, bigChanged);
+    writeBoth(l, r, fs::path("sub") / "big-same", big, big);
+    writeBoth(l, r, "empty", "", "");
+    writeFile(l / "kind", "file");
+    fs::create_directories(r / "kind");
+    fs::create_symlink("a", l / "link");
+    fs::create_symlink("b", r / "link");
+    fs::create_symlink("a", l / "link-same");
+    fs::create_symlink("a", r / "link-same");
+
+    std::optional<DirCompare::Status> status = compare(l, r);
+    CHECK(status && status->error.empty());
+    if (!status) return;
+    std::map<fs::path, DirCompare::Diff> diffs;
+    for (const auto &d : status->diffs) diffs.emplace(d.rel, d);
+    CHECK(diffs.size() == status->diffs.size()); // each reported once
+    CHECK(std::is_sorted(status->diffs.begin(), status->diffs.end(),
+                         [](const auto &a, const auto &b) { return a.rel < b.rel; }));
+
+    using Kind = DirCompare::Kind;
+    auto is = [&](const fs::path &rel, Kind kind, bool isDir = false) {
+        auto it = diffs.find(rel);
+        return it != diffs.end() && it->second.kind == kind && it->second.isDir == isDir;
+    };
+    CHECK(is("only-left", Kind::OnlyLeft) && diffs["only-left"].size == 1);
+    CHECK(is("only-right", Kind::OnlyRight));
+    CHECK(is("left-dir", Kind::OnlyLeft, true));
+    CHECK(is("right-dir", Kind::OnlyRight, true));
+    CHECK(is("size", Kind::Changed));
+    CHECK(is("content", Kind::Changed));
+    CHECK(is(fs::path("sub") / "big", Kind::Changed));
+    CHECK(is("kind", Kind::Changed));
+    CHECK(is("link", Kind::Changed));
+    CHECK(diffs.size() == 9); // nothing inside left-dir, and none of the same files
+    CHECK(!diffs.count("touched") && !diffs.count("quick-check") && !diffs.count("link-same"));
+    CHECK(status->same == 5); // touched, quick-check, big-same, empty, link-same
+    CHECK(status->bytesRead > 0);
+}
+
+TEST(dirCompareMissingRoot) {
+    Scratch scratch("compare-missing");
+    fs::create_directories(scratch.dir / "left");
+    std::optional<DirCompare::Status> status =
+        compare(scratch.dir / "left", scratch.dir / "missing");
+    CHECK(status && !status->error.empty());
+}
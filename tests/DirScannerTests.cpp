@@ -0,0 +1,100 @@
+#include "DirScanner.hpp"
+#include "Test.hpp"
+
+#include <map>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace {
+std::map<std::string, Tree::Meta> scan(const fs::path &dir, unsigned fields) {
+    std::map<std::string, Tree::Meta> out;
+    DirScanner scanner(dir, fields);
+    DirScanner::Entry entry;
+    while (scanner.next(entry)) {
+        CHECK(!out.count(std::string(entry.name)));
+        out[std::string(entry.name)] = entry.meta;
+    }
+    return out;
+}
+
+// What the scanner should report for `path`, from std::filesystem.
+Tree::Meta expected(const fs::path &path, unsigned fields) {
+    Tree::Meta m;
+    m.type = fs::symlink_status(path).type();
+    std::error_code ec; // a symlink loop is reported as broken, not thrown
+    fs::file_status target = fs::status(path, ec);
+    m.isDir = fs::is_directory(target);
+    m.brokenLink = m.type == fs::file_type::symlink && !fs::exists(target);
+    if ((fields & DirScanner::Size) && fs::is_regular_file(target)) m.size = fs::file_size(path);
+    if ((fields & DirScanner::Mtime) && fs::exists(target)) m.mtime = fs::last_write_time(path);
+    return m;
+}
+
+bool same(const Tree::Meta &a, const Tree::Meta &b) {
+    return a.type == b.type && a.isDir == b.isDir && a.brokenLink == b.brokenLink &&
+           a.size == b.size && a.mtime == b.mtime;
+}
+} // namespace
+
+TEST(dirScannerMatchesFilesystem) {
+    Scratch scratch("scanner");
+    fs::path dir = scratch.dir / "d";
+    writeFile(dir / "file", "12345");
+    writeFile(dir / "empty", "");
+    fs::create_directories(dir / "sub" / "inner");
+    fs::create_symlink("file", dir / "to-file");
+    fs::create_symlink("sub", dir / "to-dir");
+    fs::create_symlink("missing", dir / "broken");
+    fs::create_symlink("loop", dir / "loop");
+#ifndef _WIN32
+    ::mkfifo((dir / "fifo").c_str(), 0600);
+#endif
+    // Enough entries with long names to take several reads of the directory.
+    for (int i = 0; i < 3000; ++i) {
+        std::string n = std::to_string(i);
+        fs::path p = dir / (n + std::string(250 - n.size(), 'x'));
+        if (i % 10)
+            writeFile(p, std::string(static_cast<size_t>(i % 7), 'y'));
+        else
+            fs::create_directory(p);
+    }
+
+    for (unsigned fields : {0u, unsigned(DirScanner::Size), unsigned(DirScanner::Mtime),
+                            unsigned(DirScanner::Size | DirScanner::Mtime)}) {
+        std::map<std::string, Tree::Meta> got = scan(dir, fields);
+        size_t count = 0, mismatches = 0;
+        for (const auto &e : fs::directory_iterator(dir)) {
+            ++count;
+            auto it = got.find(e.path().filename().string());
+            if (it == got.end() || !same(it->second, expected(e.path(), fields))) ++mismatches;
+        }
+        CHECK(got.size() == count);
+        CHECK(mismatches == 0);
+        CHECK(!got.count(".") && !got.count(".."));
+        CHECK(got.count("to-dir") && got["to-dir"].isDir);
+        CHECK(got.count("broken") && got["broken"].brokenLink);
+        CHECK(got.count("loop") && got["loop"].brokenLink);
+    }
+    CHECK(scan(dir / "sub" / "inner", 0).empty());
+}
+
+TEST(dirScannerErrors) {
+    Scratch scratch("scanner-errors");
+    writeFile(scratch.dir / "file", "x");
+    for (const fs::path &p : {scratch.dir / "missing", scratch.dir / "file"}) {
+        std::error_code ec;
+        DirScanner scanner(p, 0, ec);
+        CHECK(ec.value() != 0);
+        DirScanner::Entry entry;
+        CHECK(!scanner.next(entry));
+        bool threw = false;
+        try {
+            DirScanner throwing(p);
+        } catch (const fs::filesystem_error &) {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+}
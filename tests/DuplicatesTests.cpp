@@ -0,0 +1,61 @@
+#include "Duplicates.hpp"
+#include "Test.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace {
+std::vector<DuplicateFinder::Group> findDuplicates(const fs::path &root) {
+    std::mutex mutex;
+    std::optional<DuplicateFinder::Status> done;
+    DuplicateFinder finder([&](DuplicateFinder::Status status) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (status.stage == DuplicateFinder::Stage::Done) done = std::move(status);
+    });
+    finder.start(root);
+    bool finished = waitFor([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return done.has_value();
+    });
+    CHECK(finished);
+    std::lock_guard<std::mutex> lock(mutex);
+    return done ? done->groups : std::vector<DuplicateFinder::Group>{};
+}
+} // namespace
+
+TEST(duplicatesHardLinks) {
+    Scratch scratch("duplicates");
+    const fs::path &dir = scratch.dir;
+    const size_t size = 3 * DuplicateFinder::kEdgeBytes;
+    std::string contents = bytes(size);
+    writeFile(dir / "a", contents);
+    writeFile(dir / "sub" / "b", contents);
+    fs::create_hard_link(dir / "a", dir / "sub" / "a-link");
+    // Same size and edges, one byte apart in the middle: only the full hash tells.
+    std::string middle = contents;
+    middle[size / 2] ^= 1;
+    writeFile(dir / "c", middle);
+    // Two names for one file are not duplicates of anything.
+    writeFile(dir / "d", "only one copy");
+    fs::create_hard_link(dir / "d", dir / "d-link");
+    writeFile(dir / "empty1", "");
+    writeFile(dir / "empty2", "");
+    fs::create_symlink(dir / "a", dir / "a-symlink");
+
+    std::vector<DuplicateFinder::Group> groups = findDuplicates(dir);
+    CHECK(groups.size() == 1);
+    if (groups.size() != 1) return;
+    const DuplicateFinder::Group &group = groups[0];
+    CHECK(group.size == size);
+    CHECK(group.copies == 2);
+    std::map<fs::path, uint32_t> copyOf;
+    for (const auto &f : group.files) copyOf[f.path] = f.copy;
+    CHECK(copyOf.size() == 3);
+    CHECK(copyOf.count(dir / "a") && copyOf.count(dir / "sub" / "a-link") &&
+          copyOf.count(dir / "sub" / "b"));
+    CHECK(copyOf[dir / "a"] == copyOf[dir / "sub" / "a-link"]);
+    CHECK(copyOf[dir / "a"] != copyOf[dir / "sub" / "b"]);
+    for (const auto &[path, copy] : copyOf) CHECK(copy < group.copies);
+    CHECK(std::is_sorted(group.files.begin(), group.files.end(),
+                         [](const auto &x, const auto &y) { return x.path < y.path; }));
+}
@@ -0,0 +1,40 @@
+#include "Hash.hpp"
+#include "Test.hpp"
+
+// Digests from the reference xxHash implementation.
+
+TEST(hashKnownAnswers) {
+    auto of = [](const std::string &s, uint64_t seed = 0) {
+        return Hash64::of(s.data(), s.size(), seed);
+    };
+    CHECK(of("") == 0xEF46DB3751D8E999ull);
+    CHECK(of("a") == 0xD24EC4F1A98C6E5Bull);
+    CHECK(of("abc") == 0x44BC2CF5AD770999ull);
+    CHECK(of("The quick brown fox jumps over the lazy dog") == 0x0B242D361FDA71BCull);
+    CHECK(of("abc", 0x9E3779B1) == 0x1318DF30094A85FDull);
+    CHECK(of(bytes(31)) == 0xA2AA5F33CC4A6119ull); // one byte short of a stripe
+    CHECK(of(bytes(32)) == 0x23C3C17EF790FD97ull);
+    CHECK(of(bytes(1000)) == 0x5F235FA033F1A3FBull);
+    CHECK(of(bytes(1000), 12345) == 0x365C39A0C5A4C88Eull);
+}
+
+TEST(hashSplitUpdates) {
+    const std::string data = bytes(1000);
+    const uint64_t expected = 0x5F235FA033F1A3FBull;
+    for (size_t chunk = 1; chunk <= 70; ++chunk) {
+        Hash64 hash;
+        for (size_t off = 0; off < data.size(); off += chunk)
+            hash.update(data.data() + off, std::min(chunk, data.size() - off));
+        CHECK(hash.digest() == expected);
+    }
+    // Uneven pieces, empty ones included, crossing stripe boundaries at every offset.
+    Hash64 hash;
+    size_t off = 0;
+    for (size_t n : {0, 5, 27, 0, 33, 1, 64, 100, 3, 31, 32}) {
+        hash.update(data.data() + off, n);
+        off += n;
+    }
+    hash.update(data.data() + off, data.size() - off);
+    CHECK(hash.digest() == expected);
+    CHECK(hash.digest() == expected); // digest() leaves the state alone
+}
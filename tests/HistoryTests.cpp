@@ -0,0 +1,45 @@
+#include "History.hpp"
+#include "Test.hpp"
+
+TEST(historyScores) {
+    Scratch scratch("history");
+    fs::path log = scratch.dir / "history.log";
+    int64_t now = unixNow(), day = 86400;
+    writeFile(log, std::to_string(now - 14 * day) + "\t2\t/one\n" +          // half life
+                       std::to_string(now - 28 * day) + "\t4\t/one\n" +      // two
+                       std::to_string(now + day) + "\t1\t/two\n" +           // clock skew
+                       "garbage line\n" + "12\tx\t/three\n" + "\t\t\n");
+    History history(log);
+    history.visit("/two", 0.5);
+
+    std::vector<History::Entry> entries = history.load();
+    CHECK(entries.size() == 2);
+    if (entries.size() != 2) return;
+    CHECK(entries[0].dir == "/one" && near(entries[0].score, 2));
+    CHECK(entries[1].dir == "/two" && near(entries[1].score, 1.5));
+}
+
+TEST(historyCompaction) {
+    Scratch scratch("compaction");
+    fs::path log = scratch.dir / "history.log";
+    int64_t now = unixNow(), day = 86400;
+    std::string lines = std::to_string(now - 365 * day) + "\t1\t/old\n";
+    for (int i = 0; i < 400; ++i)
+        lines += std::to_string(now - i * 3600) + "\t1\t/d" + std::to_string(i % 3) + "\n";
+    writeFile(log, lines);
+
+    History history(log);
+    std::vector<History::Entry> before = history.load(); // due: rewrites the log
+    CHECK(before.size() == 4);
+    std::vector<History::Entry> after = history.load();
+    CHECK(after.size() == 3); // /old decayed below kMinScore
+    for (size_t i = 0; i < std::min<size_t>(after.size(), 3); ++i) {
+        CHECK(after[i].dir == before[i].dir);
+        CHECK(near(after[i].score, before[i].score));
+    }
+    std::ifstream in(log);
+    size_t count = 0;
+    for (std::string line; std::getline(in, line);) ++count;
+    CHECK(count == 3);
+    CHECK(!fs::exists(scratch.dir / "history.log.tmp"));
+}
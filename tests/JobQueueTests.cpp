@@ -0,0 +1,120 @@
+#include "JobQueue.hpp"
+#include "Test.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+namespace {
+// What the jobs of one test did, in order, and the final state of each.
+struct Log {
+    std::mutex mutex;
+    std::vector<std::string> events;
+    std::map<uint64_t, JobQueue::Status> finished;
+    std::vector<std::function<void()>> completions;
+
+    void add(std::string event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(std::move(event));
+    }
+    bool has(const std::string &event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::find(events.begin(), events.end(), event) != events.end();
+    }
+    // Position of an event, or events.size() if it did not happen.
+    size_t at(const std::string &event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::find(events.begin(), events.end(), event) - events.begin();
+    }
+    size_t finishedCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return finished.size();
+    }
+};
+
+JobQueue::Callback recordInto(Log &log) {
+    return [&log](const JobQueue::Status &status, JobQueue::Completion done) {
+        if (status.state == JobQueue::State::Queued || status.state == JobQueue::State::Running)
+            return;
+        std::lock_guard<std::mutex> lock(log.mutex);
+        log.finished[status.id] = status;
+        if (done) log.completions.push_back(std::move(done));
+    };
+}
+} // namespace
+
+TEST(jobQueueOverlapOrder) {
+    Log log;
+    std::atomic<bool> release{false};
+    JobQueue queue(recordInto(log), 4);
+    auto job = [&](std::string name, bool block = false) -> JobQueue::Work {
+        return [&log, &release, name, block](std::stop_token, const JobQueue::Report &) {
+            log.add(name + " start");
+            if (block) waitFor([&] { return release.load(); });
+            log.add(name + " end");
+            return JobQueue::Completion{};
+        };
+    };
+    fs::path r = "/jobs";
+    queue.submit("a", {r / "x/"}, job("a", true)); // trailing separator
+    CHECK(waitFor([&] { return log.has("a start"); }));
+    queue.submit("b", {r / "x" / "y"}, job("b"));   // below a
+    queue.submit("c", {r / "z"}, job("c"));         // unrelated
+    queue.submit("d", {r / "xy"}, job("d"));        // shares a prefix of the name only
+    queue.submit("f", {r / "z" / "w"}, job("f"));   // below c
+    queue.submit("e", {r / "q", r}, job("e"));      // above all of them
+    CHECK(waitFor([&] { return log.has("c end") && log.has("d end") && log.has("f end"); }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!log.has("b start"));
+    CHECK(!log.has("e start"));
+    release = true;
+    CHECK(waitFor([&] { return log.finishedCount() == 6; }));
+
+    CHECK(log.at("a end") < log.at("b start"));
+    CHECK(log.at("b end") < log.at("e start"));
+    CHECK(log.at("c end") < log.at("f start")); // submitted after c, so waits for it
+    CHECK(log.at("e end") < log.events.size());
+    for (const auto &[id, status] : log.finished) CHECK(status.state == JobQueue::State::Done);
+}
+
+TEST(jobQueueFailureAndCancel) {
+    Log log;
+    std::atomic<bool> release{false};
+    JobQueue queue(recordInto(log), 2);
+    uint64_t blocker = queue.submit("blocker", {"/jobs/a"}, [&](std::stop_token stop,
+                                                                 const JobQueue::Report &) {
+        waitFor([&] { return release.load() || stop.stop_requested(); });
+        return JobQueue::Completion{};
+    });
+    uint64_t dropped = queue.submit("dropped", {"/jobs/a/b"}, [&](std::stop_token,
+                                                                   const JobQueue::Report &) {
+        log.add("dropped ran");
+        return JobQueue::Completion{};
+    });
+    uint64_t failed = queue.submit("failed", {"/jobs/c"}, [](std::stop_token,
+                                                              const JobQueue::Report &)
+                                                               -> JobQueue::Completion {
+        throw std::runtime_error("no space");
+    });
+    bool applied = false;
+    uint64_t partial = queue.submit("partial", {"/jobs/d"}, [&](std::stop_token,
+                                                                 const JobQueue::Report &)
+                                                                  -> JobQueue::Completion {
+        throw JobQueue::PartialFailure("2 of 3 failed", [&] { applied = true; });
+    });
+    CHECK(waitFor([&] { return log.finishedCount() == 2; }));
+    queue.cancel(dropped); // still queued behind the blocker
+    queue.cancel(blocker);
+    CHECK(waitFor([&] { return log.finishedCount() == 4; }));
+
+    std::lock_guard<std::mutex> lock(log.mutex);
+    CHECK(log.finished[failed].state == JobQueue::State::Failed);
+    CHECK(log.finished[failed].error == "no space");
+    CHECK(log.finished[partial].state == JobQueue::State::Failed);
+    CHECK(log.finished[dropped].state == JobQueue::State::Cancelled);
+    CHECK(log.finished[blocker].state == JobQueue::State::Cancelled);
+    CHECK(log.events.empty()); // the dropped job never ran
+    CHECK(log.completions.size() == 1);
+    for (auto &done : log.completions) done();
+    CHECK(applied);
+}
@@ -0,0 +1,27 @@
+#include "Jump.hpp"
+#include "Test.hpp"
+
+TEST(jumpRanking) {
+    JumpList jump;
+    jump.load({{"/c/other/proj-x/lib", 10}, {"/a/proj/src", 5}, {"/b/Project", 1}}, "/");
+    CHECK(jump.size() == 3);
+    auto dirs = [&] {
+        std::vector<fs::path> out;
+        for (uint32_t id : jump.results()) out.push_back(jump.dir(id));
+        return out;
+    };
+    using V = std::vector<fs::path>;
+    CHECK(dirs() == (V{"/c/other/proj-x/lib", "/a/proj/src", "/b/Project"}));
+
+    // The last component holding the last keyword outranks frecency.
+    jump.setQuery("proj");
+    CHECK(dirs() == (V{"/b/Project", "/c/other/proj-x/lib", "/a/proj/src"}));
+    jump.setQuery("proj s");
+    CHECK(dirs() == (V{"/a/proj/src"}));
+    jump.setQuery("");
+    CHECK(jump.results().size() == 3);
+
+    jump.setQuery("pxl"); // no substring match: fuzzy fallback
+    CHECK(!jump.results().empty() && jump.dir(jump.results().front()) == "/c/other/proj-x/lib");
+    CHECK(jump.display(0) == fs::path("c/other/proj-x/lib").string());
+}
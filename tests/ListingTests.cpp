@@ -0,0 +1,149 @@
+#include "Listing.hpp"
+#include "Test.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <memory>
+#include <set>
+#include <sstream>
+
+namespace {
+std::vector<std::string> sortedNames(std::vector<std::string> names, SortMode mode) {
+    std::vector<Tree::Item> items;
+    for (auto &n : names) items.push_back(Tree::Item::make(std::move(n), {}));
+    EntryOrder order;
+    order.mode = mode;
+    std::sort(items.begin(), items.end(), order);
+    std::vector<std::string> out;
+    for (const auto &i : items) out.push_back(i.name);
+    return out;
+}
+
+// Runs writeListing into a temporary file and returns what it wrote.
+std::string listing(const fs::path &root, ListFormat format, int depth, bool *ok = nullptr) {
+    ListOptions options;
+    options.format = format;
+    options.depth = depth;
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> out(std::tmpfile(), std::fclose);
+    bool written = writeListing(root, options, out.get());
+    if (ok) *ok = written;
+    std::string text;
+    std::rewind(out.get());
+    for (int c; (c = std::fgetc(out.get())) != EOF;) text += static_cast<char>(c);
+    return text;
+}
+
+std::vector<std::string> split(const std::string &text, char sep) {
+    std::vector<std::string> parts;
+    std::istringstream in(text);
+    for (std::string part; std::getline(in, part, sep);) parts.push_back(part);
+    return parts;
+}
+
+// A tree with an awkward name, a symlinked directory and an empty directory.
+void makeListingTree(const fs::path &root) {
+    writeFile(root / "b.txt", "bb");
+    writeFile(root / "a" / "x", "xxx");
+    writeFile(root / "a" / "deep" / "y", "");
+    writeFile(root / "quote\"\\\n\ttab", "q");
+    fs::create_directories(root / "empty");
+    fs::create_directory_symlink("a", root / "link");
+}
+} // namespace
+
+TEST(naturalOrder) {
+    using V = std::vector<std::string>;
+    CHECK(sortedNames({"a10", "b", "a2", "a1b", "a", "a1"}, SortMode::Natural) ==
+          (V{"a", "a1", "a1b", "a2", "a10", "b"}));
+    CHECK(sortedNames({"File20", "file3", "FILE100"}, SortMode::Natural) ==
+          (V{"file3", "File20", "FILE100"}));
+    CHECK(sortedNames({"v1.10", "v1.9", "v1.09.1"}, SortMode::Natural) ==
+          (V{"v1.9", "v1.09.1", "v1.10"}));
+    // Digit runs longer than any integer type still compare by value.
+    CHECK(sortedNames({"x123456789012345678901", "x99999999999999999999"}, SortMode::Natural) ==
+          (V{"x99999999999999999999", "x123456789012345678901"}));
+
+    Tree::Meta dir;
+    dir.isDir = true;
+    std::vector<Tree::Item> items{Tree::Item::make("a", {}), Tree::Item::make("z", dir)};
+    EntryOrder order;
+    order.mode = SortMode::Natural;
+    CHECK(order(items[1], items[0])); // directories first
+}
+
+TEST(listText) {
+    Scratch scratch("list-text");
+    makeListingTree(scratch.dir);
+    std::string sep(1, static_cast<char>(fs::path::preferred_separator));
+    bool ok = false;
+    std::vector<std::string> lines = split(listing(scratch.dir, ListFormat::Text, 1, &ok), '\n');
+    CHECK(ok);
+    // Directories first, then files; one level only. The name holding a newline splits.
+    std::vector<std::string> paths;
+    for (const auto &line : lines) {
+        std::vector<std::string> fields = split(line, '\t');
+        if (fields.size() >= 3) paths.push_back(fields[2]);
+    }
+    CHECK(paths.size() == 5 && paths[0] == "a" && paths[1] == "empty" && paths[2] == "link" &&
+          paths[3] == "b.txt");
+    CHECK(lines.size() == 6);
+    bool sized = false;
+    for (const auto &line : lines) {
+        std::vector<std::string> fields = split(line, '\t');
+        if (fields.size() == 3 && fields[2] == "b.txt") sized = fields[1] == "2";
+        if (fields.size() == 3 && fields[2] == "a") CHECK(fields[1].empty());
+    }
+    CHECK(sized);
+
+    std::string all = listing(scratch.dir, ListFormat::Text, 0);
+    CHECK(all.find("\t" + ("a" + sep + "deep" + sep + "y") + "\n") != std::string::npos);
+    CHECK(all.find("\t3\t" + ("a" + sep + "x") + "\n") != std::string::npos);
+    CHECK(all.find("link" + sep) == std::string::npos); // symlinked directories are not entered
+    CHECK(listing(scratch.dir / "empty", ListFormat::Text, 0).empty());
+}
+
+TEST(listNullSeparated) {
+    Scratch scratch("list-null");
+    makeListingTree(scratch.dir);
+    std::string out = listing(scratch.dir, ListFormat::Null, 0);
+    CHECK(!out.empty() && out.back() == '\0');
+    std::vector<std::string> paths = split(out, '\0');
+    std::set<std::string> unique(paths.begin(), paths.end());
+    CHECK(paths.size() == 8 && unique.size() == 8);
+    CHECK(unique.count("quote\"\\\n\ttab"));
+}
+
+TEST(listJson) {
+    using json = nlohmann::json;
+    Scratch scratch("list-json");
+    makeListingTree(scratch.dir);
+    json array = json::parse(listing(scratch.dir, ListFormat::Json, 0));
+    CHECK(array.is_array() && array.size() == 8);
+    std::set<std::string> names;
+    for (const auto &e : array) {
+        names.insert(e["name"].get<std::string>());
+        if (e["name"] == "b.txt") CHECK(e["size"] == 2 && e["dir"] == false && e["depth"] == 1);
+        if (e["name"] == "deep") CHECK(e["size"].is_null() && e["dir"] == true && e["depth"] == 2);
+        if (e["name"] == "link") CHECK(e["dir"] == true);
+        CHECK(e["mtime"].is_number());
+    }
+    CHECK(names.count("quote\"\\\n\ttab"));
+
+    std::vector<std::string> lines = split(listing(scratch.dir, ListFormat::Ndjson, 0), '\n');
+    CHECK(lines.size() == 8);
+    for (const auto &line : lines) CHECK(json::parse(line).is_object());
+
+    CHECK(json::parse(listing(scratch.dir / "empty", ListFormat::Json, 0)) == json::array());
+    CHECK(listing(scratch.dir / "empty", ListFormat::Ndjson, 0).empty());
+}
+
+TEST(listMissingRoot) {
+    Scratch scratch("list-missing");
+    bool threw = false;
+    try {
+        listing(scratch.dir / "missing", ListFormat::Text, 0);
+    } catch (const fs::filesystem_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+}
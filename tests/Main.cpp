@@ -0,0 +1,24 @@
+// Unit tests for FileManagerCore, one file per area. Each test works in its own directory
+// under the temp directory. Prints every failed check and exits non-zero if there was one.
+//
+//   FileManagerTests [<substring of test names>]
+
+#include "Test.hpp"
+
+#include <exception>
+
+int main(int argc, char **argv) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    for (const TestCase &t : testCases()) {
+        if (std::string(t.name).find(filter) == std::string::npos) continue;
+        int failures = gFailures;
+        try {
+            t.run();
+        } catch (const std::exception &e) {
+            std::fprintf(stderr, "%s: threw %s\n", t.name, e.what());
+            ++gFailures;
+        }
+        std::printf("%-28s %s\n", t.name, gFailures == failures ? "ok" : "FAILED");
+    }
+    return gFailures ? 1 : 0;
+}
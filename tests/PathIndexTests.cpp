@@ -0,0 +1,56 @@
+#include "PathIndex.hpp"
+#include "Test.hpp"
+
+#include <set>
+
+TEST(pathIndexRoundTrip) {
+    Scratch scratch("pathindex");
+    fs::path root = scratch.dir / "root", file = scratch.dir / "index";
+    writeFile(root / "c.txt", "c");
+    writeFile(root / "A" / "x.txt", "x");
+    writeFile(root / "A" / "b" / "y.txt", "y");
+    writeFile(root / ".git" / "HEAD", "ref");
+    fs::create_directories(root / "empty");
+
+    CHECK(PathIndex::build(root, file, nullptr, {}));
+    std::shared_ptr<const PathIndex> index = PathIndex::open(file);
+    CHECK(index != nullptr);
+    if (!index) return;
+    CHECK(index->root() == root);
+    CHECK(index->complete());
+
+    auto y = index->find(fs::path("A") / "b" / "y.txt");
+    CHECK(y && !index->isDir(*y));
+    CHECK(y && index->relPath(*y) == (fs::path("A") / "b" / "y.txt").string());
+    auto b = index->find(fs::path("A") / "b");
+    CHECK(b && index->isDir(*b) && index->listed(*b));
+    CHECK(index->find("empty") && index->isDir(*index->find("empty")));
+    CHECK(!index->find("missing"));
+    CHECK(!index->find(fs::path("c.txt") / "below"));
+    auto git = index->find(".git");
+    CHECK(git && !index->listed(*git)); // skipped directories are not entered
+
+    std::set<std::string> files, dirs;
+    index->forEach(0, false, [&](const std::string &p) { return files.insert(p), true; });
+    index->forEach(0, true, [&](const std::string &p) { return dirs.insert(p), true; });
+    auto rel = [](fs::path p) { return p.string(); };
+    CHECK(files == (std::set<std::string>{"c.txt", rel(fs::path("A") / "x.txt"),
+                                          rel(fs::path("A") / "b" / "y.txt")}));
+    CHECK(dirs.count("A") && dirs.count(rel(fs::path("A") / "b")) && dirs.count("empty"));
+
+    // A rebuild reusing the previous index sees the same tree plus what changed.
+    writeFile(root / "A" / "new.txt", "n");
+    fs::path next = scratch.dir / "index2";
+    CHECK(PathIndex::build(root, next, index.get(), {}));
+    auto rebuilt = PathIndex::open(next);
+    CHECK(rebuilt && rebuilt->size() == index->size() + 1);
+    CHECK(rebuilt && rebuilt->find(fs::path("A") / "b" / "y.txt"));
+    CHECK(rebuilt && rebuilt->find(fs::path("A") / "new.txt"));
+
+    // Damaged files are rejected rather than read out of bounds.
+    fs::resize_file(next, fs::file_size(next) / 2);
+    CHECK(!PathIndex::open(next));
+    writeFile(next, std::string(4096, 'x'));
+    CHECK(!PathIndex::open(next));
+    CHECK(!PathIndex::open(scratch.dir / "none"));
+}
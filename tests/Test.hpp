@@ -0,0 +1,108 @@
+#ifndef TESTS_TEST_HPP_
+#define TESTS_TEST_HPP_
+
+// What the test files share: registration, checks and scratch directories. A test is
+//
+//   TEST(name) { CHECK(...); }
+//
+// at namespace scope in any tests/*Tests.cpp; Main.cpp runs them all.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct TestCase {
+    const char *name;
+    void (*run)();
+};
+
+inline std::vector<TestCase> &testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+struct TestRegistration {
+    TestRegistration(const char *name, void (*run)()) { testCases().push_back({name, run}); }
+};
+
+#define TEST(name)                                                                             \
+    static void name();                                                                        \
+    static const TestRegistration name##Registration(#name, name);                             \
+    static void name()
+
+inline int gFailures = 0;
+
+inline void check(bool ok, const char *expr, const char *file, int line) {
+    if (ok) return;
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    ++gFailures;
+}
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+inline bool near(double a, double b, double tolerance = 1e-4) {
+    return std::abs(a - b) <= tolerance * std::max(1.0, std::abs(b));
+}
+
+// Polls until `done` holds; false if it still does not after `timeout`. For the classes that
+// report from a background thread.
+inline bool waitFor(const std::function<bool()> &done,
+                    std::chrono::milliseconds timeout = std::chrono::seconds(20)) {
+    auto until = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > until) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return true;
+}
+
+// Empty directory for one test, removed again afterwards.
+struct Scratch {
+    fs::path dir;
+
+    explicit Scratch(const std::string &name)
+        : dir(fs::temp_directory_path() / ("FileManagerTests-" + name)) {
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+    ~Scratch() {
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    }
+};
+
+inline void writeFile(const fs::path &path, const std::string &contents) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << contents;
+}
+
+inline std::string readFile(const fs::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+inline int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// n bytes of a fixed pattern that is not all one value.
+inline std::string bytes(size_t n) {
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; ++i) s[i] = static_cast<char>((i * 7 + 3) & 0xff);
+    return s;
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include "Test.hpp"
+#include "Trash.hpp"
+
+#include <cstdlib>
+#include <optional>
+
+// Windows trashes to the root of the volume, which a test should not touch.
+#ifndef _WIN32
+
+namespace {
+// Points the home trash into a scratch directory for the lifetime of the object.
+struct ScratchTrash {
+    fs::path dir;
+    std::optional<std::string> saved;
+
+    explicit ScratchTrash(const fs::path &dataHome) : dir(dataHome / "Trash") {
+        if (const char *xdg = std::getenv("XDG_DATA_HOME")) saved = xdg;
+        ::setenv("XDG_DATA_HOME", dataHome.c_str(), 1);
+    }
+    ~ScratchTrash() {
+        if (saved)
+            ::setenv("XDG_DATA_HOME", saved->c_str(), 1);
+        else
+            ::unsetenv("XDG_DATA_HOME");
+    }
+};
+} // namespace
+
+TEST(trashNameCollisions) {
+    Scratch scratch("trash");
+    ScratchTrash trash(scratch.dir / "data");
+    fs::path a = scratch.dir / "one" / "notes.txt", b = scratch.dir / "two" / "notes.txt";
+    fs::path c = scratch.dir / "three" / "notes.txt", d = scratch.dir / "one" / ".hidden";
+    fs::path e = scratch.dir / "two" / ".hidden";
+    for (const fs::path &p : {a, b, c, d, e}) writeFile(p, p.string());
+    // An info file left behind without its item still claims the name.
+    writeFile(trash.dir / "info" / "notes.2.txt.trashinfo", "");
+
+    CHECK(Trash::put(a) == trash.dir / "files" / "notes.txt");
+    CHECK(Trash::put(b) == trash.dir / "files" / "notes.1.txt");
+    CHECK(Trash::put(c) == trash.dir / "files" / "notes.3.txt");
+    CHECK(Trash::put(d) == trash.dir / "files" / ".hidden");
+    CHECK(Trash::put(e) == trash.dir / "files" / ".hidden.1");
+    CHECK(!fs::exists(a) && !fs::exists(b) && !fs::exists(c));
+    CHECK(readFile(trash.dir / "files" / "notes.1.txt") == b.string());
+
+    std::string info = readFile(trash.dir / "info" / "notes.1.txt.trashinfo");
+    CHECK(info.rfind("[Trash Info]\nPath=" + b.generic_string() + "\nDeletionDate=", 0) == 0);
+}
+
+TEST(trashRestoreAndPurge) {
+    Scratch scratch("trash-restore");
+    ScratchTrash trash(scratch.dir / "data");
+    fs::path file = scratch.dir / "a b%.txt", dir = scratch.dir / "dir";
+    writeFile(file, "file");
+    writeFile(dir / "inner", "inner");
+
+    fs::path trashedFile = Trash::put(file), trashedDir = Trash::put(dir);
+    CHECK(readFile(trash.dir / "info" / "a b%.txt.trashinfo").find("a%20b%25.txt") !=
+          std::string::npos);
+
+    // Restoring onto something that took the name in the meantime leaves both alone.
+    writeFile(file, "new");
+    bool threw = false;
+    try {
+        Trash::restore(trashedFile, file);
+    } catch (const fs::filesystem_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(readFile(file) == "new" && fs::exists(trashedFile));
+    fs::remove(file);
+
+    Trash::restore(trashedFile, file);
+    CHECK(readFile(file) == "file");
+    CHECK(!fs::exists(trashedFile));
+    CHECK(!fs::exists(trash.dir / "info" / "a b%.txt.trashinfo"));
+
+    Trash::purge(trashedDir);
+    CHECK(!fs::exists(trashedDir));
+    CHECK(!fs::exists(trash.dir / "info" / "dir.trashinfo"));
+    CHECK(!fs::exists(dir));
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include "Test.hpp"
+#include "Tree.hpp"
+
+#include <set>
+
+TEST(treePaths) {
+    Tree tree;
+    fs::path base = fs::temp_directory_path() / "tree-test";
+    Tree::NodeId leaf = tree.intern(base / "a" / "b" / "c.txt");
+    CHECK(tree.path(leaf) == base / "a" / "b" / "c.txt");
+    CHECK(tree.name(leaf) == "c.txt");
+    CHECK(tree.extension(leaf) == ".txt");
+    CHECK(tree.intern(base / "a" / "b" / "c.txt") == leaf);
+    CHECK(tree.find(base / "a" / "b" / "c.txt") == leaf);
+    CHECK(!tree.find(base / "a" / "missing"));
+
+    Tree::NodeId b = tree.parent(leaf);
+    CHECK(tree.path(b) == base / "a" / "b");
+    CHECK(tree.findChild(b, "c.txt") == leaf);
+    CHECK(tree.findChild(b, "C.TXT") == Tree::npos); // names are case-sensitive
+    CHECK(tree.isAncestor(*tree.find(base / "a"), leaf));
+    CHECK(!tree.isAncestor(leaf, b));
+
+    // Enough siblings to make the index grow several times.
+    for (int i = 0; i < 5000; ++i) tree.child(b, "f" + std::to_string(i));
+    for (int i = 0; i < 5000; i += 499)
+        CHECK(tree.path(tree.findChild(b, "f" + std::to_string(i))) ==
+              base / "a" / "b" / ("f" + std::to_string(i)));
+}
+
+TEST(treeExpandedAndCompact) {
+    Tree tree;
+    fs::path base = fs::temp_directory_path() / "tree-test";
+    Tree::NodeId root = tree.intern(base);
+    Tree::NodeId a = tree.intern(base / "a"), ab = tree.intern(base / "a" / "b");
+    Tree::NodeId c = tree.intern(base / "c");
+    tree.intern(base / "d" / "e");
+    for (Tree::NodeId id : {a, ab, c}) tree.setExpanded(id, true);
+
+    auto below = [&](Tree::NodeId under) {
+        std::vector<Tree::NodeId> v = tree.expandedBelow(under);
+        return std::set<Tree::NodeId>(v.begin(), v.end());
+    };
+    CHECK(below(root) == (std::set<Tree::NodeId>{a, ab, c}));
+    tree.setExpanded(a, false);
+    CHECK(below(root) == (std::set<Tree::NodeId>{c})); // b is hidden under collapsed a
+    CHECK(tree.expandedNodes().size() == 2);
+    tree.setExpanded(a, true);
+    tree.setSelected(*tree.find(base / "d" / "e"), true);
+    CHECK(tree.selectionCount() == 1);
+
+    // Expanded and selected nodes survive with their ancestors; the rest are dropped.
+    size_t before = tree.size();
+    Tree::NodeId loose = tree.intern(base / "x" / "y");
+    std::vector<Tree::NodeId> map = tree.compact({});
+    CHECK(map[loose] == Tree::npos);
+    CHECK(tree.size() == before);
+    CHECK(tree.path(map[ab]) == base / "a" / "b");
+    CHECK(tree.expanded(map[ab]));
+    CHECK(tree.find(base / "d" / "e") && tree.selected(*tree.find(base / "d" / "e")));
+    CHECK(!tree.find(base / "x"));
+    CHECK(below(map[root]) == (std::set<Tree::NodeId>{map[a], map[ab], map[c]}));
+
+    tree.clearExpanded();
+    CHECK(tree.expandedNodes().empty());
+    CHECK(below(map[root]).empty());
+}
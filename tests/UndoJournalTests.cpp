@@ -0,0 +1,32 @@
+#include "Test.hpp"
+#include "UndoJournal.hpp"
+
+TEST(undoJournalRoundTrip) {
+    Scratch scratch("undo");
+    fs::path file = scratch.dir / "undo.json";
+    std::vector<UndoJournal::Record> records{
+        {{"rename", "/a/old name", "/a/new name"}},
+        {{"move", "/a/x", "/b/x"}, {"delete", "/a/y", "/trash/y"}},
+        {{"newdir", "", "/a/\xc3\xa9t\xc3\xa9"}},
+    };
+    {
+        UndoJournal journal;
+        CHECK(journal.open(file).empty());
+        journal.save(records);
+    } // the destructor writes what is pending
+
+    UndoJournal journal;
+    std::vector<UndoJournal::Record> read = journal.open(file);
+    CHECK(read.size() == records.size());
+    for (size_t i = 0; i < std::min(read.size(), records.size()); ++i) {
+        CHECK(read[i].size() == records[i].size());
+        for (size_t j = 0; j < std::min(read[i].size(), records[i].size()); ++j) {
+            CHECK(read[i][j].type == records[i][j].type);
+            CHECK(read[i][j].source == records[i][j].source);
+            CHECK(read[i][j].target == records[i][j].target);
+        }
+    }
+
+    writeFile(file, "[[{\"type\": \"move\"");
+    CHECK(journal.open(file).empty());
+}